@@ -22,6 +22,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <ctype.h>
 
 #if HAVE__MKDIR
@@ -112,6 +113,63 @@ parse_orf_thresh_level(const char *arg, int *x)
 }
 
 
+int
+parse_mmap_opts(const char *arg, struct uproc_ecurve_mmap_opts *opts)
+{
+    struct uproc_ecurve_mmap_opts tmp = *opts;
+    const char *p = arg;
+
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        const char *val = memchr(p, '=', len);
+        size_t name_len = val ? (size_t)(val - p) : len;
+
+#define IS(name) (name_len == strlen(name) && !strncmp(p, name, name_len))
+        if (IS("prefault")) {
+            tmp.mode = UPROC_ECURVE_MMAP_PREFAULT;
+            tmp.threads = 0;
+            if (val) {
+                char buf[16];
+                size_t n = len - name_len - 1;
+                if (n >= sizeof buf) {
+                    return -1;
+                }
+                memcpy(buf, val + 1, n);
+                buf[n] = '\0';
+                if (parse_int(buf, &tmp.threads) || tmp.threads <= 0) {
+                    return -1;
+                }
+            }
+        }
+        else if (val) {
+            return -1;
+        }
+        else if (IS("lazy")) {
+            tmp.mode = UPROC_ECURVE_MMAP_LAZY;
+        }
+        else if (IS("populate")) {
+            tmp.mode = UPROC_ECURVE_MMAP_POPULATE;
+        }
+        else if (IS("mlock")) {
+            tmp.mlock = true;
+        }
+        else if (IS("hugepage")) {
+            tmp.hugepage = true;
+        }
+        else {
+            return -1;
+        }
+#undef IS
+        p += len;
+        if (*p == ',') {
+            p++;
+        }
+    }
+    *opts = tmp;
+    return 0;
+}
+
+
 void
 errhandler_bail(enum uproc_error_code num, const char *msg, const char *loc)
 {
@@ -148,13 +206,43 @@ make_dir(const char *path)
 }
 
 
+static uproc_ecurve *
+ecurve_load(const char *path, const char *name,
+            enum uproc_ecurve_format format,
+            const struct uproc_ecurve_mmap_opts *mmap_opts,
+            const char *shm_name)
+{
+    if (shm_name) {
+        return uproc_ecurve_attach_shm(mmap_opts, DATABASE_SHM_FMT, shm_name,
+                                       name);
+    }
+    if (format == UPROC_ECURVE_BINARY && uproc_features_mmap()) {
+        return uproc_ecurve_mmapo(mmap_opts, "%s/%s.ecurve", path, name);
+    }
+    return uproc_ecurve_load(format, UPROC_IO_GZIP, "%s/%s.ecurve", path,
+                             name);
+}
+
+
+/* Keep the error information of the calling thread in `*err` and `msg`,
+ * unless an error was kept already */
+static void
+database_load_error(int *err, char *msg, size_t n)
+{
+    if (*err == UPROC_SUCCESS) {
+        *err = uproc_errno;
+        snprintf(msg, n, "%s", uproc_errmsg);
+    }
+}
+
+
 int
 database_load(struct database *db, const char *path, int prot_thresh_level,
-              enum uproc_ecurve_format format)
+              enum uproc_ecurve_format format,
+              const struct uproc_ecurve_mmap_opts *mmap_opts,
+              const char *shm_name)
 {
-    db->fwd = db->rev = NULL;
-    db->idmap = NULL;
-    db->prot_thresh = NULL;
+    *db = (struct database)DATABASE_INITIALIZER;
 
     switch (prot_thresh_level) {
         case 2:
@@ -179,12 +267,40 @@ database_load(struct database *db, const char *path, int prot_thresh_level,
     if (!db->idmap) {
         goto error;
     }
-    db->fwd = uproc_ecurve_load(format, UPROC_IO_GZIP, "%s/fwd.ecurve", path);
-    if (!db->fwd) {
-        goto error;
+
+    /* Unless the ecurves are mapped, loading them is dominated by gzip
+     * decompression, which can't be parallelized within a file, but both
+     * files can be read at the same time. The error information is
+     * thread-local, so that of a failed load is set again in the calling
+     * thread. */
+    bool mapped = shm_name ||
+                  (format == UPROC_ECURVE_BINARY && uproc_features_mmap());
+    int err = UPROC_SUCCESS;
+    char errmsg[256] = "";
+#pragma omp parallel sections num_threads(2) if (!mapped)
+    {
+#pragma omp section
+        {
+            db->fwd = ecurve_load(path, "fwd", format, mmap_opts, shm_name);
+            if (!db->fwd) {
+#pragma omp critical
+                database_load_error(&err, errmsg, sizeof errmsg);
+            }
+        }
+#pragma omp section
+        {
+            db->rev = ecurve_load(path, "rev", format, mmap_opts, shm_name);
+            if (!db->rev) {
+#pragma omp critical
+                database_load_error(&err, errmsg, sizeof errmsg);
+            }
+        }
     }
-    db->rev = uproc_ecurve_load(format, UPROC_IO_GZIP, "%s/rev.ecurve", path);
-    if (!db->rev) {
+    if (!db->fwd || !db->rev) {
+        uproc_errno = err;
+        if (errmsg[0]) {
+            uproc_error_msg(err, "%s", errmsg);
+        }
         goto error;
     }
 
@@ -202,10 +318,73 @@ database_free(struct database *db)
     uproc_ecurve_destroy(db->rev);
     uproc_idmap_destroy(db->idmap);
     uproc_matrix_destroy(db->prot_thresh);
+    uproc_container_destroy(db->container);
     *db = (struct database)DATABASE_INITIALIZER;
 }
 
 
+int
+database_numa_move(struct database *db, int node)
+{
+    struct database copy;
+    if (database_numa_copy(&copy, db, node)) {
+        return -1;
+    }
+    uproc_ecurve_destroy(db->fwd);
+    uproc_ecurve_destroy(db->rev);
+    db->fwd = copy.fwd;
+    db->rev = copy.rev;
+    return 0;
+}
+
+
+int
+database_numa_copy(struct database *copy, const struct database *db,
+                   int node)
+{
+    *copy = *db;
+    copy->fwd = uproc_ecurve_numa_copy(db->fwd, node);
+    if (!copy->fwd) {
+        goto error;
+    }
+    copy->rev = uproc_ecurve_numa_copy(db->rev, node);
+    if (!copy->rev) {
+        uproc_ecurve_destroy(copy->fwd);
+        goto error;
+    }
+    return 0;
+error:
+    /* don't leave pointers to the ecurves of `db` or to freed ones */
+    *copy = (struct database)DATABASE_INITIALIZER;
+    return -1;
+}
+
+
+void
+database_numa_free(struct database *copy)
+{
+    uproc_ecurve_destroy(copy->fwd);
+    uproc_ecurve_destroy(copy->rev);
+    *copy = (struct database)DATABASE_INITIALIZER;
+}
+
+
+int
+parse_numa_mode(const char *arg, enum numa_mode *mode)
+{
+    if (!strcmp(arg, "replicate")) {
+        *mode = NUMA_REPLICATE;
+    }
+    else if (!strcmp(arg, "interleave")) {
+        *mode = NUMA_INTERLEAVE;
+    }
+    else {
+        return -1;
+    }
+    return 0;
+}
+
+
 int
 model_load(struct model *m, const char *path, int orf_thresh_level)
 {
@@ -259,6 +438,72 @@ model_free(struct model *m)
 }
 
 
+int
+container_load(struct database *db, struct model *m, const char *path,
+               int prot_thresh_level, int orf_thresh_level,
+               const struct uproc_ecurve_mmap_opts *mmap_opts)
+{
+    *db = (struct database)DATABASE_INITIALIZER;
+    *m = (struct model)MODEL_INITIALIZER;
+
+    if (prot_thresh_level != 0 && prot_thresh_level != 2 &&
+        prot_thresh_level != 3) {
+        return uproc_error_msg(
+            UPROC_EINVAL, "protein threshold level must be 0, 2, or 3");
+    }
+    if (orf_thresh_level < 0 || orf_thresh_level > 2) {
+        return uproc_error_msg(
+            UPROC_EINVAL, "ORF threshold level must be 0, 1, or 2");
+    }
+
+    db->container = uproc_container_mmap(mmap_opts, "%s", path);
+    if (!db->container) {
+        return -1;
+    }
+    if (prot_thresh_level) {
+        char name[UPROC_CONTAINER_NAME_MAX + 1];
+        sprintf(name, "prot_thresh_e%d", prot_thresh_level);
+        db->prot_thresh = uproc_container_matrix(db->container, name);
+        if (!db->prot_thresh) {
+            goto error;
+        }
+    }
+    if (orf_thresh_level) {
+        char name[UPROC_CONTAINER_NAME_MAX + 1];
+        sprintf(name, "orf_thresh_e%d", orf_thresh_level);
+        m->orf_thresh = uproc_container_matrix(db->container, name);
+        if (!m->orf_thresh) {
+            goto error;
+        }
+    }
+    db->idmap = uproc_container_idmap(db->container, "idmap");
+    if (!db->idmap) {
+        goto error;
+    }
+    db->fwd = uproc_container_ecurve(db->container, "fwd");
+    if (!db->fwd) {
+        goto error;
+    }
+    db->rev = uproc_container_ecurve(db->container, "rev");
+    if (!db->rev) {
+        goto error;
+    }
+    m->substmat = uproc_container_substmat(db->container, "substmat");
+    if (!m->substmat) {
+        goto error;
+    }
+    m->codon_scores = uproc_container_matrix(db->container, "codon_scores");
+    if (!m->codon_scores) {
+        goto error;
+    }
+    return 0;
+error:
+    model_free(m);
+    database_free(db);
+    return -1;
+}
+
+
 static bool
 prot_filter(const char *seq, size_t len, uproc_family family,
             double score, void *opaque)
@@ -278,6 +523,23 @@ prot_filter(const char *seq, size_t len, uproc_family family,
 }
 
 
+/* smallest score accepted by prot_filter() */
+static double
+prot_thresh(size_t len, void *opaque)
+{
+    unsigned long rows, cols;
+    uproc_matrix *thresh = opaque;
+    if (!thresh) {
+        return UPROC_EPSILON;
+    }
+    uproc_matrix_dimensions(thresh, &rows, &cols);
+    if (len >= rows) {
+        len = rows - 1;
+    }
+    return uproc_matrix_get(thresh, len, 0);
+}
+
+
 static bool
 orf_filter(const struct uproc_orf *orf, const char *seq, size_t seq_len,
            double seq_gc, void *opaque)
@@ -307,12 +569,20 @@ orf_filter(const struct uproc_orf *orf, const char *seq, size_t seq_len,
 int
 create_classifiers(uproc_protclass **pc, uproc_dnaclass **dc,
                    const struct database *db, const struct model *model,
-                   bool short_read_mode)
+                   bool short_read_mode, bool fixed_point, int top_k,
+                   bool prune, int cache_size, int batch_size,
+                   uproc_protmemo *memo)
 {
     enum uproc_protclass_mode pc_mode = UPROC_PROTCLASS_ALL;
     enum uproc_dnaclass_mode dc_mode = UPROC_DNACLASS_ALL;
 
-    if (dc && short_read_mode) {
+    if (top_k > 0) {
+        /* the families among the best of a DNA sequence are also among the
+         * best of their ORF, so the protein classifier can drop the rest */
+        pc_mode = UPROC_PROTCLASS_TOP_K;
+        dc_mode = UPROC_DNACLASS_TOP_K;
+    }
+    else if (dc && short_read_mode) {
         pc_mode = UPROC_PROTCLASS_MAX;
         dc_mode = UPROC_DNACLASS_MAX;
     }
@@ -321,6 +591,18 @@ create_classifiers(uproc_protclass **pc, uproc_dnaclass **dc,
     if (!*pc) {
         return -1;
     }
+    uproc_protclass_set_fixed(*pc, fixed_point);
+    if (prune) {
+        uproc_protclass_set_thresh(*pc, prot_thresh, db->prot_thresh);
+    }
+    uproc_protclass_set_cache(*pc, cache_size);
+    if (batch_size > 0) {
+        uproc_protclass_set_batch(*pc, (size_t)batch_size << 20);
+    }
+    uproc_protclass_set_memo(*pc, memo);
+    if (top_k > 0) {
+        uproc_protclass_set_top_k(*pc, top_k);
+    }
 
     if (!dc) {
         return 0;
@@ -333,6 +615,9 @@ create_classifiers(uproc_protclass **pc, uproc_dnaclass **dc,
         uproc_protclass_destroy(*pc);
         return -1;
     }
+    if (top_k > 0) {
+        uproc_dnaclass_set_top_k(*dc, top_k);
+    }
     return 0;
 }
 
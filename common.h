@@ -58,6 +58,20 @@ int parse_prot_thresh_level(const char *arg, int *x);
 /* Parse int and check whether it is 0, 1 or 2 */
 int parse_orf_thresh_level(const char *arg, int *x);
 
+/* Parse comma-separated database load options:
+ * "lazy", "populate", "prefault[=THREADS]", "mlock" and "hugepage" */
+int parse_mmap_opts(const char *arg, struct uproc_ecurve_mmap_opts *opts);
+
+/* Description of the option that takes the argument of parse_mmap_opts() */
+#define MMAP_OPTS_DESC "\
+Comma-separated list of options for mapping the database into memory:\n\
+    lazy        read pages on first access\n\
+    populate    read the whole database at startup (default)\n\
+    prefault[=N]\n\
+                read the whole database at startup using N threads\n\
+    mlock       lock the database into memory\n\
+    hugepage    use huge pages if possible"
+
 
 /* Error handler that prints the message and exits the program */
 void errhandler_bail(enum uproc_error_code num, const char *msg,
@@ -78,14 +92,45 @@ struct database
     uproc_ecurve *fwd, *rev;
     uproc_idmap *idmap;
     uproc_matrix *prot_thresh;
+
+    /* Container the ecurves refer to if loaded by container_load() */
+    uproc_container *container;
 };
 
-#define DATABASE_INITIALIZER { 0, 0, 0, 0 }
+#define DATABASE_INITIALIZER { 0, 0, 0, 0, 0 }
 
+/* Name of the shared memory object that uproc-dbd creates for the ecurve
+ * `name` ("fwd" or "rev") of the database `shm_name` */
+#define DATABASE_SHM_FMT "/%s.%s.ecurve"
+
+/* `mmap_opts` is used only if the ecurves are mapped into memory and may be
+ * NULL. If `shm_name` is not NULL, the ecurves are attached from the shared
+ * memory objects created by uproc-dbd instead of being loaded from `path`. */
 int database_load(struct database *db, const char *path, int prot_thresh_level,
-                  enum uproc_ecurve_format format);
+                  enum uproc_ecurve_format format,
+                  const struct uproc_ecurve_mmap_opts *mmap_opts,
+                  const char *shm_name);
 void database_free(struct database *db);
 
+/* Replace the ecurves of `db` by copies on NUMA node `node`, or interleaved
+ * over all nodes if `node` is negative */
+int database_numa_move(struct database *db, int node);
+
+/* Copy the ecurves of `db` to NUMA node `node`. The copy shares all other
+ * members with `db` and has to be freed using database_numa_free() */
+int database_numa_copy(struct database *copy, const struct database *db,
+                       int node);
+void database_numa_free(struct database *copy);
+
+/* Parse NUMA mode ("replicate" or "interleave") */
+enum numa_mode
+{
+    NUMA_OFF,
+    NUMA_REPLICATE,
+    NUMA_INTERLEAVE,
+};
+int parse_numa_mode(const char *arg, enum numa_mode *mode);
+
 
 /* Struct representing the "model" */
 struct model
@@ -101,13 +146,30 @@ int model_load(struct model *m, const char *path, int orf_thresh_level);
 
 void model_free(struct model *m);
 
+/* Load database and model from a container file created by uproc-pack. The
+ * ecurves are mapped directly from the file as described by `mmap_opts`. */
+int container_load(struct database *db, struct model *m, const char *path,
+                   int prot_thresh_level, int orf_thresh_level,
+                   const struct uproc_ecurve_mmap_opts *mmap_opts);
+
 /* Create classifiers
  *
- * `dc` may be NULL if no DNA classifier is needed
+ * `dc` may be NULL if no DNA classifier is needed. If `fixed_point` is set,
+ * the protein classifier uses fixed-point arithmetic (see
+ * uproc_protclass_set_fixed()). If `top_k` is positive, the classifiers
+ * report only the `top_k` best families instead of the ones determined by
+ * `short_read_mode`. If `prune` is set, families that can't reach the
+ * protein threshold are not scored to completion (see
+ * uproc_protclass_set_thresh()). `cache_size` is passed to
+ * uproc_protclass_set_cache(), `batch_size` (in MiB, 0 for the default) to
+ * uproc_protclass_set_batch() and `memo` (which may be NULL) to
+ * uproc_protclass_set_memo().
  * */
 int create_classifiers(uproc_protclass **pc, uproc_dnaclass **dc,
                        const struct database *db, const struct model *model,
-                       bool short_read_mode);
+                       bool short_read_mode, bool fixed_point, int top_k,
+                       bool prune, int cache_size, int batch_size,
+                       uproc_protmemo *memo);
 
 
 #if defined(TIMEIT) && HAVE_CLOCK_GETTIME
@@ -0,0 +1,263 @@
+/* uproc-dbd
+ * Keep the ecurves of a database in shared memory.
+ *
+ * Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of uproc.
+ *
+ * uproc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uproc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include "common.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+#include <signal.h>
+#endif
+
+#include <uproc.h>
+
+#include "ppopts.h"
+
+#define PROGNAME "uproc-dbd"
+
+static const char *ecurve_names[] = { "fwd", "rev" };
+#define ECURVE_COUNT (sizeof ecurve_names / sizeof *ecurve_names)
+
+
+void
+make_opts(struct ppopts *o, const char *progname)
+{
+#define O(...) ppopts_add(o, __VA_ARGS__)
+    ppopts_add_text(o, PROGNAME ", version " UPROC_VERSION);
+    ppopts_add_text(o, "USAGE: %s [options] DBDIR NAME", progname);
+    ppopts_add_text(o,
+        "Copies the ecurves of the database in DBDIR into shared memory "
+        "under NAME, where uproc-prot, uproc-dna and uproc-detailed can use "
+        "them (with \"-S NAME\") without loading them on their own. Unless "
+        "-k is used, the program keeps running until it receives SIGINT, "
+        "SIGTERM or SIGHUP and then removes the ecurves from shared memory.");
+
+    ppopts_add_header(o, "GENERAL OPTIONS:");
+    O('h', "help",       "", "Print this message and exit.");
+    O('v', "version",    "", "Print version and exit.");
+    O('V', "libversion", "", "Print libuproc version/features and exit.");
+
+    ppopts_add_header(o, "SHARED MEMORY OPTIONS:");
+    O('H', "hugepage", "", "Use huge pages if possible.");
+    O('l', "lock", "",
+      "Lock the ecurves into memory (not possible together with -k).");
+    O('k', "keep", "",
+      "Exit as soon as the ecurves are in shared memory, leaving them "
+      "there until they are removed using -r.");
+    O('r', "remove", "",
+      "Remove the ecurves stored under NAME and exit (DBDIR can be "
+      "omitted).");
+#undef O
+}
+
+
+static int
+remove_ecurves(const char *name)
+{
+    int res = 0;
+    for (size_t i = 0; i < ECURVE_COUNT; i++) {
+        res |= uproc_ecurve_unlink_shm(DATABASE_SHM_FMT, name,
+                                       ecurve_names[i]);
+    }
+    return res;
+}
+
+
+static int
+store_ecurves(const char *dbdir, const char *name, bool hugepage)
+{
+    size_t i;
+    for (i = 0; i < ECURVE_COUNT; i++) {
+        uproc_ecurve *ec;
+        int res;
+
+        fprintf(stderr, "loading %s/%s.ecurve\n", dbdir, ecurve_names[i]);
+        ec = uproc_ecurve_load(UPROC_ECURVE_BINARY, UPROC_IO_GZIP,
+                               "%s/%s.ecurve", dbdir, ecurve_names[i]);
+        if (!ec) {
+            break;
+        }
+        res = uproc_ecurve_store_shm(ec, hugepage, DATABASE_SHM_FMT, name,
+                                     ecurve_names[i]);
+        uproc_ecurve_destroy(ec);
+        if (res) {
+            break;
+        }
+    }
+    if (i == ECURVE_COUNT) {
+        return 0;
+    }
+    while (i--) {
+        uproc_ecurve_unlink_shm(DATABASE_SHM_FMT, name, ecurve_names[i]);
+    }
+    return -1;
+}
+
+
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+static sigset_t term_signals;
+#endif
+
+/* Block the signals that ask the program to terminate, so that they can be
+ * handled by serve() instead of terminating without cleaning up */
+static void
+block_term_signals(void)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    sigemptyset(&term_signals);
+    sigaddset(&term_signals, SIGINT);
+    sigaddset(&term_signals, SIGTERM);
+    sigaddset(&term_signals, SIGHUP);
+    sigprocmask(SIG_BLOCK, &term_signals, NULL);
+#endif
+}
+
+
+/* Wait for one of the signals blocked by block_term_signals(), keeping the
+ * ecurves attached (and locked if requested) in the meantime */
+static int
+serve(const char *name, bool lock)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    int res = 0, sig;
+    uproc_ecurve *ec[ECURVE_COUNT] = { 0 };
+    struct uproc_ecurve_mmap_opts opts = UPROC_ECURVE_MMAP_OPTS_INITIALIZER;
+
+    opts.mlock = lock;
+    for (size_t i = 0; i < ECURVE_COUNT; i++) {
+        ec[i] = uproc_ecurve_attach_shm(&opts, DATABASE_SHM_FMT, name,
+                                        ecurve_names[i]);
+        if (!ec[i]) {
+            res = -1;
+            goto out;
+        }
+    }
+
+    fprintf(stderr, "ecurves available as \"%s\"\n", name);
+    sigwait(&term_signals, &sig);
+    fprintf(stderr, "removing ecurves\n");
+
+out:
+    for (size_t i = 0; i < ECURVE_COUNT; i++) {
+        uproc_ecurve_destroy(ec[i]);
+    }
+    return res;
+#else
+    (void) name;
+    (void) lock;
+    return uproc_error(UPROC_ENOTSUP);
+#endif
+}
+
+
+enum nonopt_args
+{
+    DBDIR, NAME,
+    ARGC
+};
+
+int main(int argc, char **argv)
+{
+    bool hugepage = false, lock = false, keep = false, remove = false;
+
+    int opt;
+    struct ppopts opts = PPOPTS_INITIALIZER;
+    make_opts(&opts, argv[0]);
+    while ((opt = ppopts_getopt(&opts, argc, argv)) != -1) {
+        switch (opt) {
+            case 'h':
+                ppopts_print(&opts, stderr, 80, 0);
+                return EXIT_SUCCESS;
+            case 'v':
+                print_version(PROGNAME);
+                return EXIT_SUCCESS;
+            case 'V':
+                uproc_features_print(uproc_stderr);
+                return EXIT_SUCCESS;
+            case 'H':
+                hugepage = true;
+                break;
+            case 'l':
+                lock = true;
+                break;
+            case 'k':
+                keep = true;
+                break;
+            case 'r':
+                remove = true;
+                break;
+            case '?':
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!uproc_features_shm()) {
+        fprintf(stderr, "shared memory is not supported on this system\n");
+        return EXIT_FAILURE;
+    }
+
+    if (remove) {
+        if (argc < optind + 1) {
+            ppopts_print(&opts, stderr, 80, 0);
+            return EXIT_FAILURE;
+        }
+        if (remove_ecurves(argv[argc - 1])) {
+            uproc_perror("error removing ecurves");
+            return EXIT_FAILURE;
+        }
+        return EXIT_SUCCESS;
+    }
+
+    if (argc < optind + ARGC) {
+        ppopts_print(&opts, stderr, 80, 0);
+        return EXIT_FAILURE;
+    }
+    if (keep && lock) {
+        fprintf(stderr, "-l and -k can't be used together\n");
+        return EXIT_FAILURE;
+    }
+
+    const char *name = argv[optind + NAME];
+    if (!keep) {
+        block_term_signals();
+    }
+    if (store_ecurves(argv[optind + DBDIR], name, hugepage)) {
+        uproc_perror("error storing ecurves");
+        return EXIT_FAILURE;
+    }
+    if (keep) {
+        fprintf(stderr, "ecurves available as \"%s\"\n", name);
+        return EXIT_SUCCESS;
+    }
+
+    int res = serve(name, lock);
+    if (res) {
+        uproc_perror("error");
+    }
+    remove_ecurves(name);
+    return res ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -224,11 +224,24 @@ make_opts(struct ppopts *o, const char *progname)
     ppopts_add_text(o, PROGNAME ", version " UPROC_VERSION);
     ppopts_add_text(o,
         "USAGE: %s [options] DBDIR MODELDIR [INPUTFILES]", progname);
+    ppopts_add_text(o,
+        "   or: %s [options] -C FILE [INPUTFILES]", progname);
 
     ppopts_add_header(o, "GENERAL OPTIONS:");
     O('h', "help",       "",    "Print this message and exit.");
     O('v', "version",    "",    "Print version and exit.");
     O('V', "libversion", "",    "Print libuproc version/features and exit.");
+#if HAVE_MMAP && USE_MMAP
+    O('C', "container", "FILE",
+      "Use the database and model in FILE, created by uproc-pack, instead "
+      "of DBDIR and MODELDIR (which are omitted).");
+    O('M', "mmap", "OPTS", MMAP_OPTS_DESC);
+#endif
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    O('S', "shm", "NAME",
+      "Use the ecurves that uproc-dbd keeps in shared memory under NAME "
+      "instead of the ones in DBDIR.");
+#endif
 
     ppopts_add_header(o, "OUTPUT OPTIONS:");
     O('o', "output", "FILE",
@@ -264,6 +277,10 @@ int main(int argc, char **argv)
 
     bool use_idmap = true;
     int prot_thresh_level = PROT_THRESH_DEFAULT;
+    struct uproc_ecurve_mmap_opts mmap_opts =
+        UPROC_ECURVE_MMAP_OPTS_INITIALIZER;
+    const char *container = NULL;
+    const char *shm_name = NULL;
 
     int opt;
     struct ppopts opts = PPOPTS_INITIALIZER;
@@ -296,35 +313,60 @@ int main(int argc, char **argv)
                     prot_thresh_level = tmp;
                 }
                 break;
+            case 'C':
+                container = optarg;
+                break;
+            case 'M':
+                if (parse_mmap_opts(optarg, &mmap_opts)) {
+                    fprintf(stderr, "invalid -M argument\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                shm_name = optarg;
+                break;
             case '?':
                 return EXIT_FAILURE;
         }
     }
 
-    if (argc < optind + ARGC - 1) {
+    /* DBDIR and MODELDIR are omitted if -C is used */
+    int dirs = container ? 0 : INFILES;
+    if (argc < optind + dirs) {
         ppopts_print(&opts, stderr, 80, PPOPTS_DESC_ON_NEXT_LINE);
         return EXIT_FAILURE;
     }
+    if (container && shm_name) {
+        fprintf(stderr, "-C and -S can't be used together\n");
+        return EXIT_FAILURE;
+    }
 
     struct database db;
     struct model model;
-    model_load(&model, argv[optind + MODELDIR], 0);
-    database_load(&db, argv[optind + DBDIR], prot_thresh_level,
-                  UPROC_ECURVE_BINARY);
+    if (container) {
+        container_load(&db, &model, container, prot_thresh_level, 0,
+                       &mmap_opts);
+    }
+    else {
+        model_load(&model, argv[optind + MODELDIR], 0);
+        database_load(&db, argv[optind + DBDIR], prot_thresh_level,
+                      UPROC_ECURVE_BINARY, &mmap_opts, shm_name);
+    }
 
     if (use_idmap) {
         idmap = db.idmap;
     }
     alpha = uproc_ecurve_alphabet(db.fwd);
     uproc_protclass *pc;
-    create_classifiers(&pc, NULL, &db, &model, false);
+    create_classifiers(&pc, NULL, &db, &model, false, false, 0, false, 0, 0,
+                       NULL);
 
-    if (argc < optind + ARGC) {
+    if (argc < optind + dirs + 1) {
         argv[argc++] = "-";
     }
 
-    for (; optind + INFILES < argc; optind++) {
-        uproc_io_stream *stream = open_read(argv[optind + INFILES]);
+    for (optind += dirs; optind < argc; optind++) {
+        uproc_io_stream *stream = open_read(argv[optind]);
         classify_file(stream, pc);
         uproc_io_close(stream);
     }
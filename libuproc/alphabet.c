@@ -92,6 +92,17 @@ uproc_alphabet_char_to_amino(const uproc_alphabet *alpha, int c)
     return alpha->aminos[(unsigned char)c];
 }
 
+void
+uproc_alphabet_translate(const uproc_alphabet *alpha, const char *seq,
+                         size_t len, uproc_amino *aminos)
+{
+    const uproc_amino *tab = alpha->aminos;
+    const unsigned char *s = (const unsigned char *)seq;
+    for (size_t i = 0; i < len; i++) {
+        aminos[i] = tab[s[i]];
+    }
+}
+
 int
 uproc_alphabet_amino_to_char(const uproc_alphabet *alpha,
                              uproc_amino amino)
@@ -0,0 +1,203 @@
+/* Scratch memory for classifying sequences
+ *
+ * Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+
+#if HAVE_PTHREAD_KEY_CREATE
+#include <pthread.h>
+#endif
+
+#include "uproc/error.h"
+#include "classify_internal.h"
+
+static struct uproc_classify_ctx_s *thread_ctx;
+#if _OPENMP
+#pragma omp threadprivate(thread_ctx)
+#endif
+
+#if HAVE_PTHREAD_KEY_CREATE
+/* Nested parallel regions may run on threads that only live for a single
+ * region, so their workspaces are destroyed when the thread exits. */
+static pthread_key_t thread_key;
+static pthread_once_t thread_key_once = PTHREAD_ONCE_INIT;
+static bool thread_key_valid;
+
+static void
+thread_ctx_destroy(void *ctx)
+{
+    uproc_classify_ctx_destroy(ctx);
+}
+
+static void
+thread_key_create(void)
+{
+    thread_key_valid = !pthread_key_create(&thread_key, thread_ctx_destroy);
+}
+#endif
+
+
+uproc_classify_ctx *
+uproc_classify_ctx_create(void)
+{
+    struct uproc_classify_ctx_s *ctx = calloc(1, sizeof *ctx);
+    if (!ctx) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
+    }
+    return ctx;
+}
+
+
+void
+uproc_classify_ctx_destroy(uproc_classify_ctx *ctx)
+{
+    if (!ctx) {
+        return;
+    }
+    protclass_ctx_free(ctx);
+    dnaclass_ctx_free(ctx);
+    topk_free(&ctx->prot_top);
+    topk_free(&ctx->dna_top);
+    free(ctx);
+}
+
+
+void
+uproc_classify_ctx_cache_stats(const uproc_classify_ctx *ctx,
+                               unsigned long long *lookups,
+                               unsigned long long *hits)
+{
+    *lookups = ctx->cache_lookups;
+    *hits = ctx->cache_hits;
+}
+
+
+uproc_classify_ctx *
+uproc_classify_ctx_thread(void)
+{
+    if (!thread_ctx) {
+        thread_ctx = uproc_classify_ctx_create();
+#if HAVE_PTHREAD_KEY_CREATE
+        pthread_once(&thread_key_once, thread_key_create);
+        if (thread_ctx && thread_key_valid) {
+            pthread_setspecific(thread_key, thread_ctx);
+        }
+#endif
+    }
+    return thread_ctx;
+}
+
+
+/* whether `a` ranks before `b` */
+static bool
+topk_better(const struct topk_item *a, const struct topk_item *b)
+{
+    return a->score > b->score ||
+           (a->score == b->score && a->family < b->family);
+}
+
+static int
+topk_cmp(const void *p1, const void *p2)
+{
+    const struct topk_item *a = p1, *b = p2;
+    return topk_better(b, a) - topk_better(a, b);
+}
+
+int
+topk_reset(struct topk *t, size_t k)
+{
+    if (k > t->alloc) {
+        struct topk_item *tmp = realloc(t->items, k * sizeof *tmp);
+        if (!tmp) {
+            uproc_error(UPROC_ENOMEM);
+            return -1;
+        }
+        t->items = tmp;
+        t->alloc = k;
+    }
+    t->k = k;
+    t->n = 0;
+    return 0;
+}
+
+void
+topk_push(struct topk *t, double score, uproc_family family, size_t index)
+{
+    struct topk_item item = {
+        .score = score,
+        .family = family,
+        .index = index,
+    };
+    size_t i;
+
+    if (t->n < t->k) {
+        /* sift up */
+        i = t->n++;
+        while (i) {
+            size_t parent = (i - 1) / 2;
+            if (!topk_better(&t->items[parent], &item)) {
+                break;
+            }
+            t->items[i] = t->items[parent];
+            i = parent;
+        }
+        t->items[i] = item;
+        return;
+    }
+    if (!t->n || !topk_better(&item, &t->items[0])) {
+        return;
+    }
+
+    /* replace the root and sift down */
+    i = 0;
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= t->n) {
+            break;
+        }
+        if (child + 1 < t->n &&
+            topk_better(&t->items[child], &t->items[child + 1])) {
+            child++;
+        }
+        if (!topk_better(&item, &t->items[child])) {
+            break;
+        }
+        t->items[i] = t->items[child];
+        i = child;
+    }
+    t->items[i] = item;
+}
+
+void
+topk_sort(struct topk *t)
+{
+    qsort(t->items, t->n, sizeof *t->items, topk_cmp);
+}
+
+void
+topk_free(struct topk *t)
+{
+    free(t->items);
+    *t = (struct topk) { 0 };
+}
@@ -0,0 +1,160 @@
+#ifndef UPROC_CLASSIFY_INTERNAL_H
+#define UPROC_CLASSIFY_INTERNAL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "uproc/alphabet.h"
+#include "uproc/classify.h"
+#include "uproc/common.h"
+#include "uproc/list.h"
+#include "uproc/orf.h"
+#include "uproc/protclass.h"
+#include "uproc/word.h"
+
+/* Defined in protclass.c and dnaclass.c */
+struct scoretab;
+struct nbcache;
+struct sortbatch;
+struct maxtab;
+struct orfbatch;
+
+/* Bounded heap keeping the `k` best of the scores pushed into it, used for
+ * the TOP_K classification modes
+ *
+ * The worst retained item is at the root, so that it can be replaced in
+ * O(log k). Ties are won by the lower family, like in the MAX modes. */
+struct topk
+{
+    size_t k, n, alloc;
+    struct topk_item
+    {
+        double score;
+        uproc_family family;
+        /* position of the result in the caller's table */
+        size_t index;
+    } *items;
+};
+
+/* Empty the heap and make room for `k` items */
+int topk_reset(struct topk *t, size_t k);
+
+/* Offer an item; it is discarded if the heap holds `k` better ones */
+void topk_push(struct topk *t, double score, uproc_family family,
+               size_t index);
+
+/* Sort the retained items by descending score (destroys the heap order) */
+void topk_sort(struct topk *t);
+
+void topk_free(struct topk *t);
+
+struct uproc_classify_ctx_s
+{
+    /* Used by uproc_protclass_classify_ctx() */
+    uproc_amino *aminos;
+    size_t aminos_alloc;
+    struct scoretab *scores;
+    struct topk prot_top;
+    struct nbcache *nbcache;
+    unsigned long long cache_lookups, cache_hits;
+    struct sortbatch *sortbatch;
+
+    /* Used by uproc_dnaclass_classify_ctx() */
+    uproc_orfiter *orfiter;
+    uproc_list *orf_results;
+    struct maxtab *max_scores;
+    struct topk dna_top;
+    struct orfbatch *orfbatch;
+
+    /* ORF buffers taken from the results of the previous sequence, to be
+     * reused for the results of the next one */
+    struct orfbuf
+    {
+        char *data;
+        size_t size;
+    } *orfbufs;
+    size_t orfbufs_n, orfbufs_alloc;
+};
+
+/* Like uproc_orfiter_reset(), but yield the ORFs as amino acid codes
+ * instead of strings, so that they can be classified without translating
+ * them first
+ *
+ * Each byte of an ORF's data is the ::uproc_amino of `alpha` for the
+ * respective amino acid or, for characters that aren't in `alpha` (i.e. the
+ * wildcard 'X'), the character itself, which is always greater than any
+ * valid amino acid. The ORFs passed to `filter` have no data at all. */
+void orfiter_reset_aminos(uproc_orfiter *iter, const char *seq,
+                          const double *codon_scores,
+                          uproc_orffilter *filter, void *filter_arg,
+                          const uproc_alphabet *alpha);
+
+/* Amino acid represented by an ORF code, or -1 if it's not in the alphabet */
+static inline uproc_amino
+orf_code_amino(unsigned char c)
+{
+    return c < UPROC_ALPHABET_SIZE ? (uproc_amino) c : -1;
+}
+
+/* Character represented by an ORF code */
+static inline int
+orf_code_char(const uproc_alphabet *alpha, unsigned char c)
+{
+    return c < UPROC_ALPHABET_SIZE ? uproc_alphabet_amino_to_char(alpha, c)
+                                   : c;
+}
+
+/* Sequence looked up in a ::uproc_protmemo
+ *
+ * `config` identifies the settings of the classifier, so that classifiers
+ * that would produce different results never see each other's. */
+struct protmemo_key
+{
+    const char *seq;
+    size_t len;
+    uint64_t config, hash;
+};
+
+/* Fingerprint of the `size` bytes of classifier settings at `settings` */
+uint64_t protmemo_config(const void *settings, size_t size);
+
+void protmemo_key_init(struct protmemo_key *key, uint64_t config,
+                       const char *seq, size_t len);
+
+/* Append the memoized results of a sequence to `results`
+ *
+ * Returns 1 if the sequence was found, 0 if not and -1 on error. */
+int protmemo_get(uproc_protmemo *memo, const struct protmemo_key *key,
+                 uproc_list *results);
+
+/* Memoize the results of a sequence, evicting the least recently used
+ * sequences if necessary */
+int protmemo_put(uproc_protmemo *memo, const struct protmemo_key *key,
+                 const uproc_list *results);
+
+/* Upper bound for the score of any family for a protein sequence of length
+ * `seq_len`, as used for pruning (see uproc_protclass_set_thresh()), or
+ * -INFINITY if the sequence can't have any results */
+double protclass_score_max(const uproc_protclass *pc, size_t seq_len);
+
+/* Alphabet of the amino acid codes expected by protclass_classify_codes() */
+const uproc_alphabet *protclass_alphabet(const uproc_protclass *pc);
+
+/* Like uproc_protclass_classify_ctx() and uproc_protclass_classify_many(),
+ * but for ORFs yielded by orfiter_reset_aminos() with protclass_alphabet()
+ *
+ * The `seq` argument of the protein filter is NULL for these. */
+int protclass_classify_codes(const uproc_protclass *pc,
+                             uproc_classify_ctx *ctx, const char *codes,
+                             size_t len, uproc_list **results);
+int protclass_classify_many_codes(const uproc_protclass *pc,
+                                  uproc_classify_ctx *ctx,
+                                  const char *const *codes,
+                                  const size_t *lens, size_t n,
+                                  uproc_list **results);
+
+/* Free the parts of the workspace that belong to the respective module */
+void protclass_ctx_free(struct uproc_classify_ctx_s *ctx);
+void dnaclass_ctx_free(struct uproc_classify_ctx_s *ctx);
+
+#endif
@@ -0,0 +1,686 @@
+/* Single-file container for the objects of a database
+ *
+ * Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+
+#if HAVE_MMAP && USE_MMAP
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#include "uproc/common.h"
+#include "uproc/error.h"
+#include "uproc/container.h"
+
+#include "ecurve_internal.h"
+#include "io_internal.h"
+
+#define CONTAINER_MAGIC "UPROCDB"
+#define CONTAINER_BYTE_ORDER 0x01020304UL
+
+/** File header */
+struct container_header
+{
+    /** #CONTAINER_MAGIC, including the terminating zero */
+    char magic[8];
+
+    /** #UPROC_CONTAINER_VERSION */
+    uint32_t version;
+
+    /** #CONTAINER_BYTE_ORDER, as written by the creating machine */
+    uint32_t byte_order;
+
+    /** Size of `size_t` on the creating machine */
+    uint32_t word_size;
+
+    /** Number of sections */
+    uint32_t section_count;
+
+    /** Total file size */
+    uint64_t size;
+};
+
+enum container_type
+{
+    CONTAINER_ECURVE = 1,
+    CONTAINER_IDMAP,
+    CONTAINER_MATRIX,
+    CONTAINER_SUBSTMAT,
+};
+
+/** Entry of the section table, which follows the header */
+struct container_section
+{
+    /** Zero-terminated section name */
+    char name[UPROC_CONTAINER_NAME_MAX + 1];
+
+    /** Object type, see ::container_type */
+    uint32_t type;
+
+    uint32_t reserved;
+
+    /** Offset from the start of the file, a multiple of
+     * #UPROC_CONTAINER_ALIGN */
+    uint64_t offset;
+
+    /** Size in bytes */
+    uint64_t size;
+
+    uint64_t reserved2;
+};
+
+/* Section contents besides ecurves (which use the mmap image format):
+ *
+ * matrix:      uint64_t rows, cols; double values[rows * cols]
+ * substmat:    double dists[UPROC_SUFFIX_LEN][UPROC_ALPHABET_SIZE]
+ *                          [UPROC_ALPHABET_SIZE]
+ * idmap:       uint64_t count; uint64_t offsets[count]; followed by the
+ *              zero-terminated names, `offsets` being relative to the first
+ *              one
+ */
+#define SIZE_MATRIX(rows, cols) \
+    (2 * sizeof (uint64_t) + (rows) * (cols) * sizeof (double))
+#define SIZE_SUBSTMAT \
+    (UPROC_SUFFIX_LEN * UPROC_ALPHABET_SIZE * UPROC_ALPHABET_SIZE * \
+     sizeof (double))
+#define ALIGN_SECTION(x) \
+    (((x) + UPROC_CONTAINER_ALIGN - 1) / UPROC_CONTAINER_ALIGN * \
+     UPROC_CONTAINER_ALIGN)
+
+struct uproc_container_s
+{
+    /** Section table */
+    struct container_section *sections;
+
+    /** Number of sections */
+    size_t count;
+
+    /** While building: number of sections `#sections` and `#objects` are
+     * allocated to hold */
+    size_t alloc;
+
+    /** While building: objects added to the container */
+    const void **objects;
+
+    /** Mapped file (NULL while building) */
+    char *region;
+
+    /** Size of the mapped file */
+    size_t size;
+};
+
+
+static const struct container_section *
+find_section(const struct uproc_container_s *c, const char *name)
+{
+    for (size_t i = 0; i < c->count; i++) {
+        if (!strcmp(c->sections[i].name, name)) {
+            return &c->sections[i];
+        }
+    }
+    return NULL;
+}
+
+
+uproc_container *
+uproc_container_create(void)
+{
+    struct uproc_container_s *c = malloc(sizeof *c);
+    if (!c) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
+    }
+    *c = (struct uproc_container_s){ 0 };
+    return c;
+}
+
+
+void
+uproc_container_destroy(uproc_container *container)
+{
+    if (!container) {
+        return;
+    }
+    if (container->region) {
+#if HAVE_MMAP && USE_MMAP
+        munmap(container->region, container->size);
+#endif
+    }
+    else {
+        free(container->sections);
+        free(container->objects);
+    }
+    free(container);
+}
+
+
+static int
+add(struct uproc_container_s *c, const char *name, enum container_type type,
+    const void *obj)
+{
+    if (c->region) {
+        return uproc_error_msg(UPROC_EINVAL,
+                               "can't add to a mapped container");
+    }
+    if (strlen(name) > UPROC_CONTAINER_NAME_MAX) {
+        return uproc_error_msg(UPROC_EINVAL, "section name too long: %s",
+                               name);
+    }
+    if (find_section(c, name)) {
+        return uproc_error_msg(UPROC_EEXIST, "duplicate section %s", name);
+    }
+    if (c->count == c->alloc) {
+        size_t alloc = c->alloc ? c->alloc * 2 : 8;
+        void *tmp = realloc(c->sections, alloc * sizeof *c->sections);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        c->sections = tmp;
+        tmp = realloc(c->objects, alloc * sizeof *c->objects);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        c->objects = tmp;
+        c->alloc = alloc;
+    }
+    c->sections[c->count] = (struct container_section){ .type = type };
+    strcpy(c->sections[c->count].name, name);
+    c->objects[c->count] = obj;
+    c->count++;
+    return 0;
+}
+
+
+int
+uproc_container_add_ecurve(uproc_container *container, const char *name,
+                           const uproc_ecurve *ecurve)
+{
+    return add(container, name, CONTAINER_ECURVE, ecurve);
+}
+
+
+int
+uproc_container_add_idmap(uproc_container *container, const char *name,
+                          const uproc_idmap *idmap)
+{
+    return add(container, name, CONTAINER_IDMAP, idmap);
+}
+
+
+int
+uproc_container_add_matrix(uproc_container *container, const char *name,
+                           const uproc_matrix *matrix)
+{
+    return add(container, name, CONTAINER_MATRIX, matrix);
+}
+
+
+int
+uproc_container_add_substmat(uproc_container *container, const char *name,
+                             const uproc_substmat *substmat)
+{
+    return add(container, name, CONTAINER_SUBSTMAT, substmat);
+}
+
+
+#if HAVE_MMAP && USE_MMAP
+static uproc_family
+idmap_count(const uproc_idmap *idmap)
+{
+    uproc_family n = 0;
+    while (n < UPROC_FAMILY_MAX && uproc_idmap_str(idmap, n)) {
+        n++;
+    }
+    return n;
+}
+
+
+static uint64_t
+section_size(enum container_type type, const void *obj)
+{
+    switch (type) {
+        case CONTAINER_ECURVE:
+            return ecurve_image_size(obj);
+        case CONTAINER_IDMAP: {
+            uproc_family n = idmap_count(obj);
+            uint64_t size = (n + 1) * sizeof (uint64_t);
+            for (uproc_family i = 0; i < n; i++) {
+                size += strlen(uproc_idmap_str(obj, i)) + 1;
+            }
+            return size;
+        }
+        case CONTAINER_MATRIX: {
+            unsigned long rows, cols;
+            uproc_matrix_dimensions(obj, &rows, &cols);
+            return SIZE_MATRIX(rows, cols);
+        }
+        case CONTAINER_SUBSTMAT:
+            return SIZE_SUBSTMAT;
+    }
+    return 0;
+}
+
+
+static void
+section_write(enum container_type type, const void *obj, char *dst)
+{
+    switch (type) {
+        case CONTAINER_ECURVE:
+            ecurve_image_write(obj, dst);
+            break;
+        case CONTAINER_IDMAP: {
+            uint64_t n = idmap_count(obj), *offsets = (void *)dst, pos = 0;
+            char *names = dst + (n + 1) * sizeof *offsets;
+            offsets[0] = n;
+            for (uint64_t i = 0; i < n; i++) {
+                const char *s = uproc_idmap_str(obj, i);
+                size_t len = strlen(s) + 1;
+                offsets[i + 1] = pos;
+                memcpy(names + pos, s, len);
+                pos += len;
+            }
+            break;
+        }
+        case CONTAINER_MATRIX: {
+            unsigned long rows, cols;
+            uint64_t *dims = (void *)dst;
+            double *values = (void *)(dims + 2);
+            uproc_matrix_dimensions(obj, &rows, &cols);
+            dims[0] = rows;
+            dims[1] = cols;
+            for (unsigned long i = 0; i < rows; i++) {
+                for (unsigned long j = 0; j < cols; j++) {
+                    *values++ = uproc_matrix_get(obj, i, j);
+                }
+            }
+            break;
+        }
+        case CONTAINER_SUBSTMAT: {
+            double *values = (void *)dst;
+            for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+                for (uproc_amino x = 0; x < UPROC_ALPHABET_SIZE; x++) {
+                    for (uproc_amino y = 0; y < UPROC_ALPHABET_SIZE; y++) {
+                        *values++ = uproc_substmat_get(obj, i, x, y);
+                    }
+                }
+            }
+            break;
+        }
+    }
+}
+#endif
+
+
+static int
+store(const struct uproc_container_s *c, const char *path)
+{
+#if HAVE_MMAP && USE_MMAP
+    int fd;
+    char *region;
+    uint64_t size;
+    struct container_section *sections;
+    struct container_header header = {
+        .magic = CONTAINER_MAGIC,
+        .version = UPROC_CONTAINER_VERSION,
+        .byte_order = CONTAINER_BYTE_ORDER,
+        .word_size = sizeof (size_t),
+        .section_count = c->count,
+    };
+
+    if (c->region) {
+        return uproc_error_msg(UPROC_EINVAL,
+                               "can't store a mapped container");
+    }
+
+    size = sizeof header + c->count * sizeof *sections;
+    for (size_t i = 0; i < c->count; i++) {
+        size = ALIGN_SECTION(size) +
+               section_size(c->sections[i].type, c->objects[i]);
+    }
+    header.size = size;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return uproc_error_msg(UPROC_ERRNO, "failed to open %s", path);
+    }
+    if (ftruncate(fd, size)) {
+        close(fd);
+        return uproc_error_msg(UPROC_ERRNO, "failed to allocate space");
+    }
+    region = mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED) {
+        return uproc_error_msg(UPROC_ERRNO, "mmap failed");
+    }
+
+    memcpy(region, &header, sizeof header);
+    sections = (void *)(region + sizeof header);
+    size = sizeof header + c->count * sizeof *sections;
+    for (size_t i = 0; i < c->count; i++) {
+        sections[i] = c->sections[i];
+        sections[i].offset = ALIGN_SECTION(size);
+        sections[i].size = section_size(sections[i].type, c->objects[i]);
+        section_write(sections[i].type, c->objects[i],
+                      region + sections[i].offset);
+        size = sections[i].offset + sections[i].size;
+    }
+    munmap(region, header.size);
+    return 0;
+#else
+    (void) c;
+    (void) path;
+    return uproc_error(UPROC_ENOTSUP);
+#endif
+}
+
+
+int
+uproc_container_store(const uproc_container *container, const char *pathfmt,
+                      ...)
+{
+    int res;
+    va_list ap;
+    va_start(ap, pathfmt);
+    res = uproc_container_storev(container, pathfmt, ap);
+    va_end(ap);
+    return res;
+}
+
+
+int
+uproc_container_storev(const uproc_container *container, const char *pathfmt,
+                       va_list ap)
+{
+    int res;
+    char *buf;
+
+    buf = io_vformat(pathfmt, ap);
+    if (!buf) {
+        return -1;
+    }
+    res = store(container, buf);
+    free(buf);
+    return res;
+}
+
+
+#if HAVE_MMAP && USE_MMAP
+/* Check the header and section table of the mapped file */
+static int
+check(struct uproc_container_s *c)
+{
+    struct container_header *header = (void *)c->region;
+
+    if (c->size < sizeof *header ||
+        memcmp(header->magic, CONTAINER_MAGIC, sizeof header->magic)) {
+        return uproc_error_msg(UPROC_EINVAL, "not a container file");
+    }
+    if (header->byte_order != CONTAINER_BYTE_ORDER ||
+        header->word_size != sizeof (size_t)) {
+        return uproc_error_msg(UPROC_EINVAL,
+                               "container file was created on an "
+                               "incompatible machine");
+    }
+    if (header->version != UPROC_CONTAINER_VERSION) {
+        return uproc_error_msg(UPROC_EINVAL,
+                               "unsupported container version %lu",
+                               (unsigned long)header->version);
+    }
+    c->count = header->section_count;
+    c->sections = (void *)(c->region + sizeof *header);
+    if (header->size != c->size ||
+        (c->size - sizeof *header) / sizeof *c->sections < c->count) {
+        return uproc_error_msg(UPROC_EINVAL, "container file truncated");
+    }
+    for (size_t i = 0; i < c->count; i++) {
+        struct container_section *s = &c->sections[i];
+        if (s->offset % UPROC_CONTAINER_ALIGN || s->offset > c->size ||
+            s->size > c->size - s->offset ||
+            s->name[UPROC_CONTAINER_NAME_MAX]) {
+            return uproc_error_msg(UPROC_EINVAL,
+                                   "invalid container section table");
+        }
+    }
+    return 0;
+}
+#endif
+
+
+static uproc_container *
+container_mmap(const struct uproc_ecurve_mmap_opts *opts, const char *path)
+{
+#if HAVE_MMAP && USE_MMAP
+    static const struct uproc_ecurve_mmap_opts default_opts =
+        UPROC_ECURVE_MMAP_OPTS_INITIALIZER;
+    struct uproc_container_s *c;
+    void *region;
+    size_t size;
+    int fd, res;
+
+    fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        uproc_error_msg(UPROC_ERRNO, "failed to open %s", path);
+        return NULL;
+    }
+    res = ecurve_map_region(fd, MAP_PRIVATE, opts ? opts : &default_opts,
+                            &region, &size);
+    close(fd);
+    if (res) {
+        return NULL;
+    }
+
+    c = uproc_container_create();
+    if (!c) {
+        munmap(region, size);
+        return NULL;
+    }
+    c->region = region;
+    c->size = size;
+    if (check(c)) {
+        uproc_container_destroy(c);
+        return NULL;
+    }
+    return c;
+#else
+    (void) opts;
+    (void) path;
+    uproc_error(UPROC_ENOTSUP);
+    return NULL;
+#endif
+}
+
+
+uproc_container *
+uproc_container_mmap(const struct uproc_ecurve_mmap_opts *opts,
+                     const char *pathfmt, ...)
+{
+    uproc_container *c;
+    va_list ap;
+    va_start(ap, pathfmt);
+    c = uproc_container_mmapv(opts, pathfmt, ap);
+    va_end(ap);
+    return c;
+}
+
+
+uproc_container *
+uproc_container_mmapv(const struct uproc_ecurve_mmap_opts *opts,
+                      const char *pathfmt, va_list ap)
+{
+    uproc_container *c;
+    char *buf;
+
+    buf = io_vformat(pathfmt, ap);
+    if (!buf) {
+        return NULL;
+    }
+    c = container_mmap(opts, buf);
+    free(buf);
+    return c;
+}
+
+
+/* Find a section of the given type in a mapped container */
+static char *
+get(const struct uproc_container_s *c, const char *name,
+    enum container_type type, uint64_t *size)
+{
+    const struct container_section *s;
+
+    if (!c->region) {
+        uproc_error_msg(UPROC_EINVAL, "container is not mapped");
+        return NULL;
+    }
+    s = find_section(c, name);
+    if (!s) {
+        uproc_error_msg(UPROC_ENOENT, "no section %s in container", name);
+        return NULL;
+    }
+    if (s->type != type) {
+        uproc_error_msg(UPROC_EINVAL, "section %s has the wrong type", name);
+        return NULL;
+    }
+    *size = s->size;
+    return c->region + s->offset;
+}
+
+
+uproc_ecurve *
+uproc_container_ecurve(const uproc_container *container, const char *name)
+{
+    uint64_t size;
+    char *p = get(container, name, CONTAINER_ECURVE, &size);
+    if (!p) {
+        return NULL;
+    }
+#if HAVE_MMAP && USE_MMAP
+    return ecurve_image_attach(p, size);
+#else
+    (void) size;
+    return NULL;
+#endif
+}
+
+
+uproc_idmap *
+uproc_container_idmap(const uproc_container *container, const char *name)
+{
+    uint64_t size, n, *offsets;
+    const char *names;
+    uproc_idmap *idmap;
+    char *p = get(container, name, CONTAINER_IDMAP, &size);
+    if (!p) {
+        return NULL;
+    }
+
+    offsets = (void *)p;
+    n = size < sizeof *offsets ? UINT64_MAX : offsets[0];
+    if (n > UPROC_FAMILY_MAX || size < (n + 1) * sizeof *offsets) {
+        uproc_error_msg(UPROC_EINVAL, "invalid idmap section %s", name);
+        return NULL;
+    }
+    names = p + (n + 1) * sizeof *offsets;
+    size -= (n + 1) * sizeof *offsets;
+    if (size && names[size - 1]) {
+        uproc_error_msg(UPROC_EINVAL, "invalid idmap section %s", name);
+        return NULL;
+    }
+
+    idmap = uproc_idmap_create();
+    if (!idmap) {
+        return NULL;
+    }
+    /* the names were distinct when the container was written */
+    for (uint64_t i = 0; i < n; i++) {
+        if (offsets[i + 1] >= size) {
+            uproc_error_msg(UPROC_EINVAL, "invalid idmap section %s", name);
+            goto error;
+        }
+        if (uproc_idmap_append(idmap, names + offsets[i + 1]) != i) {
+            goto error;
+        }
+    }
+    return idmap;
+
+error:
+    uproc_idmap_destroy(idmap);
+    return NULL;
+}
+
+
+uproc_matrix *
+uproc_container_matrix(const uproc_container *container, const char *name)
+{
+    uint64_t size, *dims;
+    char *p = get(container, name, CONTAINER_MATRIX, &size);
+    if (!p) {
+        return NULL;
+    }
+    dims = (void *)p;
+    if (size < SIZE_MATRIX(0, 0) ||
+        (dims[1] && dims[0] > (size - SIZE_MATRIX(0, 0)) / sizeof (double) /
+                              dims[1]) ||
+        size != SIZE_MATRIX(dims[0], dims[1])) {
+        uproc_error_msg(UPROC_EINVAL, "invalid matrix section %s", name);
+        return NULL;
+    }
+    return uproc_matrix_create(dims[0], dims[1], (void *)(dims + 2));
+}
+
+
+uproc_substmat *
+uproc_container_substmat(const uproc_container *container, const char *name)
+{
+    uint64_t size;
+    const double *values;
+    uproc_substmat *mat;
+    char *p = get(container, name, CONTAINER_SUBSTMAT, &size);
+    if (!p) {
+        return NULL;
+    }
+    if (size != SIZE_SUBSTMAT) {
+        uproc_error_msg(UPROC_EINVAL, "invalid substmat section %s", name);
+        return NULL;
+    }
+    mat = uproc_substmat_create();
+    if (!mat) {
+        return NULL;
+    }
+    values = (void *)p;
+    for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        for (uproc_amino x = 0; x < UPROC_ALPHABET_SIZE; x++) {
+            for (uproc_amino y = 0; y < UPROC_ALPHABET_SIZE; y++) {
+                uproc_substmat_set(mat, i, x, y, *values++);
+            }
+        }
+    }
+    return mat;
+}
@@ -30,11 +30,11 @@
 #include "uproc/common.h"
 #include "uproc/codon.h"
 #include "uproc/error.h"
-#include "uproc/bst.h"
 #include "uproc/list.h"
 #include "uproc/dnaclass.h"
 #include "uproc/protclass.h"
 #include "uproc/orf.h"
+#include "classify_internal.h"
 
 struct uproc_dnaclass_s
 {
@@ -43,6 +43,7 @@ struct uproc_dnaclass_s
     double codon_scores[UPROC_BINARY_CODON_COUNT];
     uproc_orffilter *orf_filter;
     void *orf_filter_arg;
+    size_t top_k;
 };
 
 uproc_dnaclass *
@@ -67,6 +68,7 @@ uproc_dnaclass_create(enum uproc_dnaclass_mode mode, const uproc_protclass *pc,
         .pc = pc,
         .orf_filter = orf_filter,
         .orf_filter_arg = orf_filter_arg,
+        .top_k = 1,
     };
     uproc_orf_codonscores(dc->codon_scores, codon_scores);
     return dc;
@@ -79,132 +81,722 @@ uproc_dnaclass_destroy(uproc_dnaclass *dc)
 }
 
 
+/* ORFs of one or many sequences, part of the classification workspace
+ *
+ * The amino acid codes of the ORFs (see orfiter_reset_aminos()) are stored
+ * one after another in `buf`, which is reused for the next sequences like
+ * the result lists. Strings are only made of the ORFs that end up in the
+ * results, by results_append(). */
+struct orfbatch
+{
+    size_t n, alloc;
+    struct orfbatch_orf
+    {
+        /* position of the sequence in the input */
+        size_t seq;
+        /* position of the ORF's codes in `buf` */
+        size_t offset;
+        struct uproc_orf orf;
+    } *orfs;
+    const char **data;
+    size_t *lens;
+    uproc_list **results;
+    /* order of evaluation in the UPROC_DNACLASS_MAX mode */
+    struct orfbatch_rank
+    {
+        size_t length;
+        double score;
+        size_t orf;
+    } *rank;
+
+    char *buf;
+    size_t buf_len, buf_alloc;
+};
+
+
+static struct orfbatch *
+orfbatch_get(struct uproc_classify_ctx_s *ctx)
+{
+    if (!ctx->orfbatch) {
+        ctx->orfbatch = calloc(1, sizeof *ctx->orfbatch);
+        if (!ctx->orfbatch) {
+            uproc_error(UPROC_ENOMEM);
+        }
+    }
+    return ctx->orfbatch;
+}
+
+
+static int
+orfbatch_append(struct orfbatch *ob, size_t seq, const struct uproc_orf *orf)
+{
+    size_t len = orf->length;
+
+    if (ob->n == ob->alloc) {
+        size_t alloc = ob->alloc ? ob->alloc * 2 : 256;
+        void *tmp;
+        tmp = realloc(ob->orfs, alloc * sizeof *ob->orfs);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ob->orfs = tmp;
+        tmp = realloc(ob->data, alloc * sizeof *ob->data);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ob->data = tmp;
+        tmp = realloc(ob->lens, alloc * sizeof *ob->lens);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ob->lens = tmp;
+        tmp = realloc(ob->results, alloc * sizeof *ob->results);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ob->results = tmp;
+        tmp = realloc(ob->rank, alloc * sizeof *ob->rank);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ob->rank = tmp;
+        for (size_t i = ob->alloc; i < alloc; i++) {
+            ob->results[i] = NULL;
+        }
+        ob->alloc = alloc;
+    }
+    if (ob->buf_alloc - ob->buf_len < len) {
+        size_t alloc = ob->buf_alloc ? ob->buf_alloc : 4096;
+        void *tmp;
+        while (alloc - ob->buf_len < len) {
+            alloc *= 2;
+        }
+        tmp = realloc(ob->buf, alloc);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ob->buf = tmp;
+        ob->buf_alloc = alloc;
+    }
+    memcpy(ob->buf + ob->buf_len, orf->data, len);
+    ob->orfs[ob->n++] = (struct orfbatch_orf) {
+        .seq = seq,
+        .offset = ob->buf_len,
+        .orf = *orf,
+    };
+    ob->buf_len += len;
+    return 0;
+}
+
+
+/* Best-scoring ORF of each family predicted for a sequence, part of the
+ * classification workspace
+ *
+ * Works like the score table in protclass.c. The ORFs are referred to by
+ * their index in the ::orfbatch they are stored in, so a new maximum
+ * doesn't need a copy of the ORF. In the ::UPROC_DNACLASS_MAX mode, only
+ * the best entry is kept and `slot` isn't used. */
+struct maxtab
+{
+    uproc_family slot[UPROC_FAMILY_MAX + 1];
+    size_t n, alloc;
+    struct maxtab_entry
+    {
+        uproc_family family;
+        double score;
+        size_t orf;
+    } *entries;
+};
+
+
+static struct maxtab *
+maxtab_get(struct uproc_classify_ctx_s *ctx)
+{
+    if (!ctx->max_scores) {
+        ctx->max_scores = calloc(1, sizeof *ctx->max_scores);
+        if (!ctx->max_scores) {
+            uproc_error(UPROC_ENOMEM);
+        }
+    }
+    return ctx->max_scores;
+}
+
+
 static void
-map_list_dnaresult_free(void *value, void *opaque)
+maxtab_reset(struct maxtab *tab)
+{
+    for (size_t i = 0; i < tab->n; i++) {
+        tab->slot[tab->entries[i].family] = 0;
+    }
+    tab->n = 0;
+}
+
+
+static int
+maxtab_cmp(const void *p1, const void *p2)
+{
+    const struct maxtab_entry *e1 = p1, *e2 = p2;
+    return (e1->family > e2->family) - (e1->family < e2->family);
+}
+
+
+/* Copy an ORF whose data are amino acid codes, turning them into a string
+ * in the buffer `dest->data` of `*size` bytes if it is large enough.
+ *
+ * Otherwise the buffer is grown to at least `reserve` bytes (rounded up to a
+ * power of two), which is enough for any ORF of the current sequence, so
+ * that buffers rarely have to grow again for sequences of similar length. */
+static int
+orf_string_to(struct uproc_orf *dest, size_t *size,
+              const struct uproc_orf *src, const uproc_alphabet *alpha,
+              size_t reserve)
 {
-    (void) opaque;
-    uproc_dnaresult_free(value);
+    size_t len = src->length + 1;
+    char *data = dest->data;
+    if (!data || *size < len) {
+        size_t sz = 64;
+        while (sz < len || sz < reserve) {
+            sz *= 2;
+        }
+        data = realloc(data, sz);
+        if (!data) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        *size = sz;
+    }
+    for (size_t i = 0; i < src->length; i++) {
+        data[i] = orf_code_char(alpha, src->data[i]);
+    }
+    data[src->length] = '\0';
+    *dest = *src;
+    dest->data = data;
+    return 0;
 }
 
 
+static int
+maxtab_grow(struct maxtab *tab)
+{
+    size_t alloc = tab->alloc ? tab->alloc * 2 : 64;
+    void *tmp = realloc(tab->entries, alloc * sizeof *tab->entries);
+    if (!tmp) {
+        return uproc_error(UPROC_ENOMEM);
+    }
+    tab->entries = tmp;
+    tab->alloc = alloc;
+    return 0;
+}
+
+
+static int
+maxtab_update(struct maxtab *tab, const struct uproc_protresult *pp,
+              size_t orf)
+{
+    struct maxtab_entry *e;
+    uproc_family slot = tab->slot[pp->family];
+
+    if (slot) {
+        e = &tab->entries[slot - 1];
+        if (!(pp->score > e->score)) {
+            return 0;
+        }
+    }
+    else {
+        if (!(pp->score > -INFINITY)) {
+            return 0;
+        }
+        if (tab->n == tab->alloc && maxtab_grow(tab)) {
+            return -1;
+        }
+        e = &tab->entries[tab->n];
+        tab->slot[pp->family] = ++tab->n;
+    }
+    e->family = pp->family;
+    e->score = pp->score;
+    e->orf = orf;
+    return 0;
+}
+
+
+/* Take the ORF buffers of previous results into the workspace
+ *
+ * The actual size of a buffer isn't known, only that it holds the ORF
+ * string; growing it later is usually done in place by realloc(). */
 static void
-map_bst_dnaresult_free(union uproc_bst_key key, void *value, void *opaque)
+orfbufs_put(struct uproc_classify_ctx_s *ctx, uproc_list *results)
 {
-    (void) key;
-    (void) opaque;
-    uproc_dnaresult_free(value);
+    for (long i = 0, n = uproc_list_size(results); i < n; i++) {
+        struct uproc_dnaresult pred;
+        (void) uproc_list_get(results, i, &pred);
+        if (!pred.orf.data) {
+            continue;
+        }
+        if (ctx->orfbufs_n == ctx->orfbufs_alloc) {
+            size_t alloc = ctx->orfbufs_alloc ? ctx->orfbufs_alloc * 2 : 64;
+            void *tmp = realloc(ctx->orfbufs, alloc * sizeof *ctx->orfbufs);
+            if (!tmp) {
+                uproc_dnaresult_free(&pred);
+                continue;
+            }
+            ctx->orfbufs = tmp;
+            ctx->orfbufs_alloc = alloc;
+        }
+        ctx->orfbufs[ctx->orfbufs_n++] = (struct orfbuf) {
+            .data = pred.orf.data,
+            .size = strlen(pred.orf.data) + 1,
+        };
+    }
+    uproc_list_clear(results);
 }
 
 
-int
-uproc_dnaclass_classify(const uproc_dnaclass *dc, const char *seq,
-                        uproc_list **results)
+/* Append the result of a table entry, using a buffer taken from the
+ * workspace (if available) for the ORF string */
+static int
+results_append(const struct uproc_dnaclass_s *dc,
+               struct uproc_classify_ctx_s *ctx, uproc_list *results,
+               const struct maxtab_entry *e, const struct orfbatch *ob,
+               size_t reserve)
 {
     int res;
-    size_t i;
-    struct uproc_orf orf;
-    uproc_orfiter *orf_iter;
-    uproc_bst *max_scores;
-    uproc_bstiter *max_scores_iter;
-    union uproc_bst_key key;
-    uproc_list *pc_results = NULL;
+    struct uproc_dnaresult pred = {
+        .family = e->family,
+        .score = e->score,
+        .orf = ob->orfs[e->orf].orf,
+    };
+    struct uproc_orf src = pred.orf;
+    struct orfbuf buf = { NULL, 0 };
+
+    if (ctx->orfbufs_n) {
+        buf = ctx->orfbufs[--ctx->orfbufs_n];
+    }
+    src.data = ob->buf + ob->orfs[e->orf].offset;
+    pred.orf.data = buf.data;
+    res = orf_string_to(&pred.orf, &buf.size, &src, protclass_alphabet(dc->pc),
+                        reserve);
+    if (res) {
+        free(buf.data);
+        return res;
+    }
+    res = uproc_list_append(results, &pred);
+    if (res) {
+        uproc_dnaresult_free(&pred);
+    }
+    return res;
+}
+
+
+/* Append the `dc->top_k` best results in descending order of score */
+static int
+results_top_k(const struct uproc_dnaclass_s *dc,
+              struct uproc_classify_ctx_s *ctx, struct maxtab *max_scores,
+              const struct orfbatch *ob, uproc_list *results, size_t reserve)
+{
+    int res;
+    struct topk *top = &ctx->dna_top;
+
+    res = topk_reset(top, dc->top_k);
+    if (res) {
+        return res;
+    }
+    for (size_t i = 0; i < max_scores->n; i++) {
+        topk_push(top, max_scores->entries[i].score,
+                  max_scores->entries[i].family, i);
+    }
+    topk_sort(top);
+    for (size_t i = 0; !res && i < top->n; i++) {
+        res = results_append(dc, ctx, results,
+                             &max_scores->entries[top->items[i].index], ob,
+                             reserve);
+    }
+    return res;
+}
 
-    struct uproc_dnaresult
-        pred = UPROC_DNARESULT_INITIALIZER,
-        pred_max = UPROC_DNARESULT_INITIALIZER;
 
+/* Create an empty result list or take the ORF buffers of an existing one */
+static int
+results_prepare(struct uproc_classify_ctx_s *ctx, uproc_list **results)
+{
     if (!*results) {
-        *results = uproc_list_create(sizeof pred);
+        *results = uproc_list_create(sizeof (struct uproc_dnaresult));
         if (!*results) {
             return -1;
         }
     }
     else {
-        uproc_list_map(*results, map_list_dnaresult_free, NULL);
-        uproc_list_clear(*results);
+        orfbufs_put(ctx, *results);
     }
+    return 0;
+}
 
-    max_scores = uproc_bst_create(UPROC_BST_UINT, sizeof pred);
-    orf_iter = uproc_orfiter_create(seq, dc->codon_scores, dc->orf_filter,
-                                    dc->orf_filter_arg);
 
-    if (!max_scores || !orf_iter) {
-        res = -1;
-        goto error;
+/* Append the results selected by `dc->mode` and reset the table */
+static int
+results_from_maxtab(const struct uproc_dnaclass_s *dc,
+                    struct uproc_classify_ctx_s *ctx,
+                    struct maxtab *max_scores, const struct orfbatch *ob,
+                    uproc_list *results, size_t reserve)
+{
+    int res = 0;
+
+    if (dc->mode == UPROC_DNACLASS_TOP_K) {
+        res = results_top_k(dc, ctx, max_scores, ob, results, reserve);
+    }
+    else if (dc->mode == UPROC_DNACLASS_MAX) {
+        /* only the best result was kept, see maxtab_update_best() */
+        if (max_scores->n) {
+            res = results_append(dc, ctx, results, &max_scores->entries[0],
+                                 ob, reserve);
+        }
+    }
+    else {
+        /* report the families in ascending order */
+        qsort(max_scores->entries, max_scores->n, sizeof *max_scores->entries,
+              maxtab_cmp);
+        for (size_t i = 0; !res && i < max_scores->n; i++) {
+            res = results_append(dc, ctx, results, &max_scores->entries[i],
+                                 ob, reserve);
+        }
     }
+    maxtab_reset(max_scores);
+    return res;
+}
+
+
+/* Like maxtab_update(), but keep only the single best result as the first
+ * entry (for the ::UPROC_DNACLASS_MAX mode)
+ *
+ * Ties are won by the lowest family, and within a family by the first ORF
+ * of the sequence, regardless of the order in which the ORFs are
+ * evaluated. */
+static int
+maxtab_update_best(struct maxtab *tab, const struct uproc_protresult *pp,
+                   size_t orf)
+{
+    struct maxtab_entry *e = tab->entries;
+
+    if (!(pp->score > -INFINITY)) {
+        return 0;
+    }
+    if (tab->n && !(pp->score > e->score ||
+                    (pp->score == e->score &&
+                     (pp->family < e->family ||
+                      (pp->family == e->family && orf < e->orf))))) {
+        return 0;
+    }
+    if (!tab->alloc) {
+        if (maxtab_grow(tab)) {
+            return -1;
+        }
+        e = tab->entries;
+    }
+    e->family = pp->family;
+    e->score = pp->score;
+    e->orf = orf;
+    tab->n = 1;
+    return 0;
+}
 
-    while (res = uproc_orfiter_next(orf_iter, &orf), !res) {
-        res = uproc_protclass_classify(dc->pc, orf.data, &pc_results);
+
+/* Take the protein classification results of the ORF `orf` (an index into
+ * the ::orfbatch) into the table */
+static int
+maxtab_update_orf(const struct uproc_dnaclass_s *dc, struct maxtab *max_scores,
+                  const uproc_list *orf_results, size_t orf)
+{
+    int res = 0;
+    for (long n = uproc_list_size(orf_results), i = 0; !res && i < n; i++) {
+        struct uproc_protresult pp;
+        (void) uproc_list_get(orf_results, i, &pp);
+        if (dc->mode == UPROC_DNACLASS_MAX) {
+            res = maxtab_update_best(max_scores, &pp, orf);
+        }
+        else {
+            res = maxtab_update(max_scores, &pp, orf);
+        }
+    }
+    return res;
+}
+
+
+/* Start iterating over the ORFs of `seq` as amino acid codes, which are
+ * classified without being turned into strings */
+static int
+orfiter_start(const struct uproc_dnaclass_s *dc,
+              struct uproc_classify_ctx_s *ctx, const char *seq)
+{
+    if (!ctx->orfiter) {
+        ctx->orfiter = uproc_orfiter_create(seq, dc->codon_scores,
+                                            dc->orf_filter,
+                                            dc->orf_filter_arg);
+        if (!ctx->orfiter) {
+            return -1;
+        }
+    }
+    orfiter_reset_aminos(ctx->orfiter, seq, dc->codon_scores, dc->orf_filter,
+                         dc->orf_filter_arg, protclass_alphabet(dc->pc));
+    return 0;
+}
+
+
+/* Whether an ORF is too short to have any protein classification results */
+static bool
+orf_unclassifiable(const struct uproc_dnaclass_s *dc,
+                   const struct uproc_orf *orf)
+{
+    return protclass_score_max(dc->pc, orf->length) == -INFINITY;
+}
+
+
+/* Longer ORFs first, then higher codon scores, then the order in the
+ * sequence */
+static int
+orfbatch_rank_cmp(const void *p1, const void *p2)
+{
+    const struct orfbatch_rank *r1 = p1, *r2 = p2;
+    if (r1->length != r2->length) {
+        return r1->length < r2->length ? 1 : -1;
+    }
+    if (r1->score != r2->score) {
+        return r1->score < r2->score ? 1 : -1;
+    }
+    return (r1->orf > r2->orf) - (r1->orf < r2->orf);
+}
+
+
+/* Classify the ORFs of a sequence in the ::UPROC_DNACLASS_MAX mode
+ *
+ * An ORF can't score more than protclass_score_max() of its length, so the
+ * ORFs are classified longest first until none of the remaining ones can
+ * beat the best result anymore. */
+static int
+maxtab_best_first(const struct uproc_dnaclass_s *dc,
+                  struct uproc_classify_ctx_s *ctx, struct maxtab *max_scores,
+                  struct orfbatch *ob)
+{
+    int res = 0;
+
+    for (size_t i = 0; i < ob->n; i++) {
+        ob->rank[i] = (struct orfbatch_rank) {
+            .length = ob->orfs[i].orf.length,
+            .score = ob->orfs[i].orf.score,
+            .orf = i,
+        };
+    }
+    qsort(ob->rank, ob->n, sizeof *ob->rank, orfbatch_rank_cmp);
+
+    for (size_t i = 0; !res && i < ob->n; i++) {
+        size_t k = ob->rank[i].orf;
+        if (max_scores->n && protclass_score_max(dc->pc, ob->rank[i].length) <
+                             max_scores->entries[0].score) {
+            break;
+        }
+        res = protclass_classify_codes(dc->pc, ctx,
+                                       ob->buf + ob->orfs[k].offset,
+                                       ob->orfs[k].orf.length,
+                                       &ctx->orf_results);
+        if (!res) {
+            res = maxtab_update_orf(dc, max_scores, ctx->orf_results, k);
+        }
+    }
+    return res;
+}
+
+
+int
+uproc_dnaclass_classify(const uproc_dnaclass *dc, const char *seq,
+                        uproc_list **results)
+{
+    struct uproc_classify_ctx_s *ctx = uproc_classify_ctx_thread();
+    if (!ctx) {
+        return -1;
+    }
+    return uproc_dnaclass_classify_ctx(dc, ctx, seq, results);
+}
+
+
+int
+uproc_dnaclass_classify_ctx(const uproc_dnaclass *dc, uproc_classify_ctx *ctx,
+                            const char *seq, uproc_list **results)
+{
+    int res;
+    struct uproc_orf orf;
+    struct maxtab *max_scores;
+    struct orfbatch *ob;
+    /* upper bound for the size of an ORF (including the terminator) */
+    size_t orf_max = strlen(seq) / 3 + 2;
+
+    res = results_prepare(ctx, results);
+    if (res) {
+        return res;
+    }
+    max_scores = maxtab_get(ctx);
+    ob = orfbatch_get(ctx);
+    if (!max_scores || !ob) {
+        return -1;
+    }
+    res = orfiter_start(dc, ctx, seq);
+    if (res) {
+        return res;
+    }
+
+    ob->n = ob->buf_len = 0;
+    while (res = uproc_orfiter_next(ctx->orfiter, &orf), !res) {
+        if (orf_unclassifiable(dc, &orf)) {
+            continue;
+        }
+        /* classified afterwards, see maxtab_best_first() */
+        if (dc->mode == UPROC_DNACLASS_MAX) {
+            res = orfbatch_append(ob, 0, &orf);
+            if (res) {
+                goto error;
+            }
+            continue;
+        }
+        res = protclass_classify_codes(dc->pc, ctx, orf.data, orf.length,
+                                       &ctx->orf_results);
         if (res) {
             goto error;
         }
-        for (long n = uproc_list_size(pc_results), i = 0; i < n; i++) {
-            struct uproc_protresult pp;
-            (void) uproc_list_get(pc_results, i, &pp);
-            key.uint = pp.family;
-            uproc_dnaresult_init(&pred);
-            pred.score = -INFINITY;
-            (void) uproc_bst_get(max_scores, key, &pred);
-            if (pp.score > pred.score) {
-                uproc_dnaresult_free(&pred);
-                pred.family = pp.family;
-                pred.score = pp.score;
-                res = uproc_orf_copy(&pred.orf, &orf);
-                if (res) {
-                    goto error;
-                }
-                res = uproc_bst_update(max_scores, key, &pred);
-                if (res) {
-                    goto error;
-                }
-            }
+        /* an ORF without results can't be the best one of any family */
+        if (!uproc_list_size(ctx->orf_results)) {
+            continue;
+        }
+        res = orfbatch_append(ob, 0, &orf);
+        if (res) {
+            goto error;
+        }
+        res = maxtab_update_orf(dc, max_scores, ctx->orf_results,
+                                ob->n - 1);
+        if (res) {
+            goto error;
         }
     }
     if (res == -1) {
         goto error;
     }
+    if (dc->mode == UPROC_DNACLASS_MAX) {
+        res = maxtab_best_first(dc, ctx, max_scores, ob);
+        if (res) {
+            goto error;
+        }
+    }
+    return results_from_maxtab(dc, ctx, max_scores, ob, *results, orf_max);
 
-    max_scores_iter = uproc_bstiter_create(max_scores);
-    if (!max_scores_iter) {
-        goto error;
+error:
+    maxtab_reset(max_scores);
+    return res;
+}
+
+
+/* Maximum number of ORFs that uproc_dnaclass_classify_many() passes to
+ * protclass_classify_many_codes() at once (unless a single sequence has
+ * more) */
+#define MANY_ORFS (1 << 12)
+
+int
+uproc_dnaclass_classify_many(const uproc_dnaclass *dc,
+                             uproc_classify_ctx *ctx,
+                             const char *const *seqs, size_t n,
+                             uproc_list **results)
+{
+    int res;
+    struct orfbatch *ob = orfbatch_get(ctx);
+    struct maxtab *max_scores = maxtab_get(ctx);
+    size_t i = 0;
+
+    if (!ob || !max_scores) {
+        return -1;
     }
-    for (i = 0; !uproc_bstiter_next(max_scores_iter, &key, &pred); i++) {
-        if (dc->mode == UPROC_DNACLASS_MAX) {
-            if (!uproc_list_size(*results)) {
-                pred_max = pred;
-                res = uproc_list_append(*results, &pred);
+    while (i < n) {
+        size_t first = i, k = 0;
+
+        /* collect the ORFs of as many sequences as fit */
+        ob->n = ob->buf_len = 0;
+        for (; i < n && ob->n < MANY_ORFS; i++) {
+            struct uproc_orf orf;
+            res = orfiter_start(dc, ctx, seqs[i]);
+            if (res) {
+                return res;
+            }
+            while (res = uproc_orfiter_next(ctx->orfiter, &orf), !res) {
+                if (orf_unclassifiable(dc, &orf)) {
+                    continue;
+                }
+                res = orfbatch_append(ob, i, &orf);
                 if (res) {
-                    break;
+                    return res;
                 }
             }
-            else if (pred.score > pred_max.score) {
-                uproc_dnaresult_free(&pred_max);
-                pred_max = pred;
-                uproc_list_set(*results, 0, &pred_max);
-            }
-            else {
-                uproc_dnaresult_free(&pred);
+            if (res == -1) {
+                return res;
             }
         }
-        else {
-            res = uproc_list_append(*results, &pred);
+
+        for (size_t j = 0; j < ob->n; j++) {
+            ob->data[j] = ob->buf + ob->orfs[j].offset;
+            ob->lens[j] = ob->orfs[j].orf.length;
+        }
+        res = protclass_classify_many_codes(dc->pc, ctx, ob->data, ob->lens,
+                                            ob->n, ob->results);
+        if (res) {
+            return res;
+        }
+
+        /* the ORFs are ordered by sequence */
+        for (size_t s = first; s < i; s++) {
+            size_t orf_max = strlen(seqs[s]) / 3 + 2;
+            res = results_prepare(ctx, &results[s]);
+            for (; !res && k < ob->n && ob->orfs[k].seq == s; k++) {
+                res = maxtab_update_orf(dc, max_scores, ob->results[k], k);
+            }
             if (res) {
-                goto error;
+                maxtab_reset(max_scores);
+                return res;
+            }
+            res = results_from_maxtab(dc, ctx, max_scores, ob, results[s],
+                                      orf_max);
+            if (res) {
+                return res;
             }
         }
     }
-    uproc_bstiter_destroy(max_scores_iter);
+    return 0;
+}
 
-    res = 0;
 
-    if (0) {
-error:
-        uproc_bst_map(max_scores, map_bst_dnaresult_free, NULL);
+void
+uproc_dnaclass_set_top_k(uproc_dnaclass *dc, size_t k)
+{
+    dc->top_k = k;
+}
+
+
+void
+dnaclass_ctx_free(struct uproc_classify_ctx_s *ctx)
+{
+    uproc_orfiter_destroy(ctx->orfiter);
+    uproc_list_destroy(ctx->orf_results);
+    if (ctx->max_scores) {
+        free(ctx->max_scores->entries);
+        free(ctx->max_scores);
+    }
+    for (size_t i = 0; i < ctx->orfbufs_n; i++) {
+        free(ctx->orfbufs[i].data);
+    }
+    free(ctx->orfbufs);
+    if (ctx->orfbatch) {
+        for (size_t i = 0; i < ctx->orfbatch->alloc; i++) {
+            uproc_list_destroy(ctx->orfbatch->results[i]);
+        }
+        free(ctx->orfbatch->orfs);
+        free(ctx->orfbatch->data);
+        free(ctx->orfbatch->lens);
+        free(ctx->orfbatch->results);
+        free(ctx->orfbatch->rank);
+        free(ctx->orfbatch->buf);
+        free(ctx->orfbatch);
     }
-    uproc_list_destroy(pc_results);
-    uproc_bst_destroy(max_scores);
-    uproc_orfiter_destroy(orf_iter);
-    return res;
 }
 
 void
@@ -98,6 +98,197 @@ prefix_lookup(const struct uproc_ecurve_pfxtable *table,
 }
 
 
+/** Number of non-empty prefixes less than `key` in a compact index
+ *
+ * This is also the position of `key` in `ecurve->pfxentries` if `key` is
+ * non-empty, which is indicated by setting `*present` to non-zero.
+ */
+static inline size_t
+compact_rank(const struct uproc_ecurve_s *ecurve, uproc_prefix key,
+             int *present)
+{
+    return rankblock_rank(ecurve->pfxblocks, key, present);
+}
+
+
+/** Resolve the neighbours of an empty prefix
+ *
+ * Used by both #UPROC_ECURVE_INDEX_COMPACT and #UPROC_ECURVE_INDEX_DIRECT.
+ * `rank` is the number of non-empty prefixes that are less than the empty
+ * prefix, i.e. the position of the next non-empty prefix in
+ * `ecurve->pfxentries`. Return value and output arguments as in
+ * prefix_lookup().
+ */
+static inline int
+rank_lookup(const struct uproc_ecurve_s *ecurve, size_t rank,
+            size_t *index, size_t *count,
+            uproc_prefix *lower_prefix, uproc_prefix *upper_prefix)
+{
+    const struct ecurve_pfxentry *e = &ecurve->pfxentries[rank];
+
+    /* below the first prefix that has an entry */
+    if (!rank) {
+        *index = 0;
+        *count = 1;
+        *lower_prefix = *upper_prefix = e[0].prefix;
+        return UPROC_ECURVE_OOB;
+    }
+
+    /* above the last prefix */
+    if (rank == ecurve->prefix_count) {
+        *index = ecurve->suffix_count - 1;
+        *count = 1;
+        *lower_prefix = *upper_prefix = e[-1].prefix;
+        return UPROC_ECURVE_OOB;
+    }
+
+    /* the neighbours are the last suffix of the previous and the first
+     * suffix of the next non-empty prefix, which are adjacent in the suffix
+     * table */
+    *index = e[0].first - 1;
+    *count = 2;
+    *lower_prefix = e[-1].prefix;
+    *upper_prefix = e[0].prefix;
+    return UPROC_ECURVE_INEXACT;
+}
+
+
+/** Perform a lookup in a compact prefix index.
+ *
+ * Same as prefix_lookup(), but for ecurves with #UPROC_ECURVE_INDEX_COMPACT.
+ */
+static int
+prefix_lookup_compact(const struct uproc_ecurve_s *ecurve,
+                      uproc_prefix key, size_t *index, size_t *count,
+                      uproc_prefix *lower_prefix, uproc_prefix *upper_prefix)
+{
+    int present;
+    size_t rank = compact_rank(ecurve, key, &present);
+    const struct ecurve_pfxentry *e = &ecurve->pfxentries[rank];
+
+    if (present) {
+        *index = e[0].first;
+        *count = e[1].first - e[0].first;
+        *lower_prefix = *upper_prefix = key;
+        return UPROC_ECURVE_EXACT;
+    }
+    return rank_lookup(ecurve, rank, index, count, lower_prefix,
+                       upper_prefix);
+}
+
+
+/** Perform a lookup in a prefix table with directly resolved neighbours.
+ *
+ * Same as prefix_lookup(), but for ecurves with #UPROC_ECURVE_INDEX_DIRECT,
+ * where empty and edge prefixes store their rank instead of the hop
+ * distances.
+ */
+static int
+prefix_lookup_direct(const struct uproc_ecurve_s *ecurve,
+                     uproc_prefix key, size_t *index, size_t *count,
+                     uproc_prefix *lower_prefix, uproc_prefix *upper_prefix)
+{
+    const struct uproc_ecurve_pfxtable *pt = &ecurve->prefixes[key];
+
+    if (!pt->count || ECURVE_ISEDGE(*pt)) {
+        return rank_lookup(ecurve, pt->first, index, count, lower_prefix,
+                           upper_prefix);
+    }
+    *index = pt->first;
+    *count = pt->count;
+    *lower_prefix = *upper_prefix = key;
+    return UPROC_ECURVE_EXACT;
+}
+
+
+static inline int
+ecurve_prefix_lookup(const struct uproc_ecurve_s *ecurve,
+                     uproc_prefix key, size_t *index, size_t *count,
+                     uproc_prefix *lower_prefix, uproc_prefix *upper_prefix)
+{
+    switch (ecurve->index) {
+        case UPROC_ECURVE_INDEX_COMPACT:
+            return prefix_lookup_compact(ecurve, key, index, count,
+                                         lower_prefix, upper_prefix);
+        case UPROC_ECURVE_INDEX_DIRECT:
+            return prefix_lookup_direct(ecurve, key, index, count,
+                                        lower_prefix, upper_prefix);
+        default:
+            return prefix_lookup(ecurve->prefixes, key, index, count,
+                                 lower_prefix, upper_prefix);
+    }
+}
+
+
+/* Buckets with up to this many suffixes are searched linearly */
+#define SUFFIX_LINEAR_MAX 16
+
+/* Buckets with at least this many suffixes are narrowed down by
+ * interpolation search first */
+#define SUFFIX_INTERP_MIN 1024
+
+/* Maximum number of interpolation steps before switching to binary search */
+#define SUFFIX_INTERP_STEPS 3
+
+
+/* Index of the last element in `search` that is less than or equal to `key`.
+ *
+ * All three variants below expect that `search[0] <= key` */
+
+/* Count the elements instead of branching on them; the loop has a fixed
+ * trip count and no data dependencies, so it is vectorized by the compiler */
+static inline size_t
+suffix_search_linear(const uproc_suffix *search, size_t n, uproc_suffix key)
+{
+    size_t i, count = 0;
+    for (i = 0; i < n; i++) {
+        count += search[i] <= key;
+    }
+    return count - 1;
+}
+
+/* Binary search without data-dependent branches (compiles to cmov) */
+static inline size_t
+suffix_search_branchless(const uproc_suffix *search, size_t n,
+                         uproc_suffix key)
+{
+    const uproc_suffix *base = search;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = (base[half] <= key) ? base + half : base;
+        n -= half;
+    }
+    return base - search;
+}
+
+/* Suffixes are roughly uniformly distributed, so a few interpolation steps
+ * shrink large buckets to a size that is cheap to search. Additionally
+ * requires that `key < search[n - 1]` */
+static inline size_t
+suffix_search_interp(const uproc_suffix *search, size_t n, uproc_suffix key)
+{
+    size_t lo = 0, hi = n - 1, pos;
+    int steps = SUFFIX_INTERP_STEPS;
+
+    /* invariant: search[lo] <= key < search[hi] */
+    while (steps-- && hi - lo > SUFFIX_LINEAR_MAX) {
+        double frac = (double) (key - search[lo]) /
+                      (double) (search[hi] - search[lo]);
+        pos = lo + 1 + (size_t) (frac * (hi - lo - 1));
+        if (pos >= hi) {
+            pos = hi - 1;
+        }
+        if (search[pos] <= key) {
+            lo = pos;
+        }
+        else {
+            hi = pos;
+        }
+    }
+    return lo + suffix_search_branchless(search + lo, hi - lo, key);
+}
+
+
 /** Find exact match or nearest neighbours in suffix array.
  *
  * If `key` is less than the first item in `search` (resp. greater than the
@@ -109,6 +300,8 @@ prefix_lookup(const struct uproc_ecurve_pfxtable *table,
  * the indices of the values that are closest to `key`, i.e. such that
  * `search[*lower] < key < search[*upper]`.
  *
+ * Depending on `n`, one of the search kernels above is used.
+ *
  * \param search    array to search
  * \param n         number of elements in `search`
  * \param key       value to find
@@ -122,41 +315,35 @@ static int
 suffix_lookup(const uproc_suffix *search, size_t n, uproc_suffix key,
               size_t *lower, size_t *upper)
 {
-    size_t lo = 0, mid, hi = n - 1;
+    size_t lo;
 
     if (!n || key < search[0]) {
         *lower = *upper = 0;
         return UPROC_ECURVE_OOB;
     }
 
-    if (key > search[n - 1]) {
+    if (key >= search[n - 1]) {
         *lower = *upper = n - 1;
-        return UPROC_ECURVE_OOB;
+        return key == search[n - 1] ? UPROC_ECURVE_EXACT : UPROC_ECURVE_OOB;
     }
 
-    while (hi > lo + 1) {
-        mid = (hi + lo) / 2;
-
-        if (key == search[mid]) {
-            lo = mid;
-            break;
-        }
-        else if (key > search[mid]) {
-            lo = mid;
-        }
-        else {
-            hi = mid;
-        }
+    if (n <= SUFFIX_LINEAR_MAX) {
+        lo = suffix_search_linear(search, n, key);
     }
-    if (search[lo] == key) {
-        hi = lo;
+    else if (n < SUFFIX_INTERP_MIN) {
+        lo = suffix_search_branchless(search, n, key);
     }
-    else if (search[hi] == key) {
-        lo = hi;
+    else {
+        lo = suffix_search_interp(search, n, key);
     }
+
     *lower = lo;
-    *upper = hi;
-    return (lo == hi) ? UPROC_ECURVE_EXACT : UPROC_ECURVE_INEXACT;
+    if (search[lo] == key) {
+        *upper = lo;
+        return UPROC_ECURVE_EXACT;
+    }
+    *upper = lo + 1;
+    return UPROC_ECURVE_INEXACT;
 }
 
 
@@ -210,14 +397,105 @@ ecurve_realloc(struct uproc_ecurve_s *ec, size_t suffix_count)
 }
 
 
+/* Append an entry to `ec->pfxentries` (and mark it in the occupancy bitmap of
+ * a compact index) */
+static inline int
+pfxentries_append(struct uproc_ecurve_s *ec, uproc_prefix pfx)
+{
+    /* leave room for the sentinel */
+    if (ec->prefix_count + 1 >= ec->prefix_alloc) {
+        size_t alloc = ec->prefix_alloc ? ec->prefix_alloc * 2 : 1 << 12;
+        void *tmp = realloc(ec->pfxentries, sizeof *ec->pfxentries * alloc);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ec->pfxentries = tmp;
+        ec->prefix_alloc = alloc;
+    }
+    ec->pfxentries[ec->prefix_count].prefix = pfx;
+    ec->pfxentries[ec->prefix_count].first = ec->suffix_count;
+    ec->prefix_count++;
+    if (ec->index == UPROC_ECURVE_INDEX_COMPACT) {
+        ec->pfxblocks[pfx / RANKBLOCK_BITS].bits |=
+            (uint64_t) 1 << (pfx % RANKBLOCK_BITS);
+    }
+    return 0;
+}
+
+
+/* Shrink `ec->pfxentries` and append the sentinel */
+static int
+pfxentries_finalize(struct uproc_ecurve_s *ec)
+{
+    void *tmp = realloc(ec->pfxentries,
+                        sizeof *ec->pfxentries * (ec->prefix_count + 1));
+    if (!tmp) {
+        return uproc_error(UPROC_ENOMEM);
+    }
+    ec->pfxentries = tmp;
+    ec->prefix_alloc = ec->prefix_count + 1;
+    ec->pfxentries[ec->prefix_count].prefix = UPROC_PREFIX_MAX + 1;
+    ec->pfxentries[ec->prefix_count].first = ec->suffix_count;
+    return 0;
+}
+
+
+static void
+compact_finalize(struct uproc_ecurve_s *ec)
+{
+    uint_least32_t rank = 0;
+    for (size_t i = 0; i < PFXBLOCK_COUNT; i++) {
+        ec->pfxblocks[i].rank = rank;
+        rank += popcount64(ec->pfxblocks[i].bits);
+    }
+}
+
+
+/* Replace the hop distances of empty and edge prefixes by their rank */
+static void
+direct_finalize(struct uproc_ecurve_s *ec)
+{
+    pfxtab_suffix rank = 0;
+    for (uproc_prefix p = 0; p <= UPROC_PREFIX_MAX; p++) {
+        struct uproc_ecurve_pfxtable *pt = &ec->prefixes[p];
+        if (!pt->count || ECURVE_ISEDGE(*pt)) {
+            pt->first = rank;
+        }
+        else {
+            rank++;
+        }
+    }
+}
+
+
 uproc_ecurve *
 uproc_ecurve_create(const char *alphabet, size_t suffix_count)
+{
+    return uproc_ecurve_create_with_index(alphabet, suffix_count,
+                                          UPROC_ECURVE_INDEX_TABLE);
+}
+
+
+uproc_ecurve *
+uproc_ecurve_create_with_index(const char *alphabet, size_t suffix_count,
+                               enum uproc_ecurve_index index)
 {
     struct uproc_ecurve_s *ec;
     if (suffix_count > PFXTAB_SUFFIX_MAX) {
         uproc_error_msg(UPROC_EINVAL, "too many suffixes");
         return NULL;
     }
+    if (index != UPROC_ECURVE_INDEX_TABLE &&
+        index != UPROC_ECURVE_INDEX_COMPACT &&
+        index != UPROC_ECURVE_INDEX_DIRECT) {
+        uproc_error_msg(UPROC_EINVAL, "invalid index type");
+        return NULL;
+    }
+    if (index != UPROC_ECURVE_INDEX_TABLE && suffix_count) {
+        uproc_error_msg(UPROC_EINVAL,
+                        "index type can only be built incrementally");
+        return NULL;
+    }
     ec = malloc(sizeof *ec);
     if (!ec) {
         uproc_error(UPROC_ENOMEM);
@@ -231,12 +509,23 @@ uproc_ecurve_create(const char *alphabet, size_t suffix_count)
         return NULL;
     }
 
-    ec->prefixes = malloc(
-        sizeof *ec->prefixes * (UPROC_PREFIX_MAX + 1));
-    if (!ec->prefixes) {
-        uproc_ecurve_destroy(ec);
-        uproc_error(UPROC_ENOMEM);
-        return NULL;
+    ec->index = index;
+    if (index == UPROC_ECURVE_INDEX_COMPACT) {
+        ec->pfxblocks = calloc(PFXBLOCK_COUNT, sizeof *ec->pfxblocks);
+        if (!ec->pfxblocks) {
+            uproc_ecurve_destroy(ec);
+            uproc_error(UPROC_ENOMEM);
+            return NULL;
+        }
+    }
+    else {
+        ec->prefixes = malloc(
+            sizeof *ec->prefixes * (UPROC_PREFIX_MAX + 1));
+        if (!ec->prefixes) {
+            uproc_ecurve_destroy(ec);
+            uproc_error(UPROC_ENOMEM);
+            return NULL;
+        }
     }
 
     if (suffix_count) {
@@ -269,13 +558,20 @@ uproc_ecurve_destroy(uproc_ecurve *ecurve)
     }
 
     uproc_alphabet_destroy(ecurve->alphabet);
-    if (ecurve->mmap_fd > -1) {
+    if (ecurve->borrowed) {
+        /* nothing to do */
+    }
+    else if (ecurve->mmap_ptr) {
         uproc_ecurve_munmap(ecurve);
     }
     else {
         free(ecurve->prefixes);
+        free(ecurve->pfxblocks);
+        free(ecurve->pfxentries);
         free(ecurve->suffixes);
         free(ecurve->families);
+        free(ecurve->family_runs);
+        free(ecurve->run_families);
     }
     free(ecurve);
 }
@@ -289,6 +585,10 @@ uproc_ecurve_add_prefix(uproc_ecurve *ecurve, uproc_prefix pfx, uproc_list *suff
     struct uproc_ecurve_pfxtable *pt;
     size_t suffix_count, old_suffix_count;
 
+    if (ecurve->compressed) {
+        return uproc_error_msg(UPROC_EINVAL, "ecurve is compressed");
+    }
+
     if (!uproc_list_size(suffixes)) {
         return uproc_error_msg(UPROC_EINVAL, "empty suffix list");
     }
@@ -302,25 +602,35 @@ uproc_ecurve_add_prefix(uproc_ecurve *ecurve, uproc_prefix pfx, uproc_list *suff
                                "new prefix must be greater than last nonempty");
     }
 
-    for (p = ecurve->last_nonempty + !!ecurve->suffix_count; p < pfx; p++) {
-        pt = &ecurve->prefixes[p];
-        /* empty ecurve -> mark leading prefixes as "edge" */
-        if (!ecurve->suffix_count) {
-            pt->prev = 0;
-            pt->next = neigh_dist(p, pfx);
-            pt->count = ECURVE_EDGE;
-        }
-        else {
-            pt->prev = neigh_dist(ecurve->last_nonempty, p);
-            pt->next = neigh_dist(p, pfx);
-            pt->count = 0;
+    suffix_count = uproc_list_size(suffixes);
+
+    if (ecurve->index != UPROC_ECURVE_INDEX_TABLE) {
+        res = pfxentries_append(ecurve, pfx);
+        if (res) {
+            return res;
         }
     }
+    if (ecurve->index != UPROC_ECURVE_INDEX_COMPACT) {
+        for (p = ecurve->last_nonempty + !!ecurve->suffix_count; p < pfx;
+             p++) {
+            pt = &ecurve->prefixes[p];
+            /* empty ecurve -> mark leading prefixes as "edge" */
+            if (!ecurve->suffix_count) {
+                pt->prev = 0;
+                pt->next = neigh_dist(p, pfx);
+                pt->count = ECURVE_EDGE;
+            }
+            else {
+                pt->prev = neigh_dist(ecurve->last_nonempty, p);
+                pt->next = neigh_dist(p, pfx);
+                pt->count = 0;
+            }
+        }
 
-    suffix_count = uproc_list_size(suffixes);
-    pt = &ecurve->prefixes[pfx];
-    pt->first = ecurve->suffix_count;
-    pt->count = suffix_count;
+        pt = &ecurve->prefixes[pfx];
+        pt->first = ecurve->suffix_count;
+        pt->count = suffix_count;
+    }
 
     old_suffix_count = ecurve->suffix_count;
     res = ecurve_realloc(ecurve, ecurve->suffix_count + suffix_count);
@@ -344,13 +654,27 @@ uproc_ecurve_finalize(uproc_ecurve *ecurve)
 {
     uproc_prefix p;
     struct uproc_ecurve_pfxtable *pt;
-    for (p = ecurve->last_nonempty + 1; p <= UPROC_PREFIX_MAX; p++) {
-        pt = &ecurve->prefixes[p];
-        pt->prev = neigh_dist(ecurve->last_nonempty, p);
-        pt->next = 0;
-        pt->count = ECURVE_EDGE;
-    }
     void *tmp;
+
+    if (ecurve->index != UPROC_ECURVE_INDEX_TABLE) {
+        if (pfxentries_finalize(ecurve)) {
+            return -1;
+        }
+    }
+    if (ecurve->index == UPROC_ECURVE_INDEX_COMPACT) {
+        compact_finalize(ecurve);
+    }
+    else {
+        for (p = ecurve->last_nonempty + 1; p <= UPROC_PREFIX_MAX; p++) {
+            pt = &ecurve->prefixes[p];
+            pt->prev = neigh_dist(ecurve->last_nonempty, p);
+            pt->next = 0;
+            pt->count = ECURVE_EDGE;
+        }
+        if (ecurve->index == UPROC_ECURVE_INDEX_DIRECT) {
+            direct_finalize(ecurve);
+        }
+    }
     tmp = realloc(ecurve->suffixes,
                   sizeof *ecurve->suffixes * ecurve->suffix_count);
     if (!tmp) {
@@ -368,6 +692,70 @@ uproc_ecurve_finalize(uproc_ecurve *ecurve)
 }
 
 
+/** Number of lookups that are interleaved by uproc_ecurve_lookup_batch() */
+#define LOOKUP_BATCH_SIZE 16
+
+#if defined(__GNUC__)
+#define PREFETCH(addr) __builtin_prefetch((addr), 0, 1)
+#else
+#define PREFETCH(addr) ((void) (addr))
+#endif
+
+/** Populate the output variables of a lookup
+ *
+ * `lower` and `upper` are the indices of the neighbours in the suffix table.
+ */
+static inline void
+lookup_neighbours(const struct uproc_ecurve_s *ecurve, size_t lower,
+                  size_t upper, uproc_prefix p_lower, uproc_prefix p_upper,
+                  struct uproc_word *lower_neighbour,
+                  uproc_family *lower_class,
+                  struct uproc_word *upper_neighbour,
+                  uproc_family *upper_class)
+{
+    lower_neighbour->prefix = p_lower;
+    lower_neighbour->suffix = ecurve->suffixes[lower];
+    *lower_class = ecurve_family(ecurve, lower);
+    upper_neighbour->prefix = p_upper;
+    upper_neighbour->suffix = ecurve->suffixes[upper];
+    *upper_class = ecurve_family(ecurve, upper);
+}
+
+
+/** Search the suffix table and populate output variables
+ *
+ * Second half of a lookup, `res`, `index`, `count`, `p_lower` and `p_upper`
+ * are the results of prefix_lookup().
+ */
+static int
+lookup_suffix(const struct uproc_ecurve_s *ecurve, uproc_suffix key, int res,
+              size_t index, size_t count,
+              uproc_prefix p_lower, uproc_prefix p_upper,
+              struct uproc_word *lower_neighbour, uproc_family *lower_class,
+              struct uproc_word *upper_neighbour, uproc_family *upper_class)
+{
+    size_t lower, upper;
+
+    if (res == UPROC_ECURVE_EXACT) {
+        res = suffix_lookup(&ecurve->suffixes[index], count, key,
+                            &lower, &upper);
+        if (res != UPROC_ECURVE_EXACT) {
+            res = UPROC_ECURVE_INEXACT;
+        }
+    }
+    else {
+        lower = 0;
+        upper = (res == UPROC_ECURVE_OOB) ? 0 : 1;
+    }
+
+    /* `lower` and `upper` are relative to `index` */
+    lookup_neighbours(ecurve, index + lower, index + upper, p_lower, p_upper,
+                      lower_neighbour, lower_class,
+                      upper_neighbour, upper_class);
+    return res;
+}
+
+
 int
 uproc_ecurve_lookup(const uproc_ecurve *ecurve,
                     const struct uproc_word *word,
@@ -379,38 +767,340 @@ uproc_ecurve_lookup(const uproc_ecurve *ecurve,
     int res;
     uproc_prefix p_lower, p_upper;
     size_t index, count;
-    size_t lower, upper;
 
-    res = prefix_lookup(ecurve->prefixes, word->prefix, &index, &count,
-                        &p_lower, &p_upper);
+    res = ecurve_prefix_lookup(ecurve, word->prefix, &index, &count,
+                               &p_lower, &p_upper);
+    return lookup_suffix(ecurve, word->suffix, res, index, count,
+                         p_lower, p_upper, lower_neighbour, lower_class,
+                         upper_neighbour, upper_class);
+}
+
 
-    if (res == UPROC_ECURVE_EXACT) {
-        res = suffix_lookup(&ecurve->suffixes[index], count, word->suffix,
-                            &lower, &upper);
+int
+uproc_ecurve_lookup_batch(const uproc_ecurve *ecurve,
+                          const struct uproc_word *words, size_t n,
+                          struct uproc_word *lower_neighbours,
+                          uproc_family *lower_classes,
+                          struct uproc_word *upper_neighbours,
+                          uproc_family *upper_classes,
+                          int *results)
+{
+    struct {
+        int res;
+        size_t index, count;
+        uproc_prefix p_lower, p_upper;
+    } pending[LOOKUP_BATCH_SIZE];
+
+    for (size_t start = 0; start < n; start += LOOKUP_BATCH_SIZE) {
+        size_t i, batch = n - start;
+        const struct uproc_word *w = &words[start];
+        if (batch > LOOKUP_BATCH_SIZE) {
+            batch = LOOKUP_BATCH_SIZE;
+        }
+
+        /* issue all prefix index accesses of this batch at once */
+        if (ecurve->index == UPROC_ECURVE_INDEX_COMPACT) {
+            int present;
+            for (i = 0; i < batch; i++) {
+                PREFETCH(&ecurve->pfxblocks[w[i].prefix / RANKBLOCK_BITS]);
+            }
+            for (i = 0; i < batch; i++) {
+                size_t rank = compact_rank(ecurve, w[i].prefix, &present);
+                PREFETCH(&ecurve->pfxentries[rank]);
+            }
+        }
+        else {
+            for (i = 0; i < batch; i++) {
+                PREFETCH(&ecurve->prefixes[w[i].prefix]);
+            }
+            if (ecurve->index == UPROC_ECURVE_INDEX_DIRECT) {
+                for (i = 0; i < batch; i++) {
+                    const struct uproc_ecurve_pfxtable *pt =
+                        &ecurve->prefixes[w[i].prefix];
+                    if (!pt->count || ECURVE_ISEDGE(*pt)) {
+                        PREFETCH(&ecurve->pfxentries[pt->first]);
+                    }
+                }
+            }
+        }
+
+        /* resolve prefixes and prefetch the middle of the suffix range (where
+         * the binary search starts) and the corresponding families */
+        for (i = 0; i < batch; i++) {
+            size_t mid;
+            pending[i].res = ecurve_prefix_lookup(
+                ecurve, w[i].prefix, &pending[i].index,
+                &pending[i].count, &pending[i].p_lower, &pending[i].p_upper);
+            mid = pending[i].index + pending[i].count / 2;
+            PREFETCH(&ecurve->suffixes[mid]);
+            if (ecurve->compressed) {
+                PREFETCH(&ecurve->family_runs[mid / RANKBLOCK_BITS]);
+            }
+            else {
+                PREFETCH(&ecurve->families[mid]);
+            }
+        }
+
+        for (i = 0; i < batch; i++) {
+            size_t k = start + i;
+            int res = lookup_suffix(
+                ecurve, w[i].suffix, pending[i].res, pending[i].index,
+                pending[i].count, pending[i].p_lower, pending[i].p_upper,
+                &lower_neighbours[k], &lower_classes[k],
+                &upper_neighbours[k], &upper_classes[k]);
+            if (results) {
+                results[k] = res;
+            }
+        }
+    }
+    return 0;
+}
+
+
+int
+uproc_ecurve_lookup_sorted(const uproc_ecurve *ecurve,
+                           const struct uproc_word *words, size_t n,
+                           struct uproc_word *lower_neighbours,
+                           uproc_family *lower_classes,
+                           struct uproc_word *upper_neighbours,
+                           uproc_family *upper_classes,
+                           int *results)
+{
+    int res = UPROC_ECURVE_EXACT;
+    size_t i = 0, ahead = 0, index = 0, count = 0;
+    uproc_prefix prefix = 0, p_lower = 0, p_upper = 0;
+
+    while (i < n) {
+        size_t pos = 0;
+        const uproc_suffix *suffixes;
+
+        /* the prefixes are sparse even if sorted, so their index entries
+         * are fetched ahead of time */
+        for (; ahead < n && ahead < i + 2 * LOOKUP_BATCH_SIZE; ahead++) {
+            if (ecurve->index == UPROC_ECURVE_INDEX_COMPACT) {
+                PREFETCH(&ecurve->pfxblocks[words[ahead].prefix /
+                                            RANKBLOCK_BITS]);
+            }
+            else {
+                PREFETCH(&ecurve->prefixes[words[ahead].prefix]);
+            }
+        }
+
+        /* one prefix lookup for all words with the same prefix, and also
+         * for all that fall between the same two non-empty prefixes (or
+         * beyond the same edge) as the previous ones */
+        if (!i || res == UPROC_ECURVE_EXACT || words[i].prefix <= prefix ||
+            (prefix < p_upper && words[i].prefix >= p_upper)) {
+            res = ecurve_prefix_lookup(ecurve, words[i].prefix, &index,
+                                       &count, &p_lower, &p_upper);
+        }
+        prefix = words[i].prefix;
         if (res != UPROC_ECURVE_EXACT) {
-            res = UPROC_ECURVE_INEXACT;
+            for (; i < n && words[i].prefix == prefix; i++) {
+                int r = lookup_suffix(ecurve, words[i].suffix, res, index,
+                                      count, p_lower, p_upper,
+                                      &lower_neighbours[i], &lower_classes[i],
+                                      &upper_neighbours[i], &upper_classes[i]);
+                if (results) {
+                    results[i] = r;
+                }
+            }
+            continue;
+        }
+
+        /* merge the suffixes of the words into those of the prefix; `pos`
+         * is the last one less than or equal to the current word (or 0),
+         * which is what suffix_lookup() finds as well */
+        suffixes = &ecurve->suffixes[index];
+        for (size_t start = i; i < n && words[i].prefix == prefix; i++) {
+            uproc_suffix key = words[i].suffix;
+            size_t upper, step = 1;
+
+            if (i > start && key < words[i - 1].suffix) {
+                /* not sorted, start over */
+                pos = 0;
+            }
+            /* gallop ahead, so that sparse words don't scan large buckets
+             * element by element */
+            while (pos + step < count && suffixes[pos + step] <= key) {
+                pos += step;
+                step *= 2;
+            }
+            while (step > 1) {
+                step /= 2;
+                if (pos + step < count && suffixes[pos + step] <= key) {
+                    pos += step;
+                }
+            }
+            upper = pos;
+            if (key > suffixes[pos] && pos + 1 < count) {
+                upper = pos + 1;
+            }
+            lookup_neighbours(ecurve, index + pos, index + upper,
+                              p_lower, p_upper,
+                              &lower_neighbours[i], &lower_classes[i],
+                              &upper_neighbours[i], &upper_classes[i]);
+            if (results) {
+                results[i] = key == suffixes[pos] ?
+                             UPROC_ECURVE_EXACT : UPROC_ECURVE_INEXACT;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Replace the family table by its run-length encoding, unless that isn't
+ * smaller */
+static int
+compress_families(struct uproc_ecurve_s *ec)
+{
+    size_t n = ec->suffix_count,
+           n_blocks = (n + RANKBLOCK_BITS - 1) / RANKBLOCK_BITS,
+           runs = 0;
+    uint_least32_t rank = 0;
+    struct ecurve_rankblock *blocks;
+    uproc_family *families;
+
+    for (size_t i = 0; i < n; i++) {
+        runs += !i || ec->families[i] != ec->families[i - 1];
+    }
+    if (sizeof *blocks * n_blocks + sizeof *families * runs >=
+        sizeof *families * n) {
+        return 0;
+    }
+
+    blocks = calloc(n_blocks ? n_blocks : 1, sizeof *blocks);
+    families = malloc(sizeof *families * (runs ? runs : 1));
+    if (!blocks || !families) {
+        free(blocks);
+        free(families);
+        return uproc_error(UPROC_ENOMEM);
+    }
+
+    runs = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!i || ec->families[i] != ec->families[i - 1]) {
+            blocks[i / RANKBLOCK_BITS].bits |=
+                (uint64_t) 1 << (i % RANKBLOCK_BITS);
+            families[runs++] = ec->families[i];
+        }
+    }
+    for (size_t b = 0; b < n_blocks; b++) {
+        blocks[b].rank = rank;
+        rank += popcount64(blocks[b].bits);
+    }
+
+    free(ec->families);
+    ec->families = NULL;
+    ec->family_runs = blocks;
+    ec->run_families = families;
+    ec->run_count = runs;
+    ec->compressed = 1;
+    return 0;
+}
+
+
+int
+uproc_ecurve_compress(uproc_ecurve *ecurve)
+{
+    if (ecurve->compressed) {
+        return 0;
+    }
+    if (ecurve->mmap_ptr || ecurve->borrowed) {
+        return uproc_error_msg(UPROC_EINVAL,
+                               "can't compress a memory-mapped ecurve");
+    }
+    return compress_families(ecurve);
+}
+
+
+size_t
+ecurve_prefix_suffixes(const struct uproc_ecurve_s *ecurve,
+                       uproc_prefix prefix, size_t *first)
+{
+    const struct uproc_ecurve_pfxtable *pt;
+
+    if (ecurve->index == UPROC_ECURVE_INDEX_COMPACT) {
+        int present;
+        size_t rank = compact_rank(ecurve, prefix, &present);
+        const struct ecurve_pfxentry *e = &ecurve->pfxentries[rank];
+        if (!present) {
+            return 0;
         }
+        *first = e[0].first;
+        return e[1].first - e[0].first;
+    }
+
+    pt = &ecurve->prefixes[prefix];
+    if (!pt->count || ECURVE_ISEDGE(*pt)) {
+        return 0;
+    }
+    *first = pt->first;
+    return pt->count;
+}
+
+
+void
+ecurve_prefix_entry(const struct uproc_ecurve_s *ecurve, uproc_prefix prefix,
+                    struct uproc_ecurve_pfxtable *entry)
+{
+    int present;
+    size_t rank;
+    const struct ecurve_pfxentry *e;
+
+    switch (ecurve->index) {
+        case UPROC_ECURVE_INDEX_COMPACT:
+            rank = compact_rank(ecurve, prefix, &present);
+            break;
+        case UPROC_ECURVE_INDEX_DIRECT:
+            *entry = ecurve->prefixes[prefix];
+            present = entry->count && !ECURVE_ISEDGE(*entry);
+            rank = entry->first;
+            break;
+        default:
+            *entry = ecurve->prefixes[prefix];
+            return;
+    }
+
+    e = &ecurve->pfxentries[rank];
+    if (present) {
+        if (ecurve->index == UPROC_ECURVE_INDEX_COMPACT) {
+            entry->first = e[0].first;
+            entry->count = e[1].first - e[0].first;
+        }
+    }
+    else if (!rank) {
+        entry->prev = 0;
+        entry->next = neigh_dist(prefix, e[0].prefix);
+        entry->count = ECURVE_EDGE;
+    }
+    else if (rank == ecurve->prefix_count) {
+        entry->prev = neigh_dist(e[-1].prefix, prefix);
+        entry->next = 0;
+        entry->count = ECURVE_EDGE;
     }
     else {
-        lower = 0;
-        upper = (res == UPROC_ECURVE_OOB) ? 0 : 1;
+        entry->prev = neigh_dist(e[-1].prefix, prefix);
+        entry->next = neigh_dist(prefix, e[0].prefix);
+        entry->count = 0;
     }
+}
 
-    /* `lower` and `upper` are relative to `index` */
-    lower += index;
-    upper += index;
 
-    /* populate output variables */
-    lower_neighbour->prefix = p_lower;
-    lower_neighbour->suffix = ecurve->suffixes[lower];
-    *lower_class = ecurve->families[lower];
-    upper_neighbour->prefix = p_upper;
-    upper_neighbour->suffix = ecurve->suffixes[upper];
-    *upper_class = ecurve->families[upper];
+int
+uproc_ecurve_is_compressed(const uproc_ecurve *ecurve)
+{
+    return ecurve->compressed;
+}
 
-    return res;
+
+enum uproc_ecurve_index
+uproc_ecurve_index_type(const uproc_ecurve *ecurve)
+{
+    return ecurve->index;
 }
 
+
 uproc_alphabet *
 uproc_ecurve_alphabet(const uproc_ecurve *ecurve)
 {
@@ -1,6 +1,7 @@
 #ifndef UPROC_ECURVE_INTERNAL_H
 #define UPROC_ECURVE_INTERNAL_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 typedef uint_least32_t pfxtab_suffix;
@@ -13,6 +14,40 @@ typedef uint_least16_t pfxtab_count;
 #define ECURVE_EDGE ((pfxtab_count) -1)
 #define ECURVE_ISEDGE(p) ((p).count == ECURVE_EDGE)
 
+/** Number of bits per block of a bitmap with rank information */
+#define RANKBLOCK_BITS 64
+
+/** Number of blocks of the compact index */
+#define PFXBLOCK_COUNT \
+    ((UPROC_PREFIX_MAX + RANKBLOCK_BITS) / RANKBLOCK_BITS)
+
+/** Block of a bitmap with precomputed rank
+ *
+ * Used for the occupancy bitmap of the compact prefix index and for marking
+ * the family runs of a compressed ecurve.
+ */
+struct ecurve_rankblock
+{
+    /** Bit `i` of the `n`th block represents element `n * RANKBLOCK_BITS +
+     * i` */
+    uint64_t bits;
+
+    /** Number of set bits in all preceding blocks */
+    uint32_t rank;
+
+    uint32_t reserved;
+};
+
+/** Non-empty prefix in the compact or direct prefix index */
+struct ecurve_pfxentry
+{
+    /** Prefix value */
+    uint32_t prefix;
+
+    /** Index of the first associated entry in the suffix table */
+    uint32_t first;
+};
+
 /** Struct defining an ecurve */
 struct uproc_ecurve_s
 {
@@ -38,13 +73,21 @@ struct uproc_ecurve_s
      */
     uproc_family *families;
 
+    /** Type of the prefix index, determines which of #prefixes,
+     * #pfxblocks and #pfxentries are used */
+    enum uproc_ecurve_index index;
+
     /** Table that maps prefixes to entries in the ecurve's suffix table */
     struct uproc_ecurve_pfxtable {
         union {
             /** Index of the first associated entry in #suffixes */
             pfxtab_suffix first;
 
-            /* indicates offsets towards the nearest non-empty neighbours */
+            /* indicates offsets towards the nearest non-empty neighbours
+             *
+             * With #UPROC_ECURVE_INDEX_DIRECT, `first` holds the number of
+             * non-empty prefixes less than this one instead, i.e. the
+             * position of the next non-empty prefix in #pfxentries */
             struct {
                 pfxtab_neigh prev, next;
             };
@@ -68,6 +111,45 @@ struct uproc_ecurve_s
      */
     *prefixes;
 
+    /** Compact index: occupancy bitmap
+     *
+     * Will be allocated to hold `#PFXBLOCK_COUNT` objects
+     */
+    struct ecurve_rankblock *pfxblocks;
+
+    /** Non-zero if the families are compressed
+     *
+     * In that case, #families is NULL and the families are represented by
+     * #family_runs and #run_families.
+     */
+    int compressed;
+
+    /** Compressed ecurves: bit `i` is set if the family of suffix `i`
+     * differs from the one of suffix `i - 1` (i.e. a new run starts) */
+    struct ecurve_rankblock *family_runs;
+
+    /** Compressed ecurves: family of each run */
+    uproc_family *run_families;
+
+    /** Compressed ecurves: number of family runs */
+    size_t run_count;
+
+    /** Compact and direct index: all non-empty prefixes in ascending order
+     *
+     * Followed by a sentinel entry whose `first` member is equal to
+     * #suffix_count, so that the number of suffixes associated with
+     * `pfxentries[i]` is always `pfxentries[i + 1].first -
+     * pfxentries[i].first`.
+     */
+    struct ecurve_pfxentry *pfxentries;
+
+    /** Number of non-empty prefixes (not counting the sentinel) */
+    size_t prefix_count;
+
+    /** While building: number of elements `#pfxentries` is allocated to
+     * hold */
+    size_t prefix_alloc;
+
     /** Last non-empty prefix
      *
      * Needed by uproc_ecurve_add_prefix().
@@ -81,11 +163,122 @@ struct uproc_ecurve_s
      */
     int mmap_fd;
 
-    /** `mmap()`ed memory region */
+    /** `mmap()`ed memory region
+     *
+     * Non-NULL if all data is contained in a single mapping. This is either
+     * a mapped file (if `mmap_fd` is valid) or an anonymous mapping created
+     * by uproc_ecurve_numa_copy().
+     */
     void *mmap_ptr;
 
     /** Size of the `mmap()`ed region */
     size_t mmap_size;
+
+    /** Whether the data belongs to someone else
+     *
+     * Set for ecurves created by ecurve_image_attach(), whose data is
+     * neither freed nor unmapped when they are destroyed.
+     */
+    bool borrowed;
 };
 
+
+static inline unsigned
+popcount64(uint64_t x)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return (x * 0x0101010101010101ULL) >> 56;
+#endif
+}
+
+
+/** Number of set bits before bit `i` in a bitmap with rank information
+ *
+ * `*present` is set to non-zero if bit `i` itself is set.
+ */
+static inline size_t
+rankblock_rank(const struct ecurve_rankblock *blocks, size_t i, int *present)
+{
+    const struct ecurve_rankblock *block = &blocks[i / RANKBLOCK_BITS];
+    uint64_t bit = (uint64_t) 1 << (i % RANKBLOCK_BITS);
+    *present = !!(block->bits & bit);
+    return block->rank + popcount64(block->bits & (bit - 1));
+}
+
+
+/** Family at index `i` of the suffix table */
+static inline uproc_family
+ecurve_family(const struct uproc_ecurve_s *ecurve, size_t i)
+{
+    int present;
+    if (!ecurve->compressed) {
+        return ecurve->families[i];
+    }
+    /* the first suffix always starts a run */
+    return ecurve->run_families[
+        rankblock_rank(ecurve->family_runs, i, &present) + present - 1];
+}
+
+
+/** Get the suffixes associated with a prefix
+ *
+ * Works for all types of prefix index.
+ *
+ * \param ecurve    ecurve object
+ * \param prefix    prefix
+ * \param first     _OUT_: index of the first associated suffix
+ *
+ * \return Number of associated suffixes (`0` for an empty prefix).
+ */
+size_t ecurve_prefix_suffixes(const struct uproc_ecurve_s *ecurve,
+                              uproc_prefix prefix, size_t *first);
+
+
+/** Get the prefix table entry of a prefix
+ *
+ * For ecurves with #UPROC_ECURVE_INDEX_COMPACT or #UPROC_ECURVE_INDEX_DIRECT,
+ * the entry is reconstructed as it would look like in the table index.
+ */
+void ecurve_prefix_entry(const struct uproc_ecurve_s *ecurve,
+                         uproc_prefix prefix,
+                         struct uproc_ecurve_pfxtable *entry);
+
+
+/** Size of the image of an ecurve
+ *
+ * The image is what uproc_ecurve_mmap_store() writes to a file.
+ */
+size_t ecurve_image_size(const struct uproc_ecurve_s *ecurve);
+
+
+/** Write the image of an ecurve
+ *
+ * `dst` has to be 8-byte aligned and ecurve_image_size() bytes large.
+ */
+void ecurve_image_write(const struct uproc_ecurve_s *ecurve, void *dst);
+
+
+/** Create an ecurve from an image in memory
+ *
+ * The returned ecurve refers to `image`, which has to stay valid (and
+ * unchanged) until it is destroyed.
+ */
+struct uproc_ecurve_s *ecurve_image_attach(void *image, size_t size);
+
+
+/** Map a whole file read-only
+ *
+ * `flags` is either MAP_PRIVATE or MAP_SHARED, and `opts` determines how
+ * the file is loaded (see uproc_ecurve_mmapo()). On success, the mapping is
+ * stored in `*ptr` and `*size`; `fd` is never closed.
+ */
+int ecurve_map_region(int fd, int flags,
+                      const struct uproc_ecurve_mmap_opts *opts, void **ptr,
+                      size_t *size);
+
 #endif
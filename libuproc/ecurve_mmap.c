@@ -25,6 +25,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <stdio.h>
+#include <errno.h>
 
 #if HAVE_MMAP && USE_MMAP
 #include <fcntl.h>
@@ -34,11 +36,20 @@
 #include <sys/mman.h>
 #endif
 
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#if HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
 #include "uproc/common.h"
 #include "uproc/error.h"
 #include "uproc/ecurve.h"
 
 #include "ecurve_internal.h"
+#include "io_internal.h"
 
 struct mmap_header
 {
@@ -48,22 +59,97 @@ struct mmap_header
 
 static const uint64_t magic_number = 0xd2eadfUL;
 
+/** Extended header
+ *
+ * Follows the header in files of ecurves that use a prefix index other than
+ * #UPROC_ECURVE_INDEX_TABLE or are compressed. None of the bytes of
+ * `ext_magic` is zero, while the first entry of a prefix table always starts
+ * with two zero bytes (either `prev` or the lower half of `first`), so files
+ * without this header are still recognized.
+ */
+struct mmap_ext_header
+{
+    uint64_t magic;
+    uint32_t index;
+    uint32_t compressed;
+    uint64_t prefix_count;
+    uint64_t run_count;
+};
+
+static const struct uproc_ecurve_mmap_opts default_opts =
+    UPROC_ECURVE_MMAP_OPTS_INITIALIZER;
+
 #define SIZE_HEADER (sizeof (struct mmap_header))
+#define SIZE_EXT_HEADER (sizeof (struct mmap_ext_header))
 #define SIZE_PREFIXES \
     ((UPROC_PREFIX_MAX + 1) * sizeof (struct uproc_ecurve_pfxtable))
+#define SIZE_BLOCKS (PFXBLOCK_COUNT * sizeof (struct ecurve_rankblock))
+#define SIZE_ENTRIES(prefix_count) \
+    (((prefix_count) + 1) * sizeof (struct ecurve_pfxentry))
 #define SIZE_SUFFIXES(suffix_count) ((suffix_count) * sizeof (uproc_suffix))
 #define SIZE_CLASSES(suffix_count) ((suffix_count) * sizeof (uproc_family))
-#define SIZE_TOTAL(suffix_count) \
-    (SIZE_HEADER + SIZE_PREFIXES + SIZE_SUFFIXES(suffix_count) + \
-     SIZE_CLASSES(suffix_count) + (3 * sizeof magic_number))
-
-#define OFFSET_PREFIXES (SIZE_HEADER)
-#define OFFSET_MAGIC1 (OFFSET_PREFIXES + SIZE_PREFIXES)
-#define OFFSET_SUFFIXES (OFFSET_MAGIC1 + (sizeof magic_number))
-#define OFFSET_MAGIC2(suffix_count) (OFFSET_SUFFIXES + SIZE_SUFFIXES(suffix_count))
-#define OFFSET_CLASSES(suffix_count) (OFFSET_MAGIC2(suffix_count) + (sizeof magic_number))
-#define OFFSET_MAGIC3(suffix_count) \
-    (OFFSET_CLASSES(suffix_count) + SIZE_CLASSES(suffix_count))
+#define SIZE_RUN_BLOCKS(suffix_count) \
+    (((suffix_count) + RANKBLOCK_BITS - 1) / RANKBLOCK_BITS * \
+     sizeof (struct ecurve_rankblock))
+#define SIZE_RUN_FAMILIES(run_count) ((run_count) * sizeof (uproc_family))
+
+/** Offsets of the parts of an mmap file
+ *
+ * The file consists of (in this order):
+ *  - the header
+ *  - the extended header (unless #UPROC_ECURVE_INDEX_TABLE and
+ *    uncompressed)
+ *  - the prefix table (unless #UPROC_ECURVE_INDEX_COMPACT)
+ *  - the occupancy bitmap (only #UPROC_ECURVE_INDEX_COMPACT)
+ *  - the non-empty prefixes (unless #UPROC_ECURVE_INDEX_TABLE)
+ *  - magic number, suffixes, magic number, families, magic number
+ *
+ * For compressed ecurves, the families consist of the run bitmap followed by
+ * the run families.
+ */
+struct mmap_layout
+{
+    size_t ext_header, prefixes, blocks, entries, magic1, suffixes, magic2,
+           classes, run_families, magic3, total;
+};
+
+#if HAVE_MMAP && USE_MMAP
+static void
+mmap_layout(const struct uproc_ecurve_s *ecurve, struct mmap_layout *l)
+{
+    size_t offset = SIZE_HEADER, n = ecurve->suffix_count;
+
+    *l = (struct mmap_layout) { 0 };
+    if (ecurve->index != UPROC_ECURVE_INDEX_TABLE || ecurve->compressed) {
+        l->ext_header = offset;
+        offset += SIZE_EXT_HEADER;
+    }
+    if (ecurve->index != UPROC_ECURVE_INDEX_COMPACT) {
+        l->prefixes = offset;
+        offset += SIZE_PREFIXES;
+    }
+    else {
+        l->blocks = offset;
+        offset += SIZE_BLOCKS;
+    }
+    if (ecurve->index != UPROC_ECURVE_INDEX_TABLE) {
+        l->entries = offset;
+        offset += SIZE_ENTRIES(ecurve->prefix_count);
+    }
+    l->magic1 = offset;
+    l->suffixes = l->magic1 + sizeof magic_number;
+    l->magic2 = l->suffixes + SIZE_SUFFIXES(n);
+    l->classes = l->magic2 + sizeof magic_number;
+    if (ecurve->compressed) {
+        l->run_families = l->classes + SIZE_RUN_BLOCKS(n);
+        l->magic3 = l->run_families + SIZE_RUN_FAMILIES(ecurve->run_count);
+    }
+    else {
+        l->magic3 = l->classes + SIZE_CLASSES(n);
+    }
+    l->total = l->magic3 + sizeof magic_number;
+}
+#endif
 
 #ifndef MAP_NORESERVE
 #define MAP_NORESERVE 0
@@ -72,86 +158,236 @@ static const uint64_t magic_number = 0xd2eadfUL;
 #define MAP_POPULATE 0
 #endif
 
-static uproc_ecurve *
-ecurve_map(const char *path)
+#if HAVE_MMAP && USE_MMAP
+/* Read one byte of every page of the region, using `threads` threads */
+static void
+prefault(const char *region, size_t size, int threads)
 {
+    long pagesize = sysconf(_SC_PAGESIZE);
+    size_t i, pages;
+    unsigned char sum = 0;
+
+    if (pagesize < 1) {
+        pagesize = 4096;
+    }
+    pages = (size + pagesize - 1) / pagesize;
+#if _OPENMP
+    if (threads < 1) {
+        threads = omp_get_max_threads();
+    }
+#pragma omp parallel for num_threads(threads) schedule(static) \
+    reduction(^:sum)
+#endif
+    for (i = 0; i < pages; i++) {
+        sum ^= ((const volatile unsigned char *)region)[i * pagesize];
+    }
+    (void) threads;
+    (void) sum;
+}
+#endif
+
 #if HAVE_MMAP && USE_MMAP
-    struct stat st;
+static const uint64_t ext_magic = 0xe7d2eadfe7d2eadfULL;
+
+/* Set up an ecurve from the image of `size` bytes at `image` */
+static int
+mmap_parse(struct uproc_ecurve_s *ec, char *image, size_t size)
+{
     struct mmap_header *header;
     char alphabet_str[UPROC_ALPHABET_SIZE + 1];
-    struct uproc_ecurve_s *ec = malloc(sizeof *ec);
 
-    if (!ec) {
-        uproc_error(UPROC_ENOMEM);
-        return NULL;
+    header = (void *)image;
+    if (size < SIZE_HEADER + sizeof ext_magic) {
+        uproc_error(UPROC_EINVAL);
+        return -1;
     }
-    *ec = (struct uproc_ecurve_s){ 0 };
+    ec->suffix_count = header->suffix_count;
 
-    ec->mmap_fd = open(path, O_RDONLY);
-    if (ec->mmap_fd == -1) {
-        uproc_error_msg(UPROC_ERRNO, "failed to open %s", path);
-        goto error;
+    struct mmap_ext_header *ext = (void *)(image + SIZE_HEADER);
+    if (ext->magic == ext_magic) {
+        if (size < SIZE_HEADER + SIZE_EXT_HEADER ||
+            ext->index > UPROC_ECURVE_INDEX_DIRECT) {
+            uproc_error(UPROC_EINVAL);
+            return -1;
+        }
+        ec->index = ext->index;
+        ec->compressed = ext->compressed;
+        ec->prefix_count = ext->prefix_count;
+        ec->run_count = ext->run_count;
     }
 
-    if (fstat(ec->mmap_fd, &st) == -1) {
-        uproc_error_msg(UPROC_ERRNO, "stat failed");
-        goto error_close;
+    struct mmap_layout l;
+    mmap_layout(ec, &l);
+    if (size != l.total) {
+        uproc_error(UPROC_EINVAL);
+        return -1;
+    }
+    if (l.prefixes) {
+        ec->prefixes = (void *)(image + l.prefixes);
+    }
+    if (l.blocks) {
+        ec->pfxblocks = (void *)(image + l.blocks);
+    }
+    if (l.entries) {
+        ec->pfxentries = (void *)(image + l.entries);
+    }
+    ec->suffixes = (void *)(image + l.suffixes);
+    if (ec->compressed) {
+        ec->family_runs = (void *)(image + l.classes);
+        ec->run_families = (void *)(image + l.run_families);
+    }
+    else {
+        ec->families = (void *)(image + l.classes);
     }
-    ec->mmap_size = st.st_size;
-    ec->mmap_ptr = mmap(NULL, ec->mmap_size, PROT_READ,
-                        MAP_PRIVATE | MAP_NORESERVE | MAP_POPULATE,
-                        ec->mmap_fd, 0);
 
-    if (ec->mmap_ptr == MAP_FAILED) {
-        uproc_error_msg(UPROC_ERRNO, "mmap failed");
-        goto error_close;
+    uint64_t *m1, *m2, *m3;
+    m1 = (void *)(image + l.magic1);
+    m2 = (void *)(image + l.magic2);
+    m3 = (void *)(image + l.magic3);
+    if (*m1 != magic_number || *m2 != magic_number || *m3 != magic_number) {
+        uproc_error_msg(UPROC_EINVAL, "inconsistent magic number");
+        return -1;
     }
 
-#if HAVE_POSIX_MADVISE
-#ifdef POSIX_MADV_WILLNEED
-    posix_madvise(ec->mmap_ptr, ec->mmap_size, POSIX_MADV_WILLNEED);
+    memcpy(alphabet_str, header->alphabet_str, UPROC_ALPHABET_SIZE);
+    alphabet_str[UPROC_ALPHABET_SIZE] = '\0';
+    ec->alphabet = uproc_alphabet_create(alphabet_str);
+    if (!ec->alphabet) {
+        return -1;
+    }
+    return 0;
+
+}
+
+int
+ecurve_map_region(int fd, int flags,
+                  const struct uproc_ecurve_mmap_opts *opts, void **ptr,
+                  size_t *size)
+{
+    struct stat st;
+    char *region;
+
+    flags |= MAP_NORESERVE;
+    if (fstat(fd, &st) == -1) {
+        return uproc_error_msg(UPROC_ERRNO, "stat failed");
+    }
+    *size = st.st_size;
+    /* without huge pages, the file can be populated while mapping it; the
+     * advice has to be given before the first page is faulted in, though */
+    if (opts->mode == UPROC_ECURVE_MMAP_POPULATE && !opts->hugepage) {
+        flags |= MAP_POPULATE;
+    }
+    region = mmap(NULL, *size, PROT_READ, flags, fd, 0);
+    if (region == MAP_FAILED) {
+        return uproc_error_msg(UPROC_ERRNO, "mmap failed");
+    }
+
+#if HAVE_MADVISE && defined(MADV_HUGEPAGE)
+    if (opts->hugepage) {
+        /* merely a hint, failure is not an error */
+        madvise(region, *size, MADV_HUGEPAGE);
+    }
 #endif
-#ifdef POSIX_MADV_RANDOM
-    posix_madvise(ec->mmap_ptr, ec->mmap_size, POSIX_MADV_RANDOM);
+
+#if HAVE_POSIX_MADVISE && defined(POSIX_MADV_WILLNEED)
+    if (opts->mode != UPROC_ECURVE_MMAP_LAZY) {
+        posix_madvise(region, *size, POSIX_MADV_WILLNEED);
+    }
 #endif
+    if (opts->mode == UPROC_ECURVE_MMAP_PREFAULT ||
+        (opts->mode == UPROC_ECURVE_MMAP_POPULATE && !(flags & MAP_POPULATE))) {
+        prefault(region, *size,
+                 opts->mode == UPROC_ECURVE_MMAP_PREFAULT ? opts->threads : 1);
+    }
+    /* lookups are random, so readahead on page faults is wasted (set only
+     * now, since it would also slow down prefaulting) */
+#if HAVE_POSIX_MADVISE && defined(POSIX_MADV_RANDOM)
+    posix_madvise(region, *size, POSIX_MADV_RANDOM);
 #endif
 
-    header = ec->mmap_ptr;
-    if (ec->mmap_size != SIZE_TOTAL(header->suffix_count)) {
-        uproc_error(UPROC_EINVAL);
-        goto error_munmap;
+    if (opts->mlock) {
+#if HAVE_MLOCK
+        if (mlock(region, *size)) {
+            uproc_error_msg(UPROC_ERRNO, "mlock failed");
+            munmap(region, *size);
+            return -1;
+        }
+#else
+        uproc_error_msg(UPROC_ENOTSUP, "mlock not supported");
+        munmap(region, *size);
+        return -1;
+#endif
     }
-    ec->suffix_count = header->suffix_count;
+    *ptr = region;
+    return 0;
+}
 
-    memcpy(alphabet_str, header->alphabet_str, UPROC_ALPHABET_SIZE);
-    alphabet_str[UPROC_ALPHABET_SIZE] = '\0';
-    ec->alphabet = uproc_alphabet_create(alphabet_str);
-    if (!ec->alphabet) {
-        goto error_munmap;
+/* Map the ecurve in the file `fd` refers to
+ *
+ * `flags` is either MAP_PRIVATE or MAP_SHARED. The returned ecurve takes
+ * ownership of `fd`, which is also closed on failure. */
+static uproc_ecurve *
+ecurve_map_fd(int fd, int flags, const struct uproc_ecurve_mmap_opts *opts)
+{
+    struct uproc_ecurve_s *ec = malloc(sizeof *ec);
+
+    if (!ec) {
+        close(fd);
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
     }
+    *ec = (struct uproc_ecurve_s){ 0 };
+    ec->mmap_fd = fd;
 
-   ec->prefixes = (void *)(ec->mmap_ptr + OFFSET_PREFIXES);
-   ec->suffixes = (void *)(ec->mmap_ptr + OFFSET_SUFFIXES);
-   ec->families = (void *)(ec->mmap_ptr + OFFSET_CLASSES(ec->suffix_count));
-   uint64_t *m1, *m2, *m3;
-   m1 = (void*)(ec->mmap_ptr + OFFSET_MAGIC1);
-   m2 = (void*)(ec->mmap_ptr + OFFSET_MAGIC2(ec->suffix_count));
-   m3 = (void*)(ec->mmap_ptr + OFFSET_MAGIC3(ec->suffix_count));
-   if (*m1 != magic_number || *m2 != magic_number || *m3 != magic_number) {
-       uproc_error_msg(UPROC_EINVAL, "inconsistent magic number");
-       goto error_munmap;
-   }
-   return ec;
+    if (ecurve_map_region(fd, flags, opts, &ec->mmap_ptr, &ec->mmap_size)) {
+        goto error_close;
+    }
+    if (mmap_parse(ec, ec->mmap_ptr, ec->mmap_size)) {
+        goto error_munmap;
+    }
+    return ec;
 
 error_munmap:
     munmap(ec->mmap_ptr, ec->mmap_size);
 error_close:
     close(ec->mmap_fd);
-error:
     free(ec);
     return NULL;
+}
+#endif
+
+static uproc_ecurve *
+ecurve_map(const char *path, const struct uproc_ecurve_mmap_opts *opts)
+{
+#if HAVE_MMAP && USE_MMAP
+    int fd = open(path, O_RDONLY);
+    if (fd == -1) {
+        uproc_error_msg(UPROC_ERRNO, "failed to open %s", path);
+        return NULL;
+    }
+    return ecurve_map_fd(fd, MAP_PRIVATE, opts);
 #else
     (void) path;
+    (void) opts;
+    uproc_error(UPROC_ENOTSUP);
+    return NULL;
+#endif
+}
+
+static uproc_ecurve *
+ecurve_attach_shm(const char *name, const struct uproc_ecurve_mmap_opts *opts)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        uproc_error_msg(UPROC_ERRNO, "failed to open shared memory object %s",
+                        name);
+        return NULL;
+    }
+    return ecurve_map_fd(fd, MAP_SHARED, opts);
+#else
+    (void) name;
+    (void) opts;
     uproc_error(UPROC_ENOTSUP);
     return NULL;
 #endif
@@ -170,24 +406,68 @@ uproc_ecurve_mmap(const char *pathfmt, ...)
 
 uproc_ecurve *
 uproc_ecurve_mmapv(const char *pathfmt, va_list ap)
+{
+    return uproc_ecurve_mmapov(NULL, pathfmt, ap);
+}
+
+uproc_ecurve *
+uproc_ecurve_mmapo(const struct uproc_ecurve_mmap_opts *opts,
+                   const char *pathfmt, ...)
 {
     struct uproc_ecurve_s *ec;
-    char *buf;
-    size_t n;
-    va_list aq;
+    va_list ap;
+    va_start(ap, pathfmt);
+    ec = uproc_ecurve_mmapov(opts, pathfmt, ap);
+    va_end(ap);
+    return ec;
+}
 
-    va_copy(aq, ap);
-    n = vsnprintf(NULL, 0, pathfmt, aq);
-    va_end(aq);
+uproc_ecurve *
+uproc_ecurve_mmapov(const struct uproc_ecurve_mmap_opts *opts,
+                    const char *pathfmt, va_list ap)
+{
+    struct uproc_ecurve_s *ec;
+    char *buf;
 
-    buf = malloc(n + 1);
+    if (!opts) {
+        opts = &default_opts;
+    }
+    buf = io_vformat(pathfmt, ap);
     if (!buf) {
-        uproc_error(UPROC_ENOMEM);
         return NULL;
     }
-    vsprintf(buf, pathfmt, ap);
+    ec = ecurve_map(buf, opts);
+    free(buf);
+    return ec;
+}
+
+uproc_ecurve *
+uproc_ecurve_attach_shm(const struct uproc_ecurve_mmap_opts *opts,
+                        const char *namefmt, ...)
+{
+    struct uproc_ecurve_s *ec;
+    va_list ap;
+    va_start(ap, namefmt);
+    ec = uproc_ecurve_attach_shmv(opts, namefmt, ap);
+    va_end(ap);
+    return ec;
+}
+
+uproc_ecurve *
+uproc_ecurve_attach_shmv(const struct uproc_ecurve_mmap_opts *opts,
+                         const char *namefmt, va_list ap)
+{
+    struct uproc_ecurve_s *ec;
+    char *buf;
 
-    ec = ecurve_map(buf);
+    if (!opts) {
+        opts = &default_opts;
+    }
+    buf = io_vformat(namefmt, ap);
+    if (!buf) {
+        return NULL;
+    }
+    ec = ecurve_attach_shm(buf, opts);
     free(buf);
     return ec;
 }
@@ -197,58 +477,141 @@ uproc_ecurve_munmap(struct uproc_ecurve_s *ecurve)
 {
 #if HAVE_MMAP && USE_MMAP
     munmap(ecurve->mmap_ptr, ecurve->mmap_size);
-    close(ecurve->mmap_fd);
+    if (ecurve->mmap_fd > -1) {
+        close(ecurve->mmap_fd);
+    }
 #else
     (void) ecurve;
 #endif
 }
 
-static int
-mmap_store(const struct uproc_ecurve_s *ecurve, const char *path)
-{
 #if HAVE_MMAP && USE_MMAP
-    int fd, res = 0;
-    size_t size;
-    char *region;
+/* Write the image of the ecurve with layout `l` to `region` */
+static void
+mmap_write(const struct uproc_ecurve_s *ecurve, char *region,
+           const struct mmap_layout *l)
+{
     struct mmap_header header;
 
-    size = SIZE_TOTAL(ecurve->suffix_count);
+    header.suffix_count = ecurve->suffix_count;
+    memcpy(&header.alphabet_str, uproc_alphabet_str(ecurve->alphabet),
+           UPROC_ALPHABET_SIZE);
 
-    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
-    if (fd == -1) {
-        return uproc_error_msg(UPROC_ERRNO, "failed to open %s", path);
+    memcpy(region, &header, SIZE_HEADER);
+    if (l->ext_header) {
+        struct mmap_ext_header ext = {
+            .magic = ext_magic,
+            .index = ecurve->index,
+            .compressed = ecurve->compressed,
+            .prefix_count = ecurve->prefix_count,
+            .run_count = ecurve->run_count,
+        };
+        memcpy(region + l->ext_header, &ext, SIZE_EXT_HEADER);
+    }
+    if (l->prefixes) {
+        memcpy(region + l->prefixes, ecurve->prefixes, SIZE_PREFIXES);
+    }
+    if (l->blocks) {
+        memcpy(region + l->blocks, ecurve->pfxblocks, SIZE_BLOCKS);
+    }
+    if (l->entries) {
+        memcpy(region + l->entries, ecurve->pfxentries,
+               SIZE_ENTRIES(ecurve->prefix_count));
+    }
+    memcpy(region + l->magic1, &magic_number, sizeof magic_number);
+    memcpy(region + l->suffixes, ecurve->suffixes,
+           SIZE_SUFFIXES(ecurve->suffix_count));
+    if (ecurve->compressed) {
+        memcpy(region + l->classes, ecurve->family_runs,
+               SIZE_RUN_BLOCKS(ecurve->suffix_count));
+        memcpy(region + l->run_families, ecurve->run_families,
+               SIZE_RUN_FAMILIES(ecurve->run_count));
+    }
+    else {
+        memcpy(region + l->classes, ecurve->families,
+               SIZE_CLASSES(ecurve->suffix_count));
     }
+    memcpy(region + l->magic2, &magic_number, sizeof magic_number);
+    memcpy(region + l->magic3, &magic_number, sizeof magic_number);
+}
+
+/* Write the ecurve to the (empty) file `fd` refers to */
+static int
+mmap_store_fd(const struct uproc_ecurve_s *ecurve, int fd, bool hugepage)
+{
+    size_t size;
+    char *region;
+    struct mmap_layout l;
+
+    mmap_layout(ecurve, &l);
+    size = l.total;
 
     if (ftruncate(fd, size)) {
-        res = uproc_error_msg(UPROC_ERRNO, "failed to allocate space");
-        goto error_close;
+        return uproc_error_msg(UPROC_ERRNO, "failed to allocate space");
     }
 
     region = mmap(NULL, size, PROT_WRITE, MAP_SHARED, fd, 0);
     if (region == MAP_FAILED) {
-        res = uproc_error_msg(UPROC_ERRNO, "mmap failed");
-        goto error_close;
+        return uproc_error_msg(UPROC_ERRNO, "mmap failed");
     }
+#if HAVE_MADVISE && defined(MADV_HUGEPAGE)
+    if (hugepage) {
+        madvise(region, size, MADV_HUGEPAGE);
+    }
+#else
+    (void) hugepage;
+#endif
+    mmap_write(ecurve, region, &l);
+    munmap(region, size);
+    return 0;
+}
 
-    header.suffix_count = ecurve->suffix_count;
-    memcpy(&header.alphabet_str, uproc_alphabet_str(ecurve->alphabet),
-           UPROC_ALPHABET_SIZE);
+size_t
+ecurve_image_size(const struct uproc_ecurve_s *ecurve)
+{
+    struct mmap_layout l;
+    mmap_layout(ecurve, &l);
+    return l.total;
+}
 
-    memcpy(region, &header, SIZE_HEADER);
-    memcpy(region + OFFSET_PREFIXES, ecurve->prefixes, SIZE_PREFIXES);
-    memcpy(region + OFFSET_MAGIC1, &magic_number, sizeof magic_number);
-    memcpy(region + OFFSET_SUFFIXES, ecurve->suffixes,
-           SIZE_SUFFIXES(ecurve->suffix_count));
-    memcpy(region + OFFSET_MAGIC2(ecurve->suffix_count), &magic_number, sizeof magic_number);
-    memcpy(region + OFFSET_CLASSES(ecurve->suffix_count), ecurve->families,
-           SIZE_CLASSES(ecurve->suffix_count));
-    memcpy(region + OFFSET_MAGIC3(ecurve->suffix_count), &magic_number, sizeof magic_number);
+void
+ecurve_image_write(const struct uproc_ecurve_s *ecurve, void *dst)
+{
+    struct mmap_layout l;
+    mmap_layout(ecurve, &l);
+    mmap_write(ecurve, dst, &l);
+}
 
-    munmap(region, size);
-    close(fd);
-    return 0;
+struct uproc_ecurve_s *
+ecurve_image_attach(void *image, size_t size)
+{
+    struct uproc_ecurve_s *ec = malloc(sizeof *ec);
+    if (!ec) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
+    }
+    *ec = (struct uproc_ecurve_s){ 0 };
+    ec->mmap_fd = -1;
+    ec->borrowed = true;
+    if (mmap_parse(ec, image, size)) {
+        free(ec);
+        return NULL;
+    }
+    return ec;
+}
+#endif
 
-error_close:
+static int
+mmap_store(const struct uproc_ecurve_s *ecurve, const char *path)
+{
+#if HAVE_MMAP && USE_MMAP
+    int fd, res;
+
+    fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        return uproc_error_msg(UPROC_ERRNO, "failed to open %s", path);
+    }
+    res = mmap_store_fd(ecurve, fd, false);
     close(fd);
     return res;
 #else
@@ -258,6 +621,54 @@ error_close:
 #endif
 }
 
+static int
+store_shm(const struct uproc_ecurve_s *ecurve, const char *name,
+          bool hugepage)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    int fd, res;
+
+    /* never truncate an object that might be mapped by other processes */
+    fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0);
+    if (fd == -1) {
+        return uproc_error_msg(
+            errno == EEXIST ? UPROC_EEXIST : UPROC_ERRNO,
+            "failed to create shared memory object %s", name);
+    }
+    res = mmap_store_fd(ecurve, fd, hugepage);
+    /* readable only once it is complete */
+    if (!res && fchmod(fd, 0444)) {
+        res = uproc_error_msg(UPROC_ERRNO, "chmod failed");
+    }
+    close(fd);
+    if (res) {
+        shm_unlink(name);
+    }
+    return res;
+#else
+    (void) ecurve;
+    (void) name;
+    (void) hugepage;
+    return uproc_error(UPROC_ENOTSUP);
+#endif
+}
+
+static int
+unlink_shm(const char *name)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    if (shm_unlink(name)) {
+        return uproc_error_msg(UPROC_ERRNO,
+                               "failed to remove shared memory object %s",
+                               name);
+    }
+    return 0;
+#else
+    (void) name;
+    return uproc_error(UPROC_ENOTSUP);
+#endif
+}
+
 int
 uproc_ecurve_mmap_store(const uproc_ecurve *ecurve, const char *pathfmt, ...)
 {
@@ -275,20 +686,126 @@ uproc_ecurve_mmap_storev(const uproc_ecurve *ecurve, const char *pathfmt,
 {
     int res;
     char *buf;
-    size_t n;
-    va_list aq;
 
-    va_copy(aq, ap);
-    n = vsnprintf(NULL, 0, pathfmt, aq);
-    va_end(aq);
+    buf = io_vformat(pathfmt, ap);
+    if (!buf) {
+        return -1;
+    }
+    res = mmap_store(ecurve, buf);
+    free(buf);
+    return res;
+}
 
-    buf = malloc(n + 1);
+int
+uproc_ecurve_store_shm(const uproc_ecurve *ecurve, bool hugepage,
+                       const char *namefmt, ...)
+{
+    int res;
+    va_list ap;
+    va_start(ap, namefmt);
+    res = uproc_ecurve_store_shmv(ecurve, hugepage, namefmt, ap);
+    va_end(ap);
+    return res;
+}
+
+int
+uproc_ecurve_store_shmv(const uproc_ecurve *ecurve, bool hugepage,
+                        const char *namefmt, va_list ap)
+{
+    int res;
+    char *buf;
+
+    buf = io_vformat(namefmt, ap);
     if (!buf) {
-        return uproc_error(UPROC_ENOMEM);
+        return -1;
     }
-    vsprintf(buf, pathfmt, ap);
+    res = store_shm(ecurve, buf, hugepage);
+    free(buf);
+    return res;
+}
 
-    res = mmap_store(ecurve, buf);
+int
+uproc_ecurve_unlink_shm(const char *namefmt, ...)
+{
+    int res;
+    va_list ap;
+    va_start(ap, namefmt);
+    res = uproc_ecurve_unlink_shmv(namefmt, ap);
+    va_end(ap);
+    return res;
+}
+
+int
+uproc_ecurve_unlink_shmv(const char *namefmt, va_list ap)
+{
+    int res;
+    char *buf;
+
+    buf = io_vformat(namefmt, ap);
+    if (!buf) {
+        return -1;
+    }
+    res = unlink_shm(buf);
     free(buf);
     return res;
 }
+
+uproc_ecurve *
+uproc_ecurve_numa_copy(const uproc_ecurve *ecurve, int node)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_LIBNUMA
+    struct uproc_ecurve_s *ec;
+    struct mmap_layout l;
+
+    if (numa_available() < 0) {
+        uproc_error_msg(UPROC_ENOTSUP, "NUMA is not available");
+        return NULL;
+    }
+    if (node > numa_max_node()) {
+        uproc_error_msg(UPROC_EINVAL, "invalid NUMA node %d", node);
+        return NULL;
+    }
+
+    ec = malloc(sizeof *ec);
+    if (!ec) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
+    }
+    *ec = (struct uproc_ecurve_s){ 0 };
+    ec->mmap_fd = -1;
+
+    mmap_layout(ecurve, &l);
+    ec->mmap_size = l.total;
+    ec->mmap_ptr = mmap(NULL, ec->mmap_size, PROT_READ | PROT_WRITE,
+                        MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ec->mmap_ptr == MAP_FAILED) {
+        uproc_error_msg(UPROC_ERRNO, "mmap failed");
+        free(ec);
+        return NULL;
+    }
+
+    /* the policy determines where the pages are allocated when they are
+     * first written to, no matter which CPU does that */
+    if (node < 0) {
+        numa_interleave_memory(ec->mmap_ptr, ec->mmap_size,
+                               numa_all_nodes_ptr);
+    }
+    else {
+        numa_tonode_memory(ec->mmap_ptr, ec->mmap_size, node);
+    }
+    mmap_write(ecurve, ec->mmap_ptr, &l);
+    mprotect(ec->mmap_ptr, ec->mmap_size, PROT_READ);
+
+    if (mmap_parse(ec, ec->mmap_ptr, ec->mmap_size)) {
+        munmap(ec->mmap_ptr, ec->mmap_size);
+        free(ec);
+        return NULL;
+    }
+    return ec;
+#else
+    (void) ecurve;
+    (void) node;
+    uproc_error_msg(UPROC_ENOTSUP, "NUMA is not supported");
+    return NULL;
+#endif
+}
@@ -252,10 +252,10 @@ store_plain(const struct uproc_ecurve_s *ecurve, uproc_io_stream *stream,
     }
 
     for (p = 0; p <= UPROC_PREFIX_MAX; p++) {
-        pfxtab_count suffix_count = ecurve->prefixes[p].count;
-        pfxtab_suffix first = ecurve->prefixes[p].first;
+        size_t first, suffix_count;
 
-        if (!suffix_count || ECURVE_ISEDGE(ecurve->prefixes[p])) {
+        suffix_count = ecurve_prefix_suffixes(ecurve, p, &first);
+        if (!suffix_count) {
             continue;
         }
 
@@ -264,10 +264,10 @@ store_plain(const struct uproc_ecurve_s *ecurve, uproc_io_stream *stream,
             return res;
         }
 
-        for (pfxtab_count i = 0; i < suffix_count; i++) {
+        for (size_t i = 0; i < suffix_count; i++) {
             res = store_suffix(stream, ecurve->alphabet,
                                ecurve->suffixes[first + i],
-                               ecurve->families[first + i]);
+                               ecurve_family(ecurve, first + i));
             if (res) {
                 return res;
             }
@@ -285,6 +285,13 @@ store_plain(const struct uproc_ecurve_s *ecurve, uproc_io_stream *stream,
 
 
 #if !(HAVE_MMAP && USE_MMAP)
+/* Number of elements the binary format is read or written in at once */
+#define BINARY_CHUNK (1 << 16)
+
+/* Size of a prefix table entry in the binary format (`first` immediately
+ * followed by `count`, regardless of the struct layout) */
+#define BINARY_PFXTAB_SIZE (sizeof (pfxtab_suffix) + sizeof (pfxtab_count))
+
 static uproc_ecurve *
 load_binary(uproc_io_stream *stream, void (*progress)(double))
 {
@@ -292,6 +299,7 @@ load_binary(uproc_io_stream *stream, void (*progress)(double))
     size_t sz;
     size_t suffix_count;
     char alpha[UPROC_ALPHABET_SIZE + 1];
+    unsigned char *buf;
 
     sz = uproc_io_read(alpha, sizeof *alpha, UPROC_ALPHABET_SIZE, stream);
     if (sz != UPROC_ALPHABET_SIZE) {
@@ -313,6 +321,12 @@ load_binary(uproc_io_stream *stream, void (*progress)(double))
     if (!ecurve) {
         return NULL;
     }
+    buf = malloc(BINARY_CHUNK * BINARY_PFXTAB_SIZE);
+    if (!buf) {
+        uproc_error(UPROC_ENOMEM);
+        uproc_ecurve_destroy(ecurve);
+        return NULL;
+    }
 
     sz = uproc_io_read(ecurve->suffixes, sizeof *ecurve->suffixes,
                        suffix_count, stream);
@@ -331,17 +345,22 @@ load_binary(uproc_io_stream *stream, void (*progress)(double))
         progress(50.0);
     }
 
-    for (uproc_prefix i = 0; i <= UPROC_PREFIX_MAX; i++) {
-        sz = uproc_io_read(&ecurve->prefixes[i].first,
-                           sizeof ecurve->prefixes[i].first, 1, stream);
-        if (sz != 1) {
-            goto error;
+    for (size_t i = 0; i <= UPROC_PREFIX_MAX; i += BINARY_CHUNK) {
+        size_t n = UPROC_PREFIX_MAX + 1 - i;
+        if (n > BINARY_CHUNK) {
+            n = BINARY_CHUNK;
         }
-        sz = uproc_io_read(&ecurve->prefixes[i].count,
-                           sizeof ecurve->prefixes[i].count, 1, stream);
-        if (sz != 1) {
+        sz = uproc_io_read(buf, BINARY_PFXTAB_SIZE, n, stream);
+        if (sz != n) {
             goto error;
         }
+        for (size_t k = 0; k < n; k++) {
+            struct uproc_ecurve_pfxtable *entry = &ecurve->prefixes[i + k];
+            const unsigned char *p = buf + k * BINARY_PFXTAB_SIZE;
+            memcpy(&entry->first, p, sizeof entry->first);
+            memcpy(&entry->count, p + sizeof entry->first,
+                   sizeof entry->count);
+        }
         if (progress) {
             progress(50.0 + 50.0 / UPROC_PREFIX_MAX * i);
         }
@@ -349,9 +368,11 @@ load_binary(uproc_io_stream *stream, void (*progress)(double))
     if (progress) {
         progress(100.0);
     }
+    free(buf);
     return ecurve;
 error:
     uproc_error(UPROC_ERRNO);
+    free(buf);
     uproc_ecurve_destroy(ecurve);
     return NULL;
 }
@@ -361,6 +382,8 @@ store_binary(const struct uproc_ecurve_s *ecurve, uproc_io_stream *stream,
              void (*progress)(double))
 {
     size_t sz;
+    unsigned char *buf;
+
     sz = uproc_io_write(uproc_alphabet_str(ecurve->alphabet), 1,
                         UPROC_ALPHABET_SIZE, stream);
     if (sz != UPROC_ALPHABET_SIZE) {
@@ -375,33 +398,65 @@ store_binary(const struct uproc_ecurve_s *ecurve, uproc_io_stream *stream,
         progress(0.1);
     }
 
+    /* large enough for a chunk of prefix table entries or (the smaller)
+     * families */
+    buf = malloc(BINARY_CHUNK * BINARY_PFXTAB_SIZE);
+    if (!buf) {
+        return uproc_error(UPROC_ENOMEM);
+    }
+
     sz = uproc_io_write(ecurve->suffixes, sizeof *ecurve->suffixes,
                         ecurve->suffix_count, stream);
     if (sz != ecurve->suffix_count) {
-        return uproc_error(UPROC_ERRNO);
+        goto error;
     }
     if (progress) {
         progress(25.0);
     }
-    sz = uproc_io_write(ecurve->families, sizeof *ecurve->families,
-                        ecurve->suffix_count, stream);
-    if (sz != ecurve->suffix_count) {
-        return uproc_error(UPROC_ERRNO);
+    /* this format has no compressed representation */
+    if (ecurve->compressed) {
+        uproc_family *families = (void *)buf;
+        for (size_t i = 0; i < ecurve->suffix_count; i += BINARY_CHUNK) {
+            size_t n = ecurve->suffix_count - i;
+            if (n > BINARY_CHUNK) {
+                n = BINARY_CHUNK;
+            }
+            for (size_t k = 0; k < n; k++) {
+                families[k] = ecurve_family(ecurve, i + k);
+            }
+            sz = uproc_io_write(families, sizeof *families, n, stream);
+            if (sz != n) {
+                goto error;
+            }
+        }
+    }
+    else {
+        sz = uproc_io_write(ecurve->families, sizeof *ecurve->families,
+                            ecurve->suffix_count, stream);
+        if (sz != ecurve->suffix_count) {
+            goto error;
+        }
     }
     if (progress) {
         progress(50.0);
     }
 
-    for (uproc_prefix i = 0; i <= UPROC_PREFIX_MAX; i++) {
-        sz = uproc_io_write(&ecurve->prefixes[i].first,
-                            sizeof ecurve->prefixes[i].first, 1, stream);
-        if (sz != 1) {
-            return uproc_error(UPROC_ERRNO);
+    /* the compact index is stored as the equivalent prefix table */
+    for (size_t i = 0; i <= UPROC_PREFIX_MAX; i += BINARY_CHUNK) {
+        size_t n = UPROC_PREFIX_MAX + 1 - i;
+        if (n > BINARY_CHUNK) {
+            n = BINARY_CHUNK;
         }
-        sz = uproc_io_write(&ecurve->prefixes[i].count,
-                            sizeof ecurve->prefixes[i].count, 1, stream);
-        if (sz != 1) {
-            return uproc_error(UPROC_ERRNO);
+        for (size_t k = 0; k < n; k++) {
+            struct uproc_ecurve_pfxtable entry;
+            unsigned char *p = buf + k * BINARY_PFXTAB_SIZE;
+            ecurve_prefix_entry(ecurve, i + k, &entry);
+            memcpy(p, &entry.first, sizeof entry.first);
+            memcpy(p + sizeof entry.first, &entry.count, sizeof entry.count);
+        }
+        sz = uproc_io_write(buf, BINARY_PFXTAB_SIZE, n, stream);
+        if (sz != n) {
+            goto error;
         }
         if (progress) {
             progress(50.0 + 50.0 / UPROC_PREFIX_MAX * i);
@@ -410,7 +465,11 @@ store_binary(const struct uproc_ecurve_s *ecurve, uproc_io_stream *stream,
     if (progress) {
         progress(100.0);
     }
+    free(buf);
     return 0;
+error:
+    free(buf);
+    return uproc_error(UPROC_ERRNO);
 }
 #endif
 
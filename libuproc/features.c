@@ -38,6 +38,10 @@ uproc_features_print(uproc_io_stream *stream)
     uproc_io_printf(stream, "OpenMP: %d\n", uproc_features_openmp());
     uproc_io_printf(stream, "mmap:   %s\n",
                     uproc_features_mmap() ? "yes" : "no");
+    uproc_io_printf(stream, "shm:    %s\n",
+                    uproc_features_shm() ? "yes" : "no");
+    uproc_io_printf(stream, "NUMA:   %s\n",
+                    uproc_features_numa() ? "yes" : "no");
 }
 
 const char *
@@ -72,6 +76,26 @@ uproc_features_mmap(void)
 #endif
 }
 
+bool
+uproc_features_shm(void)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+uproc_features_numa(void)
+{
+#if HAVE_MMAP && USE_MMAP && HAVE_LIBNUMA
+    return true;
+#else
+    return false;
+#endif
+}
+
 int
 uproc_features_openmp(void)
 {
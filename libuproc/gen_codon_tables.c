@@ -122,7 +122,8 @@ void gen_codon(void)
 {
     int codon_complement[UPROC_BINARY_CODON_COUNT],
         codon_is_stop[UPROC_BINARY_CODON_COUNT],
-        codon_to_char[UPROC_BINARY_CODON_COUNT];
+        codon_to_char[UPROC_BINARY_CODON_COUNT],
+        codon_translation[UPROC_BINARY_CODON_COUNT];
     unsigned i;
     for (i = 0; i < UPROC_BINARY_CODON_COUNT; i++) {
         int k;
@@ -182,12 +183,24 @@ void gen_codon(void)
         CASE("GTN", 'V');
         else codon_to_char[i] = 'X';
     }
+
+    /* everything uproc_orfiter_next() needs to know about a codon and its
+     * complement in a single lookup, see the TRANSLATION_* macros */
+    for (i = 0; i < UPROC_BINARY_CODON_COUNT; i++) {
+        int c = codon_complement[i];
+        codon_translation[i] = codon_to_char[i] | codon_to_char[c] << 8 |
+                               codon_is_stop[i] << 16 |
+                               codon_is_stop[c] << 17 | c << 18;
+    }
     table_int("codon_complement", "%5d", codon_complement,
               UPROC_BINARY_CODON_COUNT);
     printf("\n");
     table_int("codon_is_stop", "%2d", codon_is_stop, UPROC_BINARY_CODON_COUNT);
     printf("\n");
     table_int("codon_to_char", "'%c'", codon_to_char, UPROC_BINARY_CODON_COUNT);
+    printf("\n");
+    table_int("codon_translation", "%#x", codon_translation,
+              UPROC_BINARY_CODON_COUNT);
 }
 
 int main(void)
@@ -199,7 +212,14 @@ int main(void)
            "#define CODON_IS_STOP(c) (codon_is_stop[(c)])\n"
            "#define CODON_COMPLEMENT(c) ((uproc_codon)codon_complement[(c)])\n"
            "#define CODON_TO_CHAR(c) (codon_to_char[(c)])\n"
-           "#define CHAR_TO_NT(c) (char_to_nt[(unsigned char) (c)])\n");
+           "#define CHAR_TO_NT(c) (char_to_nt[(unsigned char) (c)])\n"
+           "\n"
+           "#define CODON_TRANSLATION(c) (codon_translation[(c)])\n"
+           "#define TRANSLATION_CHAR(t) ((t) & 0xff)\n"
+           "#define TRANSLATION_COMPLEMENT_CHAR(t) (((t) >> 8) & 0xff)\n"
+           "#define TRANSLATION_IS_STOP(t) ((t) & (1 << 16))\n"
+           "#define TRANSLATION_COMPLEMENT_IS_STOP(t) ((t) & (1 << 17))\n"
+           "#define TRANSLATION_COMPLEMENT(t) ((uproc_codon)((t) >> 18))\n");
 
     return EXIT_SUCCESS;
 }
@@ -69,6 +69,13 @@ uproc_idmap_family(uproc_idmap *map, const char *s)
             return i;
         }
     }
+    return uproc_idmap_append(map, s);
+}
+
+uproc_family
+uproc_idmap_append(uproc_idmap *map, const char *s)
+{
+    uproc_family i = map->n;
     if (map->n == UPROC_FAMILY_MAX) {
         uproc_error_msg(UPROC_ENOENT, "idmap exhausted");
         return UPROC_FAMILY_INVALID;
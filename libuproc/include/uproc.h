@@ -96,6 +96,10 @@
  *
  * The \ref sec_error mechanisms are only tested with OpenMP and might not
  * behave correctly if used in conjunction with other threading implementations.
+ * The same holds for the workspace used by uproc_protclass_classify() and
+ * uproc_dnaclass_classify(); with other threading implementations, pass a
+ * workspace of each thread to the \c _ctx variants of these functions (see
+ * \ref obj_classify_ctx).
  */
 
 /**
@@ -109,6 +113,8 @@
  *
  *   \defgroup grp_clf_dna DNA classification
  *     <!-- dnaclass.h -->
+ *   \defgroup grp_clf_ctx Classification workspace
+ *     <!-- classify.h -->
  * \}
  *
  *
@@ -124,6 +130,9 @@
  * \defgroup grp_features Info about compile-time features
  *   <!-- features.h -->
  *
+ * \defgroup grp_numa NUMA placement
+ *   <!-- numa.h -->
+ *
  * \defgroup grp_error Error handling
  *   <!-- error.h -->
  *
@@ -147,6 +156,9 @@
  *
  *   \defgroup grp_datastructs_idmap ID map
  *     <!-- idmap.h -->
+ *
+ *   \defgroup grp_datastructs_container Database container
+ *     <!-- container.h -->
  * \}
  *
  * \defgroup grp_intern Lower-level modules
@@ -174,8 +186,10 @@
 
 #include <uproc/alphabet.h>
 #include <uproc/bst.h>
+#include <uproc/classify.h>
 #include <uproc/codon.h>
 #include <uproc/common.h>
+#include <uproc/container.h>
 #include <uproc/dnaclass.h>
 #include <uproc/ecurve.h>
 #include <uproc/error.h>
@@ -184,6 +198,7 @@
 #include <uproc/io.h>
 #include <uproc/list.h>
 #include <uproc/matrix.h>
+#include <uproc/numa.h>
 #include <uproc/orf.h>
 #include <uproc/protclass.h>
 #include <uproc/substmat.h>
@@ -30,6 +30,8 @@
 #ifndef UPROC_ALPHABET_H
 #define UPROC_ALPHABET_H
 
+#include <stddef.h>
+
 #include "uproc/common.h"
 
 
@@ -82,6 +84,20 @@ void uproc_alphabet_destroy(uproc_alphabet *alpha);
 uproc_amino uproc_alphabet_char_to_amino(const uproc_alphabet *alpha, int c);
 
 
+/** Translate a sequence to amino acids
+ *
+ * Stores uproc_alphabet_char_to_amino() of each of the first \c len
+ * characters of \c seq.
+ *
+ * \param alpha     alphabet object
+ * \param seq       sequence to translate
+ * \param len       number of characters to translate
+ * \param aminos    _OUT_: array of \c len amino acids
+ */
+void uproc_alphabet_translate(const uproc_alphabet *alpha, const char *seq,
+                              size_t len, uproc_amino *aminos);
+
+
 /** Translate amino acid to character
  *
  * \param alpha     alphabet object
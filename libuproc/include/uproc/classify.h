@@ -0,0 +1,102 @@
+/* Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file uproc/classify.h
+ *
+ * Module: \ref grp_clf_ctx
+ *
+ * \weakgroup grp_clf
+ * \{
+ *
+ * \weakgroup grp_clf_ctx
+ * \{
+ */
+
+#ifndef UPROC_CLASSIFY_H
+#define UPROC_CLASSIFY_H
+
+
+/** \defgroup obj_classify_ctx object uproc_classify_ctx
+ *
+ * Scratch memory for classifying sequences
+ *
+ * A classification workspace holds everything uproc_protclass_classify_ctx()
+ * and uproc_dnaclass_classify_ctx() need besides the classifier itself and
+ * the result list (iterators, score tables and ORF buffers). The buffers are
+ * kept and reused for the next sequence, so that once they have grown to
+ * the size required by the input, classifying does not allocate memory.
+ *
+ * A workspace is not tied to a particular classifier, but it must not be
+ * used by more than one thread at a time; the usual way is to create one
+ * per thread.
+ *
+ * uproc_protclass_classify() and uproc_dnaclass_classify() use a workspace
+ * of the calling thread (see uproc_classify_ctx_thread()) that is created on
+ * first use and destroyed when the thread exits.
+ *
+ * \{
+ */
+
+/** \struct uproc_classify_ctx
+ * \copybrief obj_classify_ctx
+ *
+ * See \ref obj_classify_ctx for details.
+ */
+typedef struct uproc_classify_ctx_s uproc_classify_ctx;
+
+
+/** Create classification workspace
+ *
+ * The buffers are allocated when they are needed for the first time.
+ */
+uproc_classify_ctx *uproc_classify_ctx_create(void);
+
+
+/** Destroy classification workspace */
+void uproc_classify_ctx_destroy(uproc_classify_ctx *ctx);
+
+
+/** Workspace of the calling thread
+ *
+ * Returns the workspace used by the classification functions without a
+ * \c ctx parameter when called from this thread, creating it if necessary.
+ * It must not be destroyed.
+ */
+uproc_classify_ctx *uproc_classify_ctx_thread(void);
+
+
+/** Neighbour cache statistics
+ *
+ * Reports how many words were looked up in the neighbour cache of \c ctx
+ * (see uproc_protclass_set_cache()) and how many of them were found, summed
+ * over all sequences classified with \c ctx so far.
+ *
+ * \param ctx       classification workspace
+ * \param lookups   _OUT_: number of cache lookups
+ * \param hits      _OUT_: number of lookups that found the word
+ */
+void uproc_classify_ctx_cache_stats(const uproc_classify_ctx *ctx,
+                                    unsigned long long *lookups,
+                                    unsigned long long *hits);
+/** \} */
+
+/**
+ * \}
+ * \}
+ */
+#endif
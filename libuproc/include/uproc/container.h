@@ -0,0 +1,219 @@
+/* Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file uproc/container.h
+ *
+ * Module: \ref grp_datastructs_container
+ *
+ * \weakgroup grp_datastructs
+ * \{
+ *
+ * \weakgroup grp_datastructs_container
+ * \{
+ */
+
+#ifndef UPROC_CONTAINER_H
+#define UPROC_CONTAINER_H
+
+#include <stdarg.h>
+
+#include "uproc/ecurve.h"
+#include "uproc/idmap.h"
+#include "uproc/matrix.h"
+#include "uproc/substmat.h"
+
+
+/** \defgroup obj_container object uproc_container
+ *
+ * Single file holding several named objects
+ *
+ * A container file starts with a header (including a format version and a
+ * byte order marker) and a table of its sections. Every section starts at
+ * a multiple of ::UPROC_CONTAINER_ALIGN, and ecurves are stored in the same
+ * format as used by uproc_ecurve_mmap(), so that a whole database can be
+ * loaded by mapping one file and without parsing any text.
+ *
+ * Like the binary ecurve format, container files are machine-dependent;
+ * files written on a machine with a different byte order or word size are
+ * rejected.
+ *
+ * A container object is either built using uproc_container_create() and
+ * the uproc_container_add_*() functions and written with
+ * uproc_container_store(), or obtained from uproc_container_mmap() and read
+ * using the other accessor functions.
+ *
+ * \{
+ */
+
+/** \struct uproc_container
+ * \copybrief obj_container
+ *
+ * See \ref obj_container for details.
+ */
+typedef struct uproc_container_s uproc_container;
+
+
+/** Current version of the container format */
+#define UPROC_CONTAINER_VERSION 1
+
+
+/** Alignment of the sections of a container file */
+#define UPROC_CONTAINER_ALIGN 4096
+
+
+/** Maximum length of a section name */
+#define UPROC_CONTAINER_NAME_MAX 31
+
+
+/** Create an empty container object */
+uproc_container *uproc_container_create(void);
+
+
+/** Destroy container object
+ *
+ * Objects added to the container are not affected, but ecurves obtained
+ * using uproc_container_ecurve() refer to the mapped file and have to be
+ * destroyed before the container.
+ */
+void uproc_container_destroy(uproc_container *container);
+
+
+/** Add an ecurve to a container
+ *
+ * The ecurve is only referred to and not copied until
+ * uproc_container_store() is called, so it must not be modified or
+ * destroyed before.
+ *
+ * \param container container created by uproc_container_create()
+ * \param name      section name, at most ::UPROC_CONTAINER_NAME_MAX
+ *                  characters and unique within the container
+ * \param ecurve    ecurve to add
+ */
+int uproc_container_add_ecurve(uproc_container *container, const char *name,
+                               const uproc_ecurve *ecurve);
+
+
+/** Add an idmap to a container
+ *
+ * See uproc_container_add_ecurve().
+ */
+int uproc_container_add_idmap(uproc_container *container, const char *name,
+                              const uproc_idmap *idmap);
+
+
+/** Add a matrix to a container
+ *
+ * See uproc_container_add_ecurve().
+ */
+int uproc_container_add_matrix(uproc_container *container, const char *name,
+                               const uproc_matrix *matrix);
+
+
+/** Add a substitution matrix to a container
+ *
+ * See uproc_container_add_ecurve().
+ */
+int uproc_container_add_substmat(uproc_container *container,
+                                 const char *name,
+                                 const uproc_substmat *substmat);
+
+
+/** Write container to a file
+ *
+ * \param container container created by uproc_container_create()
+ * \param pathfmt   printf format string for file path
+ * \param ...       format string arguments
+ */
+int uproc_container_store(const uproc_container *container,
+                          const char *pathfmt, ...);
+
+
+/** Write container to a file
+ *
+ * Like uproc_container_store(), but with a \c va_list instead of a variable
+ * number of arguments.
+ */
+int uproc_container_storev(const uproc_container *container,
+                           const char *pathfmt, va_list ap);
+
+
+/** Map a container file
+ *
+ * The file is mapped as a whole, which is brought into memory as described
+ * by \c opts (see uproc_ecurve_mmapo()).
+ *
+ * \param opts      load options, NULL for the defaults
+ * \param pathfmt   printf format string for file path
+ * \param ...       format string arguments
+ */
+uproc_container *uproc_container_mmap(
+    const struct uproc_ecurve_mmap_opts *opts, const char *pathfmt, ...);
+
+
+/** Map a container file
+ *
+ * Like uproc_container_mmap(), but with a \c va_list instead of a variable
+ * number of arguments.
+ */
+uproc_container *uproc_container_mmapv(
+    const struct uproc_ecurve_mmap_opts *opts, const char *pathfmt,
+    va_list ap);
+
+
+/** Get an ecurve from a mapped container
+ *
+ * The returned ecurve refers to the mapped file without copying it, and has
+ * to be destroyed before \c container.
+ *
+ * \param container container obtained from uproc_container_mmap()
+ * \param name      section name
+ */
+uproc_ecurve *uproc_container_ecurve(const uproc_container *container,
+                                     const char *name);
+
+
+/** Get a copy of an idmap from a mapped container
+ *
+ * See uproc_container_ecurve(); the returned object is independent of
+ * \c container.
+ */
+uproc_idmap *uproc_container_idmap(const uproc_container *container,
+                                   const char *name);
+
+
+/** Get a copy of a matrix from a mapped container
+ *
+ * See uproc_container_idmap().
+ */
+uproc_matrix *uproc_container_matrix(const uproc_container *container,
+                                     const char *name);
+
+
+/** Get a copy of a substitution matrix from a mapped container
+ *
+ * See uproc_container_idmap().
+ */
+uproc_substmat *uproc_container_substmat(const uproc_container *container,
+                                         const char *name);
+/** \} */
+
+/**
+ * \}
+ * \}
+ */
+#endif
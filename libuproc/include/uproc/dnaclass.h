@@ -112,12 +112,17 @@ int uproc_dnaresult_copy(struct uproc_dnaresult *dest,
  * \li A ::uproc_orfiter instance using the parameters that were passed to
  * uproc_dnaclass_create() is used to extract all relevant ORFs.
  *
- * \li Every ORF is classified with uproc_protclass_classify().
+ * \li Every ORF is classified with uproc_protclass_classify(), except for
+ * those that are too short to contain a single word.
  *
  * \li For each protein family, the result of the best-scoring ORF is reported.
  *
  * \li If the ::UPROC_DNACLASS_MAX mode is used, only the protein family with
- * the highest score is retained in the result list.
+ * the highest score is retained in the result list. The ORFs are then
+ * classified longest first, and ORFs that can't beat the best result found
+ * so far (see uproc_protclass_set_thresh()) are skipped. In the
+ * ::UPROC_DNACLASS_TOP_K mode, the \c k families with the highest scores are
+ * retained.
  *
  * \{
  */
@@ -136,15 +141,24 @@ typedef struct uproc_dnaclass_s uproc_dnaclass;
  */
 enum uproc_dnaclass_mode
 {
-    /** Only the result with the maximum score */
+    /** All results (unordered) */
     UPROC_DNACLASS_ALL,
 
-    /** All results (unordered) */
+    /** Only the result with the maximum score */
     UPROC_DNACLASS_MAX,
+
+    /** The results with the \c k highest scores, in descending order of
+     * score (see uproc_dnaclass_set_top_k()) */
+    UPROC_DNACLASS_TOP_K,
 };
 
 
 /** Create new DNA classifier
+ *
+ * The ORFs are classified without being turned into amino acid strings,
+ * which are only made for the ORFs in the results. Therefore, the
+ * \c data member of the ORFs passed to \c orf_filter and the sequence
+ * passed to the protein filter of \c pc are NULL.
  *
  * \param mode              Which results to produce
  * \param pc                ::uproc_protclass to use for classifying ORFs
@@ -169,8 +183,9 @@ void uproc_dnaclass_destroy(uproc_dnaclass *dc);
  * (in which case a new list is created) or which has which has already been
  * used with this function.
  * The list will contain items of type \ref struct_dnaresult. If \c *results is
- * not NULL, all its elements will be passed to ::uproc_dnaresult_free at the
- * beginning.
+ * not NULL, all its elements will be freed at the beginning (their ORF
+ * buffers are kept for reuse by the classification workspace, see
+ * \ref obj_classify_ctx).
  *
  * \param dc        DNA classifier
  * \param seq       sequence to classify
@@ -178,6 +193,55 @@ void uproc_dnaclass_destroy(uproc_dnaclass *dc);
  */
 int uproc_dnaclass_classify(const uproc_dnaclass *dc, const char *seq,
                             uproc_list **results);
+
+
+/** Classify DNA sequence using a workspace
+ *
+ * Like uproc_dnaclass_classify(), but using the buffers of \c ctx instead
+ * of those of the calling thread.
+ *
+ * \param dc        DNA classifier
+ * \param ctx       classification workspace
+ * \param seq       sequence to classify
+ * \param results   _OUT_: classification results
+ */
+int uproc_dnaclass_classify_ctx(const uproc_dnaclass *dc,
+                                uproc_classify_ctx *ctx, const char *seq,
+                                uproc_list **results);
+
+
+/** Classify many DNA sequences at once
+ *
+ * Gives the same results as calling uproc_dnaclass_classify_ctx() for each
+ * of the \c n sequences, but classifies the ORFs of many sequences
+ * together using uproc_protclass_classify_many().
+ *
+ * \param dc        DNA classifier
+ * \param ctx       classification workspace
+ * \param seqs      sequences to classify
+ * \param n         number of sequences
+ * \param results   _OUT_: array of \c n result lists (see
+ *                  uproc_dnaclass_classify())
+ */
+int uproc_dnaclass_classify_many(const uproc_dnaclass *dc,
+                                 uproc_classify_ctx *ctx,
+                                 const char *const *seqs, size_t n,
+                                 uproc_list **results);
+
+
+/** Set the number of results of the ::UPROC_DNACLASS_TOP_K mode
+ *
+ * Like uproc_protclass_set_top_k(). Using the ::UPROC_PROTCLASS_TOP_K mode
+ * with the same \c k for the protein classifier doesn't change the results,
+ * since a family that is among the \c k best of the DNA sequence is also
+ * among the \c k best of the ORF it was predicted from.
+ *
+ * Defaults to 1.
+ *
+ * \param dc        DNA classifier
+ * \param k         maximum number of results per sequence
+ */
+void uproc_dnaclass_set_top_k(uproc_dnaclass *dc, size_t k);
 /** \} */
 
 /**
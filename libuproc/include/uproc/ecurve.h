@@ -32,6 +32,7 @@
 
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdbool.h>
 
 #include "uproc/alphabet.h"
 #include "uproc/io.h"
@@ -80,6 +81,93 @@ enum uproc_ecurve_format
 };
 
 
+/** Prefix index type
+ *
+ * Determines how an ecurve maps prefixes to their suffixes.
+ */
+enum uproc_ecurve_index
+{
+    /** Table with an entry for every possible prefix
+     *
+     * Lookups need only a single memory access, but the table always takes
+     * about 384 MB, no matter how many prefixes are actually stored.
+     */
+    UPROC_ECURVE_INDEX_TABLE,
+
+    /** Occupancy bitmap with rank information plus a dense array of the
+     * non-empty prefixes
+     *
+     * Takes about 16 MB plus 8 bytes per non-empty prefix, at the cost of
+     * one additional memory access per lookup.
+     */
+    UPROC_ECURVE_INDEX_COMPACT,
+
+    /** Like ::UPROC_ECURVE_INDEX_TABLE, but the entries of empty prefixes
+     * point directly to their nearest non-empty neighbours
+     *
+     * Lookups of empty prefixes take a fixed number of memory accesses,
+     * instead of following a chain of entries through sparse regions of the
+     * table. Takes 8 bytes per non-empty prefix in addition to the table.
+     */
+    UPROC_ECURVE_INDEX_DIRECT,
+};
+
+
+/** How uproc_ecurve_mmapo() brings the mapped file into memory */
+enum uproc_ecurve_mmap_mode
+{
+    /** Don't read anything in advance, pages are read on first access
+     *
+     * Mapping is almost instantaneous, but the first lookups stall on page
+     * faults. Good for short jobs that touch only a small part of the
+     * ecurve.
+     */
+    UPROC_ECURVE_MMAP_LAZY,
+
+    /** Read the whole file while mapping it (`MAP_POPULATE`) */
+    UPROC_ECURVE_MMAP_POPULATE,
+
+    /** Map lazily, then touch every page using multiple threads
+     *
+     * Like ::UPROC_ECURVE_MMAP_POPULATE, but the page faults are spread over
+     * several threads, which is faster if the file is in the page cache or
+     * on a device that benefits from parallel reads.
+     */
+    UPROC_ECURVE_MMAP_PREFAULT,
+};
+
+
+/** Options for uproc_ecurve_mmapo() */
+struct uproc_ecurve_mmap_opts
+{
+    /** Load strategy */
+    enum uproc_ecurve_mmap_mode mode;
+
+    /** Number of threads used by ::UPROC_ECURVE_MMAP_PREFAULT
+     *
+     * If less than 1, the OpenMP default number of threads is used.
+     */
+    int threads;
+
+    /** Lock the mapping into memory using `mlock()` */
+    bool mlock;
+
+    /** Ask the kernel to back the mapping with transparent huge pages
+     *
+     * Reduces TLB misses on lookups. Whether file-backed mappings can use
+     * huge pages depends on the operating system and file system (on Linux,
+     * e.g. tmpfs mounted with `huge=advise` or a kernel with
+     * `CONFIG_READ_ONLY_THP_FOR_FS`); otherwise this has no effect.
+     */
+    bool hugepage;
+};
+
+/** Initializer for ::uproc_ecurve_mmap_opts, equivalent to the behaviour of
+ * uproc_ecurve_mmap() */
+#define UPROC_ECURVE_MMAP_OPTS_INITIALIZER \
+    { UPROC_ECURVE_MMAP_POPULATE, 0, false, false }
+
+
 /** Lookup return codes */
 enum
 {
@@ -103,6 +191,22 @@ enum
 uproc_ecurve *uproc_ecurve_create(const char *alphabet, size_t suffix_count);
 
 
+/** Create ecurve object with a specific prefix index
+ *
+ * Like uproc_ecurve_create(), which uses ::UPROC_ECURVE_INDEX_TABLE. An ecurve
+ * with any other index type can only be built incrementally using
+ * uproc_ecurve_add_prefix(), so \c suffix_count must be \c 0 in that case.
+ *
+ * \param alphabet      string to initialize the ecurve's alphabet
+ *                      (see uproc_alphabet_init())
+ * \param suffix_count  number of entries in the suffix table
+ * \param index         prefix index type, see ::uproc_ecurve_index
+ */
+uproc_ecurve *uproc_ecurve_create_with_index(const char *alphabet,
+                                             size_t suffix_count,
+                                             enum uproc_ecurve_index index);
+
+
 /** Destroy ecurve object */
 void uproc_ecurve_destroy(uproc_ecurve *ecurve);
 
@@ -163,6 +267,27 @@ int uproc_ecurve_add_prefix(uproc_ecurve *ecurve, uproc_prefix pfx,
 int uproc_ecurve_finalize(uproc_ecurve *ecurve);
 
 
+/** Compress the family table of an ecurve
+ *
+ * Replaces the family table by a run-length encoding that still allows
+ * random access. Lookups become slightly slower, but the ecurve takes less
+ * memory if neighbouring suffixes tend to belong to the same family. If the
+ * encoding would not be smaller than the table, the ecurve is left
+ * unchanged, which can be checked with uproc_ecurve_is_compressed(). The
+ * compressed representation is preserved by uproc_ecurve_mmap_store() and
+ * uproc_ecurve_mmap().
+ *
+ * \c ecurve must be finalized and must not be memory-mapped. Afterwards,
+ * no prefixes can be added anymore. Compressing an already compressed
+ * ecurve does nothing.
+ */
+int uproc_ecurve_compress(uproc_ecurve *ecurve);
+
+
+/** Return non-zero if the ecurve is compressed (see uproc_ecurve_compress()) */
+int uproc_ecurve_is_compressed(const uproc_ecurve *ecurve);
+
+
 /** Find the closest neighbours of a word in the ecurve
  *
  * NOTE: \c ecurve may not be empty.
@@ -195,6 +320,69 @@ int uproc_ecurve_lookup(const uproc_ecurve *ecurve,
                         uproc_family *upper_class);
 
 
+/** Find the closest neighbours of multiple words in the ecurve
+ *
+ * Performs the same lookup as uproc_ecurve_lookup() for each of the \c n
+ * elements of \c words, storing the results at the same index of the output
+ * arrays. The lookups are interleaved in small batches and the involved parts
+ * of the ecurve are prefetched, so that the cache and TLB misses of several
+ * lookups overlap instead of stalling one after another. This is a lot faster
+ * than consecutive calls to uproc_ecurve_lookup() if the ecurve is too large
+ * for the CPU caches.
+ *
+ * \param ecurve            ecurve object
+ * \param words             words to search
+ * \param n                 number of elements in \c words
+ * \param lower_neighbours  _OUT_: lower neighbour words
+ * \param lower_classes     _OUT_: classes of the lower neighbours
+ * \param upper_neighbours  _OUT_: upper neighbour words
+ * \param upper_classes     _OUT_: classes of the upper neighbours
+ * \param results           _OUT_: return values of the single lookups as
+ *                          described in uproc_ecurve_lookup() (may be NULL)
+ */
+int uproc_ecurve_lookup_batch(const uproc_ecurve *ecurve,
+                              const struct uproc_word *words, size_t n,
+                              struct uproc_word *lower_neighbours,
+                              uproc_family *lower_classes,
+                              struct uproc_word *upper_neighbours,
+                              uproc_family *upper_classes,
+                              int *results);
+
+
+/** Find the closest neighbours of sorted words in the ecurve
+ *
+ * Like uproc_ecurve_lookup_batch(), but for words sorted in ascending order
+ * (see uproc_word_cmp()). The prefix index is consulted once per distinct
+ * prefix, and the suffixes associated with it are merged with those of the
+ * words in a single pass instead of being searched for each word. The
+ * ecurve is thus read front to back, and each part of it at most once.
+ *
+ * The results are correct for unsorted words as well, but then the suffix
+ * table is scanned again whenever the order is broken.
+ *
+ * \param ecurve            ecurve object
+ * \param words             words to search, preferably sorted
+ * \param n                 number of elements in \c words
+ * \param lower_neighbours  _OUT_: lower neighbour words
+ * \param lower_classes     _OUT_: classes of the lower neighbours
+ * \param upper_neighbours  _OUT_: upper neighbour words
+ * \param upper_classes     _OUT_: classes of the upper neighbours
+ * \param results           _OUT_: return values of the single lookups as
+ *                          described in uproc_ecurve_lookup() (may be NULL)
+ */
+int uproc_ecurve_lookup_sorted(const uproc_ecurve *ecurve,
+                               const struct uproc_word *words, size_t n,
+                               struct uproc_word *lower_neighbours,
+                               uproc_family *lower_classes,
+                               struct uproc_word *upper_neighbours,
+                               uproc_family *upper_classes,
+                               int *results);
+
+
+/** Return the type of the ecurve's prefix index */
+enum uproc_ecurve_index uproc_ecurve_index_type(const uproc_ecurve *ecurve);
+
+
 /** Return the internal alphabet */
 uproc_alphabet *uproc_ecurve_alphabet(const uproc_ecurve *ecurve);
 
@@ -350,14 +538,37 @@ int uproc_ecurve_storepv(const uproc_ecurve *ecurve,
 uproc_ecurve *uproc_ecurve_mmap(const char *pathfmt, ...);
 
 
-/** Store ecurve to file
+/** Map a file to an ecurve
  *
- * Like uproc_ecurve_store(), but with a \c va_list instead of a variable
+ * Like uproc_ecurve_mmap(), but with a \c va_list instead of a variable
  * number of arguments.
  */
 uproc_ecurve *uproc_ecurve_mmapv(const char *pathfmt, va_list ap);
 
 
+/** Map a file to an ecurve using the given load options
+ *
+ * Like uproc_ecurve_mmap(), but \c opts controls how the file is brought
+ * into memory. Passing NULL is equivalent to using
+ * ::UPROC_ECURVE_MMAP_OPTS_INITIALIZER.
+ *
+ * \param opts      load options, see ::uproc_ecurve_mmap_opts
+ * \param pathfmt   printf format string for file path
+ * \param ...       format string arguments
+ */
+uproc_ecurve *uproc_ecurve_mmapo(const struct uproc_ecurve_mmap_opts *opts,
+                                 const char *pathfmt, ...);
+
+
+/** Map a file to an ecurve using the given load options
+ *
+ * Like uproc_ecurve_mmapo(), but with a \c va_list instead of a variable
+ * number of arguments.
+ */
+uproc_ecurve *uproc_ecurve_mmapov(const struct uproc_ecurve_mmap_opts *opts,
+                                  const char *pathfmt, va_list ap);
+
+
 /** Release mapping and close the underlying file descriptor
  *
  * \param ecurve    ecurve mapped with uproc_mmap_map()
@@ -384,6 +595,91 @@ int uproc_ecurve_mmap_store(const uproc_ecurve *ecurve,
  */
 int uproc_ecurve_mmap_storev(const uproc_ecurve *ecurve, const char *pathfmt,
                              va_list ap);
+
+
+/** Store ecurve in a POSIX shared memory object
+ *
+ * Creates the shared memory object \c name (which should start with a
+ * slash, see `shm_open(3)`) and stores the ecurve in it, using the same
+ * layout as uproc_ecurve_mmap_store(). Other processes can then use
+ * uproc_ecurve_attach_shm() to access the ecurve without loading it on their
+ * own. The object remains in memory until it is removed using
+ * uproc_ecurve_unlink_shm() (or the system is rebooted).
+ *
+ * Fails with ::UPROC_EEXIST if an object with the same name already exists.
+ * The object only becomes readable once it is complete.
+ *
+ * \param ecurve    ecurve to store
+ * \param hugepage  ask the kernel to back the object with huge pages
+ * \param namefmt   printf format string for the object name
+ * \param ...       format string arguments
+ */
+int uproc_ecurve_store_shm(const uproc_ecurve *ecurve, bool hugepage,
+                           const char *namefmt, ...);
+
+
+/** Store ecurve in a POSIX shared memory object
+ *
+ * Like uproc_ecurve_store_shm(), but with a \c va_list instead of a variable
+ * number of arguments.
+ */
+int uproc_ecurve_store_shmv(const uproc_ecurve *ecurve, bool hugepage,
+                            const char *namefmt, va_list ap);
+
+
+/** Attach to an ecurve in a POSIX shared memory object
+ *
+ * Maps an object created by uproc_ecurve_store_shm() read-only. The returned
+ * ecurve is released by uproc_ecurve_destroy() like any other, which leaves
+ * the shared memory object intact.
+ *
+ * \param opts      load options (may be NULL), see ::uproc_ecurve_mmap_opts
+ * \param namefmt   printf format string for the object name
+ * \param ...       format string arguments
+ */
+uproc_ecurve *uproc_ecurve_attach_shm(const struct uproc_ecurve_mmap_opts *opts,
+                                      const char *namefmt, ...);
+
+
+/** Attach to an ecurve in a POSIX shared memory object
+ *
+ * Like uproc_ecurve_attach_shm(), but with a \c va_list instead of a variable
+ * number of arguments.
+ */
+uproc_ecurve *uproc_ecurve_attach_shmv(
+    const struct uproc_ecurve_mmap_opts *opts, const char *namefmt,
+    va_list ap);
+
+
+/** Remove a shared memory object created by uproc_ecurve_store_shm()
+ *
+ * Processes that are attached to the ecurve can continue to use it; the
+ * memory is released after the last of them has detached.
+ *
+ * \param namefmt   printf format string for the object name
+ * \param ...       format string arguments
+ */
+int uproc_ecurve_unlink_shm(const char *namefmt, ...);
+
+
+/** Remove a shared memory object created by uproc_ecurve_store_shm()
+ *
+ * Like uproc_ecurve_unlink_shm(), but with a \c va_list instead of a
+ * variable number of arguments.
+ */
+int uproc_ecurve_unlink_shmv(const char *namefmt, va_list ap);
+
+
+/** Copy an ecurve to the memory of a NUMA node
+ *
+ * Creates a read-only copy of \c ecurve whose memory is allocated on the
+ * given NUMA node, or interleaved page by page over all nodes if \c node is
+ * negative. The copy does not depend on \c ecurve.
+ *
+ * \param ecurve    ecurve to copy
+ * \param node      NUMA node (see \ref grp_numa) or -1
+ */
+uproc_ecurve *uproc_ecurve_numa_copy(const uproc_ecurve *ecurve, int node);
 /** \} */
 
 /**
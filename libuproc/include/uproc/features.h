@@ -52,6 +52,14 @@ const char *uproc_features_zlib_version(void);
 bool uproc_features_mmap(void);
 
 
+/** Check support for ecurves in shared memory (see uproc_ecurve_store_shm()) */
+bool uproc_features_shm(void);
+
+
+/** Check NUMA support (see \ref grp_numa) */
+bool uproc_features_numa(void);
+
+
 /** Obtain OpenMP version
  *
  * \return
@@ -74,6 +74,19 @@ void uproc_idmap_destroy(uproc_idmap *map);
 uproc_family uproc_idmap_family(uproc_idmap *map, const char *name);
 
 
+/** Add a family name
+ *
+ * Like uproc_idmap_family(), but without looking for \c name first, which
+ * is only correct if it is known not to be in the map yet (e.g. when
+ * restoring a map from a list of distinct names).
+ *
+ * \return
+ * Returns the new family number, or ::UPROC_FAMILY_INVALID if an error
+ * occurs or the limit was reached.
+ */
+uproc_family uproc_idmap_append(uproc_idmap *map, const char *name);
+
+
 /** Get family string
  *
  * Returns the family name associated with the family number \c family.
@@ -0,0 +1,54 @@
+/* Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/** \file uproc/numa.h
+ *
+ * Module: \ref grp_numa
+ *
+ * \weakgroup grp_numa
+ * \{
+ *
+ * On machines with several NUMA nodes (usually one per CPU socket), memory
+ * access is faster from CPUs of the node the memory belongs to. A
+ * read-mostly object like an ecurve can be copied to each node using
+ * uproc_ecurve_numa_copy(), and threads running on that node can be bound to
+ * it using uproc_numa_bind().
+ *
+ * These functions require libuproc to be built with libnuma, see
+ * uproc_features_numa().
+ */
+
+#ifndef UPROC_NUMA_H
+#define UPROC_NUMA_H
+
+
+/** Return the number of NUMA nodes
+ *
+ * Returns 0 if NUMA is not supported by libuproc or the system.
+ */
+int uproc_numa_nodes(void);
+
+
+/** Restrict the calling thread to the CPUs of a NUMA node
+ *
+ * \param node  node number, less than uproc_numa_nodes()
+ */
+int uproc_numa_bind(int node);
+
+/** \} */
+#endif
@@ -147,6 +147,24 @@ uproc_orfiter *uproc_orfiter_create(
     const double *codon_scores,
     uproc_orffilter *filter, void *filter_arg);
 
+/** Restart orfiter on another sequence
+ *
+ * Puts \c iter into the same state as if it was freshly created by
+ * uproc_orfiter_create() with the given arguments, but keeps the buffers
+ * allocated for the ORFs of the previous sequence.
+ *
+ * ORFs previously obtained from uproc_orfiter_next() are invalidated.
+ *
+ * \param iter          orfiter instance
+ * \param seq           sequence to iterate over
+ * \param codon_scores  codon scores, see uproc_orfiter_create()
+ * \param filter        filter function
+ * \param filter_arg    additional argument to \c filter
+ */
+void uproc_orfiter_reset(uproc_orfiter *iter, const char *seq,
+                         const double *codon_scores,
+                         uproc_orffilter *filter, void *filter_arg);
+
 /** Destroy orfiter object */
 void uproc_orfiter_destroy(uproc_orfiter *iter);
 
@@ -32,6 +32,7 @@
 
 
 #include "uproc/common.h"
+#include "uproc/classify.h"
 #include "uproc/ecurve.h"
 #include "uproc/substmat.h"
 #include "uproc/list.h"
@@ -72,6 +73,60 @@ int uproc_protresult_copy(struct uproc_protresult *dest,
 
 
 
+/** \defgroup obj_protmemo object uproc_protmemo
+ *
+ * Memo of protein classification results
+ *
+ * Amplicon and high-coverage data contain many identical reads (and DNA
+ * reads many identical ORFs). A memo stores the results of classified
+ * sequences, keyed by the sequence and the settings of the classifier, so
+ * that a classifier using it (see uproc_protclass_set_memo()) doesn't need
+ * to classify a sequence again. When its memory limit is reached, the least recently used
+ * sequences are dropped.
+ *
+ * A memo can be used by multiple threads at the same time. It is divided
+ * into independently locked shards, so threads rarely wait for each
+ * other.
+ *
+ * \{
+ */
+
+/** \struct uproc_protmemo
+ * \copybrief obj_protmemo
+ *
+ * See \ref obj_protmemo for details.
+ */
+typedef struct uproc_protmemo_s uproc_protmemo;
+
+
+/** Create memo
+ *
+ * \param size      approximate memory limit in bytes (each sequence takes
+ *                  about 64 bytes plus its length plus 16 bytes per result)
+ */
+uproc_protmemo *uproc_protmemo_create(size_t size);
+
+
+/** Destroy memo */
+void uproc_protmemo_destroy(uproc_protmemo *memo);
+
+
+/** Memo statistics
+ *
+ * Reports how many sequences were looked up in \c memo and how many of
+ * them were found.
+ *
+ * \param memo      memo
+ * \param lookups   _OUT_: number of lookups
+ * \param hits      _OUT_: number of lookups that found the sequence
+ */
+void uproc_protmemo_stats(const uproc_protmemo *memo,
+                          unsigned long long *lookups,
+                          unsigned long long *hits);
+/** \} */
+
+
+
 /** \defgroup obj_protclass object uproc_protclass
  *
  * Protein sequence classifier
@@ -93,7 +148,8 @@ typedef struct uproc_protclass_s uproc_protclass;
  * Used by uproc_protclass_classify() to decide whether a classification should
  * be added to the results.
  *
- * \param seq       classified sequence
+ * \param seq       classified sequence (NULL for the ORFs classified by a
+ *                  ::uproc_dnaclass)
  * \param seq_len   length of the classified sequence
  * \param family    predicted family
  * \param score     total score for this family
@@ -104,16 +160,33 @@ typedef bool uproc_protfilter(const char *seq, size_t seq_len,
                               uproc_family family, double score, void *arg);
 
 
+/** Protein threshold function type
+ *
+ * Used by uproc_protclass_classify() to skip families that can't be accepted
+ * by the filter function anyway.
+ *
+ * \param seq_len   length of the classified sequence
+ * \param arg       user-supplied argument
+ *
+ * \return A score below which the filter function rejects every family of
+ * a sequence of length \c seq_len.
+ */
+typedef double uproc_protthresh(size_t seq_len, void *arg);
+
+
 /** Classification mode
  *
  * Determines which results uproc_protclass_classify() produces.
  */
 enum uproc_protclass_mode
 {
-    /** Only the result with the maximum score */
-    UPROC_PROTCLASS_ALL,
     /** All results (unordered) */
+    UPROC_PROTCLASS_ALL,
+    /** Only the result with the maximum score */
     UPROC_PROTCLASS_MAX,
+    /** The results with the \c k highest scores, in descending order of
+     * score (see uproc_protclass_set_top_k()) */
+    UPROC_PROTCLASS_TOP_K,
 };
 
 
@@ -138,7 +211,7 @@ uproc_protclass *uproc_protclass_create(enum uproc_protclass_mode mode,
 void uproc_protclass_destroy(uproc_protclass *pc);
 
 
-/** Classify DNA sequence
+/** Classify protein sequence
  *
  * \c results should be a pointer to a \c (::uproc_list *) that is either NULL
  * (in which case a new list is created) or which has which has already been
@@ -155,6 +228,165 @@ int uproc_protclass_classify(const uproc_protclass *pc, const char *seq,
                              uproc_list **results);
 
 
+/** Classify protein sequence using a workspace
+ *
+ * Like uproc_protclass_classify(), but using the buffers of \c ctx instead
+ * of those of the calling thread.
+ *
+ * \param pc        protein classifier
+ * \param ctx       classification workspace
+ * \param seq       sequence to classify
+ * \param results   _OUT_: classification results
+ */
+int uproc_protclass_classify_ctx(const uproc_protclass *pc,
+                                 uproc_classify_ctx *ctx, const char *seq,
+                                 uproc_list **results);
+
+
+/** Classify many protein sequences at once
+ *
+ * Gives the same results as calling uproc_protclass_classify_ctx() for each
+ * of the \c n sequences, but collects the words of many sequences, sorts
+ * them and looks them up with uproc_ecurve_lookup_sorted(). This turns the
+ * random accesses to the ecurves into a sequential sweep, which pays off if
+ * they are larger than the CPU caches, and even more if they are
+ * memory-mapped and don't fit into memory.
+ *
+ * The neighbour cache (see uproc_protclass_set_cache()) is not used. How
+ * many words are sorted together is determined by the size set with
+ * uproc_protclass_set_batch().
+ *
+ * \param pc        protein classifier
+ * \param ctx       classification workspace
+ * \param seqs      sequences to classify
+ * \param n         number of sequences
+ * \param results   _OUT_: array of \c n result lists (see
+ *                  uproc_protclass_classify())
+ */
+int uproc_protclass_classify_many(const uproc_protclass *pc,
+                                  uproc_classify_ctx *ctx,
+                                  const char *const *seqs, size_t n,
+                                  uproc_list **results);
+
+
+/** Use fixed-point arithmetic for scoring
+ *
+ * If enabled, the classifier uses the distances obtained from
+ * uproc_substmat_align_suffixes_fixed() and accumulates them as integers
+ * (using SSE2 instructions if available), converting the score of each
+ * family to \c double only before it is passed to the filter function.
+ *
+ * This is faster, but every position of a sequence contributes an error of
+ * up to <tt>0.5 / s</tt> to the score, where \c s is
+ * uproc_substmat_fixed_scale(). The score of a sequence of length \c n thus
+ * differs from the one computed with \c double arithmetic by at most
+ * <tt>n * 0.5 / s</tt>, which may change the result if it is close to the
+ * threshold applied by the filter function.
+ *
+ * Disabled by default.
+ *
+ * \param pc        protein classifier
+ * \param enable    whether to use fixed-point arithmetic
+ */
+void uproc_protclass_set_fixed(uproc_protclass *pc, bool enable);
+
+
+/** Set the number of results of the ::UPROC_PROTCLASS_TOP_K mode
+ *
+ * The results are selected using a heap of size \c k, so only \c k results
+ * are kept in memory regardless of the number of families that scored above
+ * the threshold. Ties are broken in favour of the lower family.
+ *
+ * Defaults to 1.
+ *
+ * \param pc        protein classifier
+ * \param k         maximum number of results per sequence
+ */
+void uproc_protclass_set_top_k(uproc_protclass *pc, size_t k);
+
+
+/** Set threshold function for pruning
+ *
+ * Each position of a sequence adds at most uproc_substmat_max() to the
+ * score of a family. If a threshold function is installed, the classifier
+ * uses this to stop scoring a family as soon as its score can't reach the
+ * threshold anymore, and stops processing the sequence altogether when no
+ * family (including those not matched yet) can. The results are the same as
+ * without pruning, as long as \c thresh is consistent with the filter
+ * function passed to uproc_protclass_create().
+ *
+ * The largest distance of the substitution matrix is determined by
+ * uproc_protclass_create(), so the matrix must not be modified afterwards.
+ * Pruning is disabled while a tracing callback is installed.
+ *
+ * \param pc            protein classifier
+ * \param thresh        threshold function, or NULL to disable pruning
+ *                      (default)
+ * \param thresh_arg    additional argument to \c thresh
+ */
+void uproc_protclass_set_thresh(uproc_protclass *pc, uproc_protthresh *thresh,
+                                void *thresh_arg);
+
+
+/** Set size of the neighbour cache
+ *
+ * If \c size is not 0, each classification workspace (see
+ * \ref obj_classify_ctx) keeps a cache of up to \c size words (rounded down
+ * to a power of two) that were recently seen in any sequence, storing their
+ * neighbours in the ecurves and the distances to them. Words found in the
+ * cache don't need to be looked up and aligned again, which pays off for
+ * redundant input, e.g. reads of abundant organisms. Each entry takes about
+ * 200 bytes. uproc_classify_ctx_cache_stats() reports the hit rate.
+ *
+ * The cache is not used while a tracing callback is installed.
+ *
+ * Disabled (0) by default.
+ *
+ * \param pc        protein classifier
+ * \param size      number of cache entries
+ */
+void uproc_protclass_set_cache(uproc_protclass *pc, size_t size);
+
+
+/** Set size of the workspace for sorted lookups
+ *
+ * uproc_protclass_classify_many() sorts the words of as many sequences as
+ * fit into \c size bytes of the classification workspace (see
+ * \ref obj_classify_ctx) at once; each word takes about 150 bytes. Larger
+ * batches make the accesses to the ecurves more sequential, but need more
+ * memory per workspace. Sequences with more words than fit are classified
+ * one by one.
+ *
+ * 10 MiB by default.
+ *
+ * \param pc        protein classifier
+ * \param size      workspace size in bytes
+ */
+void uproc_protclass_set_batch(uproc_protclass *pc, size_t size);
+
+
+/** Set memo of classification results
+ *
+ * If \c memo is not \c NULL, the results of every classified sequence are
+ * stored in \c memo, and sequences that are already in it are not
+ * classified again (see \ref obj_protmemo). This includes the ORFs
+ * translated by a DNA classifier using \c pc.
+ *
+ * The results are stored together with the settings of \c pc (mode, top k,
+ * fixed-point arithmetic, substitution matrix and filter), so a memo can be
+ * shared by differently configured classifiers without them seeing each
+ * other's results. It doesn't distinguish between databases though, so all
+ * classifiers using \c memo must use the same ecurves or copies of them
+ * (e.g. those made for different NUMA nodes).
+ *
+ * The memo is not used while a tracing callback is installed.
+ *
+ * \param pc        protein classifier
+ * \param memo      memo to use, or \c NULL to disable memoization
+ */
+void uproc_protclass_set_memo(uproc_protclass *pc, uproc_protmemo *memo);
+
+
 /** Tracing callback type
  *
  * Additionally to the normal classification, it's possible to get information
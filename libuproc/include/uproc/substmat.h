@@ -111,6 +111,45 @@ void uproc_substmat_align_suffixes(const uproc_substmat *mat, uproc_suffix s1,
                                    uproc_suffix s2, double *dist);
 
 
+/** Largest distance
+ *
+ * Returns the largest finite distance over all positions and amino acid
+ * pairs, which is an upper bound for every element produced by
+ * uproc_substmat_align_suffixes(). Each call examines the whole matrix.
+ *
+ * \param mat   substitution matrix
+ */
+double uproc_substmat_max(const uproc_substmat *mat);
+
+
+/** Scale of the fixed-point distances
+ *
+ * The largest power of two (at most 2^16) by which all distances of \c mat
+ * can be multiplied so that the result fits into an \c int16_t. The
+ * fixed-point distances are the rounded products, so they differ from the
+ * scaled distances by at most 0.5.
+ *
+ * \param mat   substitution matrix
+ */
+double uproc_substmat_fixed_scale(const uproc_substmat *mat);
+
+
+/** Look up all fixed-point distances between amino acids in a suffix
+ *
+ * Like uproc_substmat_align_suffixes(), but yields the distances multiplied
+ * by uproc_substmat_fixed_scale(). Distances of -INFINITY (or NaN) yield
+ * \c INT16_MIN, which no finite distance does.
+ *
+ * \param mat   substitution matrix
+ * \param s1    first suffix
+ * \param s2    second suffix
+ * \param dist  _OUT_: array containing distance of each amino acid pair
+ */
+void uproc_substmat_align_suffixes_fixed(const uproc_substmat *mat,
+                                         uproc_suffix s1, uproc_suffix s2,
+                                         int16_t *dist);
+
+
 /** Load substmat from file
  *
  * \param iotype    IO type, see ::uproc_io_type
@@ -166,6 +166,19 @@ uproc_worditer *uproc_worditer_create(const char *seq,
                                       const uproc_alphabet *alpha);
 
 
+/** Restart word iterator on another sequence
+ *
+ * Puts \c iter into the same state as if it was freshly created by
+ * uproc_worditer_create(), without allocating a new object.
+ *
+ * \param iter      iterator
+ * \param seq       sequence to iterate
+ * \param alpha     translation alphabet
+ */
+void uproc_worditer_reset(uproc_worditer *iter, const char *seq,
+                          const uproc_alphabet *alpha);
+
+
 /** Obtain the next word(s) from a word iterator
  *
  * Invalid characters are not simply skipped, instead the first complete word
@@ -182,6 +195,33 @@ int uproc_worditer_next(uproc_worditer *iter, size_t *index,
 
 /** Destroy worditer object */
 void uproc_worditer_destroy(uproc_worditer *iter);
+
+
+/** Obtain many words of a translated sequence at once
+ *
+ * Produces the same words as a ::uproc_worditer, but from a sequence that
+ * was already translated with uproc_alphabet_translate(), and up to \c n
+ * of them per call. Invalid amino acids (-1) are treated like invalid
+ * characters by the iterator.
+ *
+ * The first call for a sequence should pass \c *pos = 0. \c *pos is
+ * advanced so that the next call continues after the last word returned.
+ *
+ * \param aminos    translated sequence
+ * \param len       length of the sequence
+ * \param pos       _IN/OUT_: position to continue at
+ * \param n         maximum number of words
+ * \param index     _OUT_: array of \c n starting indices
+ * \param fwd       _OUT_: array of \c n words in order as they appeared
+ * \param rev       _OUT_: array of \c n words in reversed order
+ *
+ * \return
+ * Number of words stored, 0 if the end of the sequence was reached.
+ */
+size_t uproc_words_from_sequence(const uproc_amino *aminos, size_t len,
+                                 size_t *pos, size_t n, size_t *index,
+                                 struct uproc_word *fwd,
+                                 struct uproc_word *rev);
 /** \} */
 
 /**
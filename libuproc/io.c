@@ -37,8 +37,14 @@
 #include "uproc/error.h"
 #include "uproc/io.h"
 
+#include "io_internal.h"
+
 #define GZIP_BUFSZ (512 * (1 << 10))
 
+/* gzread() and gzwrite() take the length as `unsigned` and return it as
+ * `int`, so larger requests are split into chunks of at most 1 GiB */
+#define GZIP_CHUNK(n) ((n) < (1UL << 30) ? (unsigned) (n) : (1U << 30))
+
 struct uproc_io_stream
 {
     enum uproc_io_type type;
@@ -198,6 +204,26 @@ error:
     return NULL;
 }
 
+char *
+io_vformat(const char *fmt, va_list ap)
+{
+    char *buf;
+    size_t n;
+    va_list aq;
+
+    va_copy(aq, ap);
+    n = vsnprintf(NULL, 0, fmt, aq);
+    va_end(aq);
+
+    buf = malloc(n + 1);
+    if (!buf) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
+    }
+    vsprintf(buf, fmt, ap);
+    return buf;
+}
+
 uproc_io_stream *
 uproc_io_open(const char *mode, enum uproc_io_type type, const char *pathfmt,
               ...)
@@ -215,20 +241,10 @@ uproc_io_openv(const char *mode, enum uproc_io_type type, const char *pathfmt,
                va_list ap)
 {
     uproc_io_stream *stream;
-    char *buf;
-    size_t n;
-    va_list aq;
-
-    va_copy(aq, ap);
-    n = vsnprintf(NULL, 0, pathfmt, aq);
-    va_end(aq);
-
-    buf = malloc(n + 1);
+    char *buf = io_vformat(pathfmt, ap);
     if (!buf) {
         return NULL;
     }
-    vsprintf(buf, pathfmt, ap);
-
     stream = io_open(buf, mode, type);
     free(buf);
     return stream;
@@ -304,14 +320,16 @@ uproc_io_read(void *ptr, size_t size, size_t nmemb, uproc_io_stream *stream)
         case UPROC_IO_GZIP:
 #if HAVE_ZLIB_H
             {
-                size_t i, n;
-                for (i = 0; i < nmemb; i++) {
-                    n = gzread(stream->s.gz, (char*)ptr + i * size, size);
-                    if (n != size) {
+                size_t total = size * nmemb, done = 0;
+                while (done < total) {
+                    int n = gzread(stream->s.gz, (char*)ptr + done,
+                                   GZIP_CHUNK(total - done));
+                    if (n <= 0) {
                         break;
                     }
+                    done += n;
                 }
-                return i;
+                return size ? done / size : 0;
             }
 #endif
         case UPROC_IO_STDIO:
@@ -329,14 +347,16 @@ uproc_io_write(const void *ptr, size_t size, size_t nmemb,
         case UPROC_IO_GZIP:
 #if HAVE_ZLIB_H
             {
-                size_t i, n;
-                for (i = 0; i < nmemb; i++) {
-                    n = gzwrite(stream->s.gz, (char*)ptr + i * size, size);
-                    if (n != size) {
+                size_t total = size * nmemb, done = 0;
+                while (done < total) {
+                    int n = gzwrite(stream->s.gz, (char*)ptr + done,
+                                    GZIP_CHUNK(total - done));
+                    if (n <= 0) {
                         break;
                     }
+                    done += n;
                 }
-                return i;
+                return size ? done / size : 0;
             }
 #endif
         case UPROC_IO_STDIO:
@@ -0,0 +1,10 @@
+#ifndef UPROC_IO_INTERNAL_H
+#define UPROC_IO_INTERNAL_H
+
+#include <stdarg.h>
+
+/* Format a path or name into a newly allocated string, which the caller has
+ * to free() */
+char *io_vformat(const char *fmt, va_list ap);
+
+#endif
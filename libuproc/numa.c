@@ -0,0 +1,61 @@
+/* NUMA node information and thread placement
+ *
+ * Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#if HAVE_LIBNUMA
+#include <numa.h>
+#endif
+
+#include "uproc/error.h"
+#include "uproc/numa.h"
+
+int
+uproc_numa_nodes(void)
+{
+#if HAVE_LIBNUMA
+    if (numa_available() < 0) {
+        return 0;
+    }
+    return numa_max_node() + 1;
+#else
+    return 0;
+#endif
+}
+
+int
+uproc_numa_bind(int node)
+{
+#if HAVE_LIBNUMA
+    if (node < 0 || node >= uproc_numa_nodes()) {
+        return uproc_error_msg(UPROC_EINVAL, "invalid NUMA node %d", node);
+    }
+    if (numa_run_on_node(node)) {
+        return uproc_error_msg(UPROC_ERRNO, "failed to bind to NUMA node %d",
+                               node);
+    }
+    return 0;
+#else
+    (void) node;
+    return uproc_error_msg(UPROC_ENOTSUP, "NUMA is not supported");
+#endif
+}
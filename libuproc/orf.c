@@ -27,8 +27,8 @@
 #include <string.h>
 #include <stdbool.h>
 #include <limits.h>
-#include <ctype.h>
 
+#include "uproc/alphabet.h"
 #include "uproc/common.h"
 #include "uproc/error.h"
 #include "uproc/codon.h"
@@ -36,11 +36,11 @@
 #include "uproc/orf.h"
 #include "uproc/io.h"
 
+#include "classify_internal.h"
 #include "codon_tables.h"
 
 #define FRAMES (UPROC_ORF_FRAMES / 2)
 #define BUFSZ_INIT 2
-#define BUFSZ_STEP 50
 
 struct uproc_orfiter_s
 {
@@ -71,35 +71,30 @@ struct uproc_orfiter_s
     /** Current frame */
     unsigned frame;
 
-    /** Current forward codons */
-    uproc_codon codon[UPROC_ORF_FRAMES / 2];
+    /** Last three nucleotides (the current codon of every forward frame) */
+    uproc_codon codon;
 
-    /** ORFs to "work with" */
+    /** ORFs to "work with"
+     *
+     * ORFs on the complementary strand are built back to front, ending at the
+     * last byte of their buffer. */
     struct uproc_orf orf[UPROC_ORF_FRAMES];
 
-    /** Sizes of the corresponding orf.data buffers */
-    size_t data_sz[UPROC_ORF_FRAMES];
+    /** Size of each of the orf.data buffers */
+    size_t data_sz;
 
     /** Indicate whether an ORF was completed and should be returned next */
     bool yield[UPROC_ORF_FRAMES];
-};
 
-static void
-reverse_str(char *s)
-{
-    char tmp, *p;
-    size_t len = strlen(s);
+    /** Byte stored in the ORF buffers for each amino acid character
+     *
+     * The identity, unless the ORFs are yielded as amino acid codes (see
+     * orfiter_reset_aminos()). */
+    unsigned char code[UCHAR_MAX + 1];
 
-    if (!len) {
-        return;
-    }
-
-    for (p = s + len - 1; s < p; s++, p--) {
-        tmp = *s;
-        *s = *p;
-        *p = tmp;
-    }
-}
+    /** Alphabet the #code table was built for, empty for the identity */
+    char code_alphabet[UPROC_ALPHABET_SIZE + 1];
+};
 
 static uproc_codon
 scoreindex_to_codon(int idx)
@@ -113,23 +108,72 @@ scoreindex_to_codon(int idx)
     return c;
 }
 
+/* Append amino acid to a forward ORF */
+static void
+orf_append(struct uproc_orf *o, const unsigned char *code, int c,
+           double score)
+{
+    if (!o->length && c == 'X') {
+        return;
+    }
+    o->data[o->length++] = code[c];
+    o->score += score;
+}
+
+/* Prepend amino acid to an ORF on the complementary strand */
+static void
+orf_prepend(struct uproc_orf *o, size_t sz, const unsigned char *code, int c,
+            double score)
+{
+    if (!o->length && c == 'X') {
+        return;
+    }
+    o->data[sz - 2 - o->length++] = code[c];
+    o->score += score;
+}
+
+/* Build the #code table for `alpha` (or the identity if it is NULL), unless
+ * it is already up to date */
+static void
+orfiter_codes(struct uproc_orfiter_s *iter, const uproc_alphabet *alpha)
+{
+    const char *str = alpha ? uproc_alphabet_str(alpha) : "";
+    if (!strcmp(str, iter->code_alphabet)) {
+        return;
+    }
+    for (unsigned i = 0; i <= UCHAR_MAX; i++) {
+        iter->code[i] = i;
+    }
+    for (unsigned i = 0; str[i]; i++) {
+        iter->code[(unsigned char)str[i]] = i;
+    }
+    strcpy(iter->code_alphabet, str);
+}
+
+/* Grow the ORF buffers so that they can hold every ORF of the sequence.
+ *
+ * A frame has at most one amino acid per three nucleotides plus the guessed
+ * one at the end of the sequence, so uproc_orfiter_next() never needs to
+ * check the buffer size. */
 static int
-orf_add_codon(struct uproc_orf *o, size_t *sz, uproc_codon c, double score)
+orfiter_reserve(struct uproc_orfiter_s *iter)
 {
-    if (!o->length && CODON_TO_CHAR(c) == 'X') {
+    size_t sz = iter->seq_len / UPROC_CODON_NTS + 2;
+    if (sz <= iter->data_sz) {
         return 0;
     }
-    if (o->length + 1 == *sz) {
-        char *tmp = realloc(o->data, *sz + BUFSZ_STEP);
+    if (sz < 2 * iter->data_sz) {
+        sz = 2 * iter->data_sz;
+    }
+    for (unsigned i = 0; i < UPROC_ORF_FRAMES; i++) {
+        char *tmp = realloc(iter->orf[i].data, sz);
         if (!tmp) {
             return uproc_error(UPROC_ENOMEM);
         }
-        o->data = tmp;
-        *sz += BUFSZ_STEP;
+        iter->orf[i].data = tmp;
+        iter->orf[i].data[sz - 1] = '\0';
     }
-    o->data[o->length] = CODON_TO_CHAR(c);
-    o->length++;
-    o->score += score;
+    iter->data_sz = sz;
     return 0;
 }
 
@@ -141,11 +185,15 @@ gc_content(const char *seq, size_t *len, double *gc)
         ['R'] = .5,   ['Y'] = .5,   ['S'] = 1,    ['K'] = .5,   ['M'] = .5,
         ['B'] = .667, ['D'] = .333, ['H'] = .333, ['V'] = .667,
         ['N'] = .25,
+        ['g'] = 1,    ['c'] = 1,
+        ['r'] = .5,   ['y'] = .5,   ['s'] = 1,    ['k'] = .5,   ['m'] = .5,
+        ['b'] = .667, ['d'] = .333, ['h'] = .333, ['v'] = .667,
+        ['n'] = .25,
     };
     size_t i;
     double count = 0.0;
     for (i = 0; seq[i]; i++) {
-        count += gc_map[toupper(seq[i])];
+        count += gc_map[(unsigned char)seq[i]];
     }
     *gc = count / i;
     *len = i;
@@ -212,16 +260,9 @@ uproc_orfiter_create(
         uproc_error(UPROC_ENOMEM);
         return NULL;
     }
-    *iter = (struct uproc_orfiter_s) {
-            .seq = seq,
-            .pos = seq,
-            .filter = filter,
-            .filter_arg = filter_arg,
-    };
-    gc_content(seq, &iter->seq_len, &iter->seq_gc);
 
+    iter->data_sz = BUFSZ_INIT;
     for (i = 0; i < UPROC_ORF_FRAMES; i++) {
-        iter->data_sz[i] = BUFSZ_INIT;
         iter->orf[i].data = malloc(BUFSZ_INIT);
         if (!iter->orf[i].data) {
             while (i--) {
@@ -231,11 +272,47 @@ uproc_orfiter_create(
             uproc_error(UPROC_ENOMEM);
             return NULL;
         }
+        iter->orf[i].data[BUFSZ_INIT - 1] = '\0';
+    }
+    /* force building the identity table */
+    iter->code_alphabet[0] = '-';
+    iter->code_alphabet[1] = '\0';
+    uproc_orfiter_reset(iter, seq, codon_scores, filter, filter_arg);
+    return iter;
+}
+
+void
+uproc_orfiter_reset(uproc_orfiter *iter, const char *seq,
+                    const double *codon_scores,
+                    uproc_orffilter *filter, void *filter_arg)
+{
+    orfiter_reset_aminos(iter, seq, codon_scores, filter, filter_arg, NULL);
+}
+
+void
+orfiter_reset_aminos(uproc_orfiter *iter, const char *seq,
+                     const double *codon_scores,
+                     uproc_orffilter *filter, void *filter_arg,
+                     const uproc_alphabet *alpha)
+{
+    orfiter_codes(iter, alpha);
+    iter->seq = seq;
+    iter->pos = seq;
+    iter->filter = filter;
+    iter->filter_arg = filter_arg;
+    iter->codon_scores = codon_scores;
+    iter->nt_count = 0;
+    iter->frame = 0;
+    iter->codon = 0;
+    gc_content(seq, &iter->seq_len, &iter->seq_gc);
+
+    for (unsigned i = 0; i < UPROC_ORF_FRAMES; i++) {
+        iter->orf[i].length = 0;
+        iter->orf[i].score = 0.0;
         iter->orf[i].frame = i;
         iter->orf[i].start = i % FRAMES;
+        iter->yield[i] = false;
     }
-    iter->codon_scores = codon_scores;
-    return iter;
 }
 
 void
@@ -257,8 +334,19 @@ uproc_orfiter_next(uproc_orfiter *iter, struct uproc_orf *next)
     unsigned i;
     uproc_nt nt;
     uproc_codon c_fwd, c_rev;
+    const double *scores = iter->codon_scores;
+    const unsigned char *code = iter->code;
+    const char wildcard = code['X'];
+
+    /* `seq_len` doesn't change after uproc_orfiter_reset(), so this only
+     * grows the (still empty) buffers on the first call */
+    if (orfiter_reserve(iter)) {
+        return -1;
+    }
 
     while (true) {
+        bool completed = false;
+
         /* yield finished ORFs */
         for (i = 0; i < UPROC_ORF_FRAMES; i++) {
             if (!iter->yield[i]) {
@@ -273,23 +361,37 @@ uproc_orfiter_next(uproc_orfiter *iter, struct uproc_orf *next)
             iter->orf[i].start = iter->pos - iter->seq;
             iter->yield[i] = false;
 
-            /* chop trailing wildcard aminoacids */
-            while (next->length && next->data[next->length - 1] == 'X') {
-                next->length--;
+            if (i < FRAMES) {
+                /* chop trailing wildcard aminoacids */
+                while (next->length &&
+                       next->data[next->length - 1] == wildcard) {
+                    next->length--;
+                }
+                next->data[next->length] = '\0';
+            }
+            else {
+                /* the ORF ends at the end of the buffer, chop the most
+                 * recently prepended wildcards */
+                next->data += iter->data_sz - 1 - next->length;
+                while (next->length && *next->data == wildcard) {
+                    next->data++;
+                    next->length--;
+                }
             }
             if (!next->length) {
                 continue;
             }
-            next->data[next->length] = '\0';
-            /* revert ORF on complementery strand */
-            if (i >= FRAMES) {
-                reverse_str(next->data);
-            }
 
-            if (iter->filter && !iter->filter(next, iter->seq, iter->seq_len,
-                                              iter->seq_gc, iter->filter_arg))
-            {
-                continue;
+            if (iter->filter) {
+                /* amino acid codes aren't for the user's eyes */
+                struct uproc_orf orf = *next;
+                if (iter->code_alphabet[0]) {
+                    orf.data = NULL;
+                }
+                if (!iter->filter(&orf, iter->seq, iter->seq_len,
+                                  iter->seq_gc, iter->filter_arg)) {
+                    continue;
+                }
             }
             return 0;
         }
@@ -309,8 +411,11 @@ uproc_orfiter_next(uproc_orfiter *iter, struct uproc_orf *next)
             continue;
         }
 
-        /* process sequence */
-        if (*iter->pos) {
+        /* process sequence until an ORF is completed */
+        while (*iter->pos && !completed) {
+            unsigned frame;
+            int t;
+
             nt = CHAR_TO_NT(*iter->pos++);
             if (nt == UPROC_NT_NOT_CHAR) {
                 continue;
@@ -319,53 +424,52 @@ uproc_orfiter_next(uproc_orfiter *iter, struct uproc_orf *next)
                 nt = CHAR_TO_NT('N');
             }
             iter->nt_count++;
-            iter->frame = (iter->frame + 1) % FRAMES;
-
-            for (i = 0; i < FRAMES; i++) {
-                uproc_codon_append(&iter->codon[i], nt);
+            if (++iter->frame == FRAMES) {
+                iter->frame = 0;
             }
+            uproc_codon_append(&iter->codon, nt);
 
             /* skip partially read codons */
             if (iter->nt_count < FRAMES) {
                 continue;
             }
 
-#define ADD_CODON(codon, frame) do {                                        \
-    int res = orf_add_codon(                                                \
-        &iter->orf[(frame)], &iter->data_sz[(frame)], codon,                \
-        iter->codon_scores ? iter->codon_scores[codon] : 0.0);              \
-    if (res == -1) {                                                        \
-        return -1;                                                          \
-    }                                                                       \
-} while (0)
-
-            c_fwd = iter->codon[iter->frame];
-            if (CODON_IS_STOP(c_fwd)) {
-                iter->yield[iter->frame] = true;
+            frame = iter->frame;
+            c_fwd = iter->codon;
+            t = CODON_TRANSLATION(c_fwd);
+            if (TRANSLATION_IS_STOP(t)) {
+                iter->yield[frame] = completed = true;
             }
             else {
-                ADD_CODON(c_fwd, iter->frame);
+                orf_append(&iter->orf[frame], code, TRANSLATION_CHAR(t),
+                           scores ? scores[c_fwd] : 0.0);
             }
 
-            c_rev = CODON_COMPLEMENT(c_fwd);
-            if (CODON_IS_STOP(c_rev)) {
-                iter->yield[iter->frame + FRAMES] = true;
+            c_rev = TRANSLATION_COMPLEMENT(t);
+            if (TRANSLATION_COMPLEMENT_IS_STOP(t)) {
+                iter->yield[frame + FRAMES] = completed = true;
             }
             else {
-                ADD_CODON(c_rev, iter->frame + FRAMES);
+                orf_prepend(&iter->orf[frame + FRAMES], iter->data_sz, code,
+                            TRANSLATION_COMPLEMENT_CHAR(t),
+                            scores ? scores[c_rev] : 0.0);
             }
         }
-        else {
+
+        if (!completed) {
             /* guess last nt for the next frame */
             unsigned frame = (iter->nt_count + 1) % FRAMES;
-            c_fwd = iter->codon[frame];
+            c_fwd = iter->codon;
             uproc_codon_append(&c_fwd, UPROC_NT_N);
             c_rev = CODON_COMPLEMENT(c_fwd);
             if (!CODON_IS_STOP(c_fwd) && CODON_TO_CHAR(c_fwd) != 'X') {
-                ADD_CODON(c_fwd, frame);
+                orf_append(&iter->orf[frame], code, CODON_TO_CHAR(c_fwd),
+                           scores ? scores[c_fwd] : 0.0);
             }
             if (!CODON_IS_STOP(c_rev) && CODON_TO_CHAR(c_rev) != 'X') {
-                ADD_CODON(c_rev, frame + FRAMES);
+                orf_prepend(&iter->orf[frame + FRAMES], iter->data_sz, code,
+                            CODON_TO_CHAR(c_rev),
+                            scores ? scores[c_rev] : 0.0);
             }
 
             /* "signal" that the end of the sequence was reached */
@@ -23,252 +23,1322 @@
 #endif
 
 #include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 
+#if __SSE2__
+#include <emmintrin.h>
+#endif
+
 #include "uproc/common.h"
 #include "uproc/error.h"
-#include "uproc/bst.h"
 #include "uproc/list.h"
 #include "uproc/protclass.h"
+#include "classify_internal.h"
+
+struct uproc_protclass_s
+{
+    enum uproc_protclass_mode mode;
+    const uproc_substmat *substmat;
+    const uproc_ecurve *fwd;
+    const uproc_ecurve *rev;
+    uproc_protfilter *filter;
+    void *filter_arg;
+    bool fixed;
+    size_t top_k;
+    uproc_protthresh *thresh;
+    void *thresh_arg;
+    double dist_max;
+    /* identifies the classifier in neighbour caches */
+    unsigned long id;
+    size_t cache_size;
+    size_t batch_size;
+    uproc_protmemo *memo;
+    struct uproc_protclass_trace
+    {
+        uproc_protclass_trace_cb *cb;
+        void *cb_arg;
+    } trace;
+};
+
+/*********************
+ * score computation *
+ *********************/
+
+/* Scores of a family
+ *
+ * `dist` holds the maximum distance of each position in the window of
+ * UPROC_WORD_LEN positions starting at `index`. All following elements are
+ * always -INFINITY, so that moving the window by `diff` positions is just
+ * reading from `dist + diff`. */
+struct sc
+{
+    size_t index;
+    double total, dist[2 * UPROC_WORD_LEN];
+};
+
+static void
+sc_init(struct sc *s)
+{
+    size_t i;
+    s->index = -1;
+    s->total = 0.0;
+    for (i = 0; i < 2 * UPROC_WORD_LEN; i++) {
+        s->dist[i] = -INFINITY;
+    }
+}
+
+/* Add the distances of one word; inlined with constant `reverse`, so that
+ * both orientations get their own loops without branches */
+static inline void
+sc_add_word(struct sc *score, size_t index,
+            const double dist[static UPROC_SUFFIX_LEN], const bool reverse)
+{
+    size_t i, diff = 0;
+    double tmp[UPROC_WORD_LEN];
+
+    /* the prefix has no distances; in reverse words it comes last */
+    for (i = 0; i < UPROC_WORD_LEN; i++) {
+        tmp[i] = -INFINITY;
+    }
+    for (i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        if (reverse) {
+            tmp[UPROC_SUFFIX_LEN - i - 1] = dist[i];
+        }
+        else {
+            tmp[UPROC_PREFIX_LEN + i] = dist[i];
+        }
+    }
+
+    if (score->index != (size_t) -1) {
+        diff = index - score->index;
+        if (diff > UPROC_WORD_LEN) {
+            diff = UPROC_WORD_LEN;
+        }
+        /* positions that leave the window; adding 0.0 instead of skipping
+         * -INFINITY doesn't change the total */
+        for (i = 0; i < diff; i++) {
+            double d = score->dist[i];
+            score->total += d > -INFINITY ? d : 0.0;
+        }
+    }
+
+    for (i = 0; i < UPROC_WORD_LEN; i++) {
+        double d = score->dist[i + diff];
+        score->dist[i] = d > tmp[i] ? d : tmp[i];
+    }
+    score->index = index;
+}
+
+static void
+sc_add(struct sc *score, size_t index,
+       const double dist[static UPROC_SUFFIX_LEN], bool reverse)
+{
+    if (reverse) {
+        sc_add_word(score, index, dist, true);
+    }
+    else {
+        sc_add_word(score, index, dist, false);
+    }
+}
+
+static double
+sc_finalize(struct sc *score)
+{
+    size_t i;
+    for (i = 0; i < UPROC_WORD_LEN; i++) {
+        double d = score->dist[i];
+        score->total += d > -INFINITY ? d : 0.0;
+    }
+    return score->total;
+}
+
+
+/* Fixed-point version of `struct sc`, used if `pc->fixed` is set
+ *
+ * The window occupies the first UPROC_WORD_LEN elements of `dist`. All
+ * following elements are always QSC_NONE, so that moving the window by
+ * `diff` positions is just reading from `dist + diff`. Distances of
+ * -INFINITY are QSC_NONE as well, so they are skipped just like in `struct
+ * sc`. */
+#define QSC_NONE INT16_MIN
+
+/* UPROC_WORD_LEN rounded up to a multiple of 8 (the number of int16_t in an
+ * SSE register) */
+#define QSC_LANES 24
+
+struct qsc
+{
+    size_t index;
+    int64_t total;
+    int16_t dist[2 * QSC_LANES];
+};
+
+static void
+qsc_init(struct qsc *s)
+{
+    s->index = -1;
+    s->total = 0;
+    for (size_t i = 0; i < 2 * QSC_LANES; i++) {
+        s->dist[i] = QSC_NONE;
+    }
+}
+
+/* Sum of the first `n` elements of `dist` that are not QSC_NONE */
+static int64_t
+qsc_sum(const int16_t *dist, size_t n)
+{
+#if __SSE2__
+    const __m128i none = _mm_set1_epi16(QSC_NONE), ones = _mm_set1_epi16(1),
+          count = _mm_set1_epi16(n), step = _mm_set1_epi16(8);
+    __m128i sum = _mm_setzero_si128(),
+            idx = _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7);
+    for (size_t i = 0; i < QSC_LANES; i += 8) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dist + i));
+        __m128i mask = _mm_and_si128(_mm_cmplt_epi16(idx, count),
+                                     _mm_cmpgt_epi16(d, none));
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(_mm_and_si128(d, mask), ones));
+        idx = _mm_add_epi16(idx, step);
+    }
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+#else
+    int64_t sum = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (dist[i] != QSC_NONE) {
+            sum += dist[i];
+        }
+    }
+    return sum;
+#endif
+}
+
+/* Like sc_add(), but `tmp` already contains the distances of the whole word
+ * (in reversed order if needed) */
+static void
+qsc_add(struct qsc *score, size_t index, const int16_t tmp[static QSC_LANES])
+{
+    size_t diff = 0;
+
+    if (score->index != (size_t) -1) {
+        diff = index - score->index;
+        if (diff > UPROC_WORD_LEN) {
+            diff = UPROC_WORD_LEN;
+        }
+        score->total += qsc_sum(score->dist, diff);
+    }
+
+#if __SSE2__
+    __m128i d[QSC_LANES / 8];
+    for (size_t i = 0; i < QSC_LANES / 8; i++) {
+        d[i] = _mm_max_epi16(
+            _mm_loadu_si128((const __m128i *)(score->dist + diff + 8 * i)),
+            _mm_loadu_si128((const __m128i *)(tmp + 8 * i)));
+    }
+    for (size_t i = 0; i < QSC_LANES / 8; i++) {
+        _mm_storeu_si128((__m128i *)(score->dist + 8 * i), d[i]);
+    }
+#else
+    for (size_t i = 0; i < UPROC_WORD_LEN; i++) {
+        int16_t d = score->dist[i + diff];
+        score->dist[i] = d > tmp[i] ? d : tmp[i];
+    }
+#endif
+    score->index = index;
+}
+
+static double
+qsc_finalize(struct qsc *score, double scale)
+{
+    score->total += qsc_sum(score->dist, UPROC_WORD_LEN);
+    return score->total / scale;
+}
+
+/* Fixed-point distances of the word, laid out like `tmp` in sc_add() */
+static void
+qsc_align(const uproc_substmat *substmat, uproc_suffix s1, uproc_suffix s2,
+          bool reverse, int16_t tmp[static QSC_LANES])
+{
+    int16_t dist[UPROC_SUFFIX_LEN];
+    uproc_substmat_align_suffixes_fixed(substmat, s1, s2, dist);
+    for (size_t i = 0; i < QSC_LANES; i++) {
+        tmp[i] = QSC_NONE;
+    }
+    for (size_t i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        if (reverse) {
+            tmp[UPROC_SUFFIX_LEN - i - 1] = dist[i];
+        }
+        else {
+            tmp[UPROC_PREFIX_LEN + i] = dist[i];
+        }
+    }
+}
+
+/* Scores of the families hit by the words of a sequence, part of the
+ * classification workspace
+ *
+ * `slot[f]` is 0 if family `f` wasn't hit yet, otherwise one more than the
+ * index of its entry in `entries`. Only the slots of the hit families are
+ * cleared by scoretab_reset(), so a table can be reused for every sequence
+ * without ever touching all of `slot` again. */
+struct scoretab
+{
+    uproc_family slot[UPROC_FAMILY_MAX + 1];
+    size_t n, alloc;
+
+    /* Families whose score can't reach `min` anymore are "pruned", i.e. not
+     * scored any further. Each position of the sequence can add at most
+     * `step` to a score, so the final score of a family is bounded by its
+     * total plus `step` times the number of positions at and after its
+     * window. */
+    struct prune
+    {
+        bool enabled;
+        double min, step;
+        /* uproc_substmat_fixed_scale(), if fixed-point scores are used */
+        double scale;
+        size_t seq_len;
+        /* number of entries that aren't pruned */
+        size_t live;
+    } prune;
+
+    struct scoretab_entry
+    {
+        uproc_family family;
+        bool pruned;
+        union
+        {
+            struct sc sc;
+            struct qsc qsc;
+        } u;
+    } *entries;
+};
+
+static struct scoretab *
+scoretab_get(struct uproc_classify_ctx_s *ctx)
+{
+    if (!ctx->scores) {
+        ctx->scores = calloc(1, sizeof *ctx->scores);
+        if (!ctx->scores) {
+            uproc_error(UPROC_ENOMEM);
+        }
+    }
+    return ctx->scores;
+}
+
+static void
+scoretab_reset(struct scoretab *tab)
+{
+    for (size_t i = 0; i < tab->n; i++) {
+        tab->slot[tab->entries[i].family] = 0;
+    }
+    tab->n = 0;
+    tab->prune.live = 0;
+}
+
+static int
+scoretab_cmp(const void *p1, const void *p2)
+{
+    const struct scoretab_entry *e1 = p1, *e2 = p2;
+    return (e1->family > e2->family) - (e1->family < e2->family);
+}
+
+/* Get the entry of `family`, adding it if it doesn't exist yet */
+static struct scoretab_entry *
+scoretab_lookup(struct scoretab *scores, uproc_family family, bool fixed)
+{
+    struct scoretab_entry *e;
+    uproc_family slot = scores->slot[family];
+
+    if (slot) {
+        return &scores->entries[slot - 1];
+    }
+    if (scores->n == scores->alloc) {
+        size_t alloc = scores->alloc ? scores->alloc * 2 : 64;
+        void *tmp = realloc(scores->entries, alloc * sizeof *scores->entries);
+        if (!tmp) {
+            uproc_error(UPROC_ENOMEM);
+            return NULL;
+        }
+        scores->entries = tmp;
+        scores->alloc = alloc;
+    }
+    e = &scores->entries[scores->n];
+    e->family = family;
+    e->pruned = false;
+    scores->prune.live++;
+    if (fixed) {
+        qsc_init(&e->u.qsc);
+    }
+    else {
+        sc_init(&e->u.sc);
+    }
+    scores->slot[family] = ++scores->n;
+    return e;
+}
+
+/* Upper bound for what one position adds to the score of a family */
+static double
+score_step(const struct uproc_protclass_s *pc)
+{
+    /* positions without any distance don't count, so they add 0 */
+    double step = pc->dist_max > 0.0 ? pc->dist_max : 0.0;
+    if (pc->fixed) {
+        /* rounding error of the fixed-point distances */
+        step += 0.5 / uproc_substmat_fixed_scale(pc->substmat);
+    }
+    return step;
+}
+
+double
+protclass_score_max(const struct uproc_protclass_s *pc, size_t seq_len)
+{
+    /* not a single word */
+    if (seq_len < UPROC_WORD_LEN) {
+        return -INFINITY;
+    }
+    /* UPROC_EPSILON absorbs rounding errors of the summation of the actual
+     * score */
+    return score_step(pc) * seq_len + UPROC_EPSILON;
+}
+
+/* Prepare pruning for a sequence of length `seq_len` */
+static void
+scores_prune_init(const struct uproc_protclass_s *pc, struct scoretab *scores,
+                  size_t seq_len)
+{
+    struct prune *p = &scores->prune;
+
+    /* tracing needs to see all words */
+    p->enabled = pc->thresh && !pc->trace.cb;
+    if (!p->enabled) {
+        return;
+    }
+    p->seq_len = seq_len;
+    p->min = pc->thresh(seq_len, pc->thresh_arg);
+    p->step = score_step(pc);
+    if (pc->fixed) {
+        p->scale = uproc_substmat_fixed_scale(pc->substmat);
+    }
+}
+
+/* Whether the family of `e` can't reach the threshold anymore, given that
+ * all words before `index` have been added. */
+static bool
+scores_prunable(const struct uproc_protclass_s *pc,
+                const struct scoretab *scores,
+                const struct scoretab_entry *e, size_t index)
+{
+    const struct prune *p = &scores->prune;
+    double total;
+    size_t e_index;
+
+    if (pc->fixed) {
+        total = e->u.qsc.total / p->scale;
+        e_index = e->u.qsc.index;
+    }
+    else {
+        total = e->u.sc.total;
+        e_index = e->u.sc.index;
+    }
+    if (e_index == (size_t) -1) {
+        e_index = index;
+    }
+    /* UPROC_EPSILON absorbs rounding errors of the (differently ordered)
+     * summation of the actual score */
+    return total + p->step * (p->seq_len - e_index) + UPROC_EPSILON < p->min;
+}
+
+/* Prune all families that can't reach the threshold anymore. Returns true if
+ * no family can, including those that haven't been seen yet. */
+static bool
+scores_prune(const struct uproc_protclass_s *pc, struct scoretab *scores,
+             size_t index)
+{
+    struct prune *p = &scores->prune;
+
+    if (p->step * (p->seq_len - index) + UPROC_EPSILON >= p->min) {
+        return false;
+    }
+    for (size_t i = 0; p->live && i < scores->n; i++) {
+        struct scoretab_entry *e = &scores->entries[i];
+        if (!e->pruned && scores_prunable(pc, scores, e, index)) {
+            e->pruned = true;
+            p->live--;
+        }
+    }
+    return !p->live;
+}
+
+/* Distances between a word and one of its neighbours, as passed to sc_add()
+ * or qsc_add() */
+union nbdist
+{
+    double dist[UPROC_SUFFIX_LEN];
+    int16_t fixed[QSC_LANES];
+};
+
+static void
+nbdist_align(const struct uproc_protclass_s *pc, const struct uproc_word *word,
+             const struct uproc_word *nb, bool reverse, union nbdist *d)
+{
+    if (pc->fixed) {
+        qsc_align(pc->substmat, word->suffix, nb->suffix, reverse, d->fixed);
+    }
+    else {
+        uproc_substmat_align_suffixes(pc->substmat, word->suffix, nb->suffix,
+                                      d->dist);
+    }
+}
+
+/* Add the score of a word match. If `pre` is not NULL, it holds the
+ * distances and `word` and `nb` aren't used. */
+static int
+scores_add(const struct uproc_protclass_s *pc, struct scoretab *scores,
+           uproc_family family, size_t index, const struct uproc_word *word,
+           const struct uproc_word *nb, bool reverse,
+           const union nbdist *pre)
+{
+    struct scoretab_entry *e;
+    double dist[UPROC_SUFFIX_LEN];
+    int16_t fixed_dist[QSC_LANES];
+
+    e = scoretab_lookup(scores, family, pc->fixed);
+    if (!e) {
+        return -1;
+    }
+    if (e->pruned) {
+        return 0;
+    }
+    if (scores->prune.enabled && scores_prunable(pc, scores, e, index)) {
+        e->pruned = true;
+        scores->prune.live--;
+        return 0;
+    }
+
+    if (pre) {
+        if (pc->fixed) {
+            qsc_add(&e->u.qsc, index, pre->fixed);
+        }
+        else {
+            sc_add(&e->u.sc, index, pre->dist, reverse);
+        }
+        return 0;
+    }
+
+    if (pc->fixed) {
+        qsc_align(pc->substmat, word->suffix, nb->suffix, reverse, fixed_dist);
+    }
+    if (!pc->fixed || pc->trace.cb) {
+        uproc_substmat_align_suffixes(pc->substmat, word->suffix, nb->suffix,
+                                      dist);
+    }
+    if (pc->trace.cb) {
+        pc->trace.cb(nb, family, index, reverse, dist, pc->trace.cb_arg);
+    }
+
+    if (pc->fixed) {
+        qsc_add(&e->u.qsc, index, fixed_dist);
+    }
+    else {
+        sc_add(&e->u.sc, index, dist, reverse);
+    }
+    return 0;
+}
+
+
+/* Number of words whose ecurve lookups are done in one batch */
+#define WORD_BATCH_SIZE 64
+
+/* Words of a sequence together with their neighbours in the ecurves; index 0
+ * of the outer dimension refers to the forward, index 1 to the reverse
+ * ecurve */
+struct word_batch
+{
+    size_t n;
+    size_t index[WORD_BATCH_SIZE];
+    struct uproc_word word[2][WORD_BATCH_SIZE];
+    struct uproc_word lower_nb[2][WORD_BATCH_SIZE];
+    struct uproc_word upper_nb[2][WORD_BATCH_SIZE];
+    uproc_family lower_family[2][WORD_BATCH_SIZE];
+    uproc_family upper_family[2][WORD_BATCH_SIZE];
+};
+
+
+static int
+scores_add_word(const uproc_protclass *pc, struct scoretab *scores,
+                const struct uproc_word *word,
+                const struct uproc_word *lower_nb, uproc_family lower_family,
+                const struct uproc_word *upper_nb, uproc_family upper_family,
+                size_t index, bool reverse)
+{
+    int res;
+
+    res = scores_add(pc, scores, lower_family, index, word, lower_nb, reverse,
+                     NULL);
+    if (res || !uproc_word_cmp(lower_nb, upper_nb)) {
+        return res;
+    }
+    return scores_add(pc, scores, upper_family, index, word, upper_nb,
+                      reverse, NULL);
+}
+
+/* Add the scores of a batch whose neighbours were already looked up */
+static int
+scores_add_found(const struct uproc_protclass_s *pc, struct scoretab *scores,
+                 struct word_batch *b)
+{
+    int res;
+    const uproc_ecurve *ecurves[2] = { pc->fwd, pc->rev };
+
+    /* add scores in the same order as the words appear in the sequence */
+    for (size_t i = 0; i < b->n; i++) {
+        for (int k = 0; k < 2; k++) {
+            if (!ecurves[k]) {
+                continue;
+            }
+            res = scores_add_word(pc, scores, &b->word[k][i],
+                                  &b->lower_nb[k][i], b->lower_family[k][i],
+                                  &b->upper_nb[k][i], b->upper_family[k][i],
+                                  b->index[i], k == 1);
+            if (res) {
+                return res;
+            }
+        }
+    }
+    b->n = 0;
+    return 0;
+}
+
+static int
+scores_add_batch(const struct uproc_protclass_s *pc, struct scoretab *scores,
+                 struct word_batch *b)
+{
+    const uproc_ecurve *ecurves[2] = { pc->fwd, pc->rev };
+
+    for (int k = 0; k < 2; k++) {
+        if (!ecurves[k]) {
+            continue;
+        }
+        uproc_ecurve_lookup_batch(ecurves[k], b->word[k], b->n,
+                                  b->lower_nb[k], b->lower_family[k],
+                                  b->upper_nb[k], b->upper_family[k], NULL);
+    }
+    return scores_add_found(pc, scores, b);
+}
+
+/*******************
+ * neighbour cache *
+ *******************/
+
+/* Neighbours of a word in one of the ecurves, together with their
+ * distances */
+struct nbcache_entry
+{
+    uproc_suffix suffix;
+    uproc_prefix prefix;
+    /* 0 if unused, else 1 + index of the ecurve (see struct word_batch) */
+    unsigned char ecurve;
+    /* whether the upper neighbour differs from the lower one */
+    bool upper;
+    uproc_family family[2];
+    union nbdist dist[2];
+};
+
+/* Direct-mapped cache of the ecurve lookups and alignments of recently seen
+ * words */
+struct nbcache
+{
+    /* classifier (and arithmetic) that the entries were computed with */
+    unsigned long owner;
+    size_t mask;
+    struct nbcache_entry *entries;
+
+    /* Entries computed for the current batch. They are only stored in
+     * `entries` after the whole batch has been added, so that entries of
+     * the same batch can't evict each other while still in use. */
+    size_t n_pending;
+    struct nbcache_pending
+    {
+        size_t slot;
+        struct nbcache_entry entry;
+    } pending[2 * WORD_BATCH_SIZE];
+};
+
+/* Get the cache of `ctx`, (re)initializing it if it wasn't used with the
+ * same classifier and size before */
+static struct nbcache *
+nbcache_get(const struct uproc_protclass_s *pc,
+            struct uproc_classify_ctx_s *ctx)
+{
+    struct nbcache *c = ctx->nbcache;
+    unsigned long owner = 2 * pc->id + pc->fixed;
+
+    if (!c) {
+        c = ctx->nbcache = calloc(1, sizeof *c);
+        if (!c) {
+            uproc_error(UPROC_ENOMEM);
+            return NULL;
+        }
+    }
+    if (c->mask + 1 != pc->cache_size || !c->entries) {
+        free(c->entries);
+        c->entries = malloc(pc->cache_size * sizeof *c->entries);
+        if (!c->entries) {
+            c->mask = 0;
+            uproc_error(UPROC_ENOMEM);
+            return NULL;
+        }
+        c->mask = pc->cache_size - 1;
+        c->owner = 0;
+    }
+    if (c->owner != owner) {
+        for (size_t i = 0; i <= c->mask; i++) {
+            c->entries[i].ecurve = 0;
+        }
+        c->owner = owner;
+    }
+    return c;
+}
+
+static size_t
+nbcache_slot(const struct nbcache *c, const struct uproc_word *word, int k)
+{
+    uint_least64_t h = word->suffix * UINT64_C(0x9e3779b97f4a7c15);
+    h ^= (word->prefix * 2 + k) * UINT64_C(0xc2b2ae3d27d4eb4f);
+    h ^= h >> 32;
+    return h & c->mask;
+}
+
+static void
+nbcache_free(struct nbcache *c)
+{
+    if (c) {
+        free(c->entries);
+        free(c);
+    }
+}
+
+/* Like scores_add_batch(), but taking the neighbours and distances from the
+ * cache where possible */
+static int
+scores_add_batch_cached(const struct uproc_protclass_s *pc,
+                        struct uproc_classify_ctx_s *ctx,
+                        struct scoretab *scores, struct nbcache *c,
+                        struct word_batch *b)
+{
+    int res;
+    const uproc_ecurve *ecurves[2] = { pc->fwd, pc->rev };
+    const struct nbcache_entry *nb[2][WORD_BATCH_SIZE];
+    struct uproc_word miss_word[WORD_BATCH_SIZE];
+
+    for (int k = 0; k < 2; k++) {
+        size_t n_miss = 0, miss[WORD_BATCH_SIZE], slot[WORD_BATCH_SIZE];
+        if (!ecurves[k]) {
+            continue;
+        }
+        for (size_t i = 0; i < b->n; i++) {
+            const struct uproc_word *w = &b->word[k][i];
+            const struct nbcache_entry *e;
+            slot[i] = nbcache_slot(c, w, k);
+            e = &c->entries[slot[i]];
+            if (e->ecurve == k + 1 && e->suffix == w->suffix &&
+                e->prefix == w->prefix) {
+                nb[k][i] = e;
+                continue;
+            }
+            /* the lookup arrays of the batch hold only the misses */
+            miss_word[n_miss] = *w;
+            miss[n_miss++] = i;
+        }
+        ctx->cache_lookups += b->n;
+        ctx->cache_hits += b->n - n_miss;
+
+        uproc_ecurve_lookup_batch(ecurves[k], miss_word, n_miss,
+                                  b->lower_nb[k], b->lower_family[k],
+                                  b->upper_nb[k], b->upper_family[k], NULL);
+        for (size_t j = 0; j < n_miss; j++) {
+            size_t i = miss[j];
+            struct nbcache_pending *p = &c->pending[c->n_pending++];
+            struct nbcache_entry *e = &p->entry;
+            const struct uproc_word *w = &b->word[k][i];
+
+            p->slot = slot[i];
+            e->suffix = w->suffix;
+            e->prefix = w->prefix;
+            e->ecurve = k + 1;
+            e->upper = uproc_word_cmp(&b->lower_nb[k][j],
+                                      &b->upper_nb[k][j]) != 0;
+            e->family[0] = b->lower_family[k][j];
+            e->family[1] = b->upper_family[k][j];
+            nbdist_align(pc, w, &b->lower_nb[k][j], k == 1, &e->dist[0]);
+            if (e->upper) {
+                nbdist_align(pc, w, &b->upper_nb[k][j], k == 1, &e->dist[1]);
+            }
+            nb[k][i] = e;
+        }
+    }
+
+    /* add scores in the same order as the words appear in the sequence */
+    res = 0;
+    for (size_t i = 0; !res && i < b->n; i++) {
+        for (int k = 0; !res && k < 2; k++) {
+            const struct nbcache_entry *e = nb[k][i];
+            if (!ecurves[k]) {
+                continue;
+            }
+            res = scores_add(pc, scores, e->family[0], b->index[i], NULL,
+                             NULL, k == 1, &e->dist[0]);
+            if (!res && e->upper) {
+                res = scores_add(pc, scores, e->family[1], b->index[i], NULL,
+                                 NULL, k == 1, &e->dist[1]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < c->n_pending; i++) {
+        c->entries[c->pending[i].slot] = c->pending[i].entry;
+    }
+    c->n_pending = 0;
+    b->n = 0;
+    return res;
+}
+
+/* Sequence to classify: a string, or the amino acid codes of an ORF (see
+ * protclass_classify_codes()) */
+struct protseq
+{
+    const char *data;
+    size_t len;
+    bool codes;
+};
+
+/* Translate a sequence into `ctx->aminos` */
+static int
+seq_translate(const struct uproc_protclass_s *pc,
+              struct uproc_classify_ctx_s *ctx, const struct protseq *seq)
+{
+    size_t len = seq->len;
+    if (ctx->aminos_alloc < len) {
+        size_t alloc = ctx->aminos_alloc ? ctx->aminos_alloc : 256;
+        void *tmp;
+        while (alloc < len) {
+            alloc *= 2;
+        }
+        tmp = realloc(ctx->aminos, alloc * sizeof *ctx->aminos);
+        if (!tmp) {
+            return uproc_error(UPROC_ENOMEM);
+        }
+        ctx->aminos = tmp;
+        ctx->aminos_alloc = alloc;
+    }
+    if (seq->codes) {
+        for (size_t i = 0; i < len; i++) {
+            ctx->aminos[i] = orf_code_amino(seq->data[i]);
+        }
+    }
+    else {
+        uproc_alphabet_translate(protclass_alphabet(pc), seq->data, len,
+                                 ctx->aminos);
+    }
+    return 0;
+}
+
+static int
+scores_compute(const struct uproc_protclass_s *pc, const struct protseq *seq,
+               struct uproc_classify_ctx_s *ctx, struct scoretab *scores)
+{
+    int res = 0;
+    size_t len = seq->len, pos = 0;
+    struct word_batch batch;
+    struct nbcache *cache = NULL;
+
+    /* tracing needs the neighbour words, which aren't cached */
+    if (pc->cache_size && !pc->trace.cb) {
+        cache = nbcache_get(pc, ctx);
+        if (!cache) {
+            return -1;
+        }
+    }
+
+    res = seq_translate(pc, ctx, seq);
+    if (res) {
+        return res;
+    }
+
+    scores_prune_init(pc, scores, len);
+
+    while ((batch.n = uproc_words_from_sequence(ctx->aminos, len, &pos,
+                                                WORD_BATCH_SIZE, batch.index,
+                                                batch.word[0],
+                                                batch.word[1]))) {
+        size_t next = batch.index[batch.n - 1] + 1;
+        bool full = batch.n == WORD_BATCH_SIZE;
+        res = cache ? scores_add_batch_cached(pc, ctx, scores, cache, &batch)
+                    : scores_add_batch(pc, scores, &batch);
+        if (res) {
+            break;
+        }
+        /* stop once no family can reach the threshold */
+        if (full && scores->prune.enabled && scores_prune(pc, scores, next)) {
+            return 0;
+        }
+    }
+    return res;
+}
+
+
+/****************
+ * finalization *
+ ****************/
+
+static int
+scores_finalize(const struct uproc_protclass_s *pc, const struct protseq *seq,
+                struct scoretab *scores, struct topk *top,
+                uproc_list *results)
+{
+    int res = 0;
+    struct uproc_protresult pred, pred_max = { .score = -INFINITY };
+
+    if (pc->mode == UPROC_PROTCLASS_TOP_K) {
+        res = topk_reset(top, pc->top_k);
+        if (res) {
+            return res;
+        }
+    }
+    else {
+        /* report the families in ascending order, so that ties in
+         * UPROC_PROTCLASS_MAX mode are won by the lowest family */
+        qsort(scores->entries, scores->n, sizeof *scores->entries,
+              scoretab_cmp);
+    }
+    for (size_t i = 0; i < scores->n; i++) {
+        struct scoretab_entry *e = &scores->entries[i];
+        uproc_family family = e->family;
+        double score;
+        if (e->pruned) {
+            continue;
+        }
+        if (pc->fixed) {
+            score = qsc_finalize(&e->u.qsc,
+                                 uproc_substmat_fixed_scale(pc->substmat));
+        }
+        else {
+            score = sc_finalize(&e->u.sc);
+        }
+        if (pc->filter &&
+            !pc->filter(seq->codes ? NULL : seq->data, seq->len, family,
+                        score, pc->filter_arg)) {
+            continue;
+        }
+        pred.score = score;
+        pred.family = family;
+        if (pc->mode == UPROC_PROTCLASS_MAX) {
+            if (!uproc_list_size(results)) {
+                pred_max = pred;
+                res = uproc_list_append(results, &pred);
+                if (res) {
+                    break;
+                }
+            }
+            else if (pred.score > pred_max.score) {
+                pred_max = pred;
+                uproc_list_set(results, 0, &pred_max);
+            }
+        }
+        else if (pc->mode == UPROC_PROTCLASS_TOP_K) {
+            topk_push(top, score, family, i);
+        }
+        else {
+            uproc_list_append(results, &pred);
+        }
+    }
+
+    if (pc->mode == UPROC_PROTCLASS_TOP_K) {
+        topk_sort(top);
+        for (size_t i = 0; !res && i < top->n; i++) {
+            pred.score = top->items[i].score;
+            pred.family = top->items[i].family;
+            res = uproc_list_append(results, &pred);
+        }
+    }
+    return res;
+}
+
+
+/***************
+ * memoization *
+ ***************/
 
-struct uproc_protclass_s
+/* Fingerprint of the settings that determine the results of `pc`
+ *
+ * The ecurves are only identified by which of them are present, so that the
+ * NUMA node copies of the same database can share a memo. Pruning and the
+ * neighbour cache don't change the results. Amino acid codes get their own
+ * fingerprint, as they aren't comparable to strings. */
+static uint64_t
+memo_config(const struct uproc_protclass_s *pc, const struct protseq *seq)
 {
-    enum uproc_protclass_mode mode;
-    const uproc_substmat *substmat;
-    const uproc_ecurve *fwd;
-    const uproc_ecurve *rev;
-    uproc_protfilter *filter;
-    void *filter_arg;
-    struct uproc_protclass_trace
+    struct
     {
-        uproc_protclass_trace_cb *cb;
-        void *cb_arg;
-    } trace;
-};
+        enum uproc_protclass_mode mode;
+        bool fwd, rev, fixed, codes;
+        size_t top_k;
+        const uproc_substmat *substmat;
+        uproc_protfilter *filter;
+        const void *filter_arg;
+    } settings;
 
-/*********************
- * score computation *
- *********************/
+    /* no uninitialized padding bytes in the fingerprint */
+    memset(&settings, 0, sizeof settings);
+    settings.mode = pc->mode;
+    settings.fwd = pc->fwd;
+    settings.rev = pc->rev;
+    settings.fixed = pc->fixed;
+    settings.codes = seq->codes;
+    settings.top_k = pc->mode == UPROC_PROTCLASS_TOP_K ? pc->top_k : 0;
+    settings.substmat = pc->substmat;
+    settings.filter = pc->filter;
+    settings.filter_arg = pc->filter_arg;
+    return protmemo_config(&settings, sizeof settings);
+}
 
-struct sc
+static void
+memo_key(const struct uproc_protclass_s *pc, const struct protseq *seq,
+         struct protmemo_key *key)
 {
-    size_t index;
-    double total, dist[UPROC_WORD_LEN];
-};
+    protmemo_key_init(key, memo_config(pc, seq), seq->data, seq->len);
+}
 
-static void
-reverse_array(void *p, size_t n, size_t sz)
+
+/******************
+ * sorted lookups *
+ ******************/
+
+/* Default size of the workspace of uproc_protclass_classify_many() */
+#define SORTED_BATCH_DEFAULT (10 << 20)
+
+/* One sequence is collected per this many words of space; batches of
+ * shorter sequences end early when all of them are used */
+#define SORTED_WORDS_PER_SEQ 16
+
+/* Bits sorted per radix sort pass. Words are sorted by suffix first and
+ * then by prefix, which takes five passes for the suffix (60 bits) and two
+ * for the prefix (UPROC_PREFIX_MAX < 2^26) */
+#define SORTED_RADIX_BITS 13
+#define SORTED_SUFFIX_PASSES \
+    ((UPROC_SUFFIX_LEN * UPROC_AMINO_BITS + SORTED_RADIX_BITS - 1) / \
+     SORTED_RADIX_BITS)
+#define SORTED_RADIX_PASSES (SORTED_SUFFIX_PASSES + 2)
+
+/* Words of many sequences, part of the classification workspace
+ *
+ * The words of all sequences are stored one after another. For each
+ * ecurve, they are sorted by prefix and suffix and looked up in that order
+ * with uproc_ecurve_lookup_sorted(), which reads the ecurve front to back.
+ * `rank` maps each word to its position in the sorted order, where its
+ * neighbours are found.
+ *
+ * The arrays hold `max_words` words resp. `max_seqs` sequences, which
+ * depend on the batch size of the classifier (see
+ * uproc_protclass_set_batch()). */
+struct sortbatch
 {
-    unsigned char *s = p, tmp;
-    size_t i, k, i1, i2;
+    size_t max_words, max_seqs;
+    size_t n, n_seqs;
+    struct sortbatch_seq
+    {
+        /* position in the input */
+        size_t index;
+        struct protseq seq;
+        /* words in `index` and `word` */
+        size_t start, n_words;
+        /* results were found in the memo */
+        bool done;
+        struct protmemo_key key;
+    } *seqs;
+
+    size_t *index;
+    struct uproc_word *word[2];
+    uint32_t *rank[2];
+
+    uint32_t *order, *order_tmp;
+    uint32_t count[1 << SORTED_RADIX_BITS];
+    struct uproc_word *sorted;
+    struct uproc_word *lower_nb[2], *upper_nb[2];
+    uproc_family *lower_family[2], *upper_family[2];
+};
+
+/* Bytes of the above needed per word */
+#define SORTED_WORD_SIZE \
+    (sizeof (size_t) + 7 * sizeof (struct uproc_word) + \
+     4 * sizeof (uint32_t) + 4 * sizeof (uproc_family) + \
+     sizeof (struct sortbatch_seq) / SORTED_WORDS_PER_SEQ)
 
-    for (i = 0; i < n / 2; i++) {
-        for (k = 0; k < sz; k++) {
-            i1 = sz * i + k;
-            i2 = sz * (n - i - 1) + k;
-            tmp = s[i1];
-            s[i1] = s[i2];
-            s[i2] = tmp;
-        }
-    }
-}
 
 static void
-sc_init(struct sc *s)
+sortbatch_free(struct sortbatch *sb)
 {
-    size_t i;
-    s->index = -1;
-    s->total = 0.0;
-    for (i = 0; i < UPROC_WORD_LEN; i++) {
-        s->dist[i] = -INFINITY;
+    if (!sb) {
+        return;
     }
+    free(sb->seqs);
+    free(sb->index);
+    free(sb->order);
+    free(sb->order_tmp);
+    free(sb->sorted);
+    for (int k = 0; k < 2; k++) {
+        free(sb->word[k]);
+        free(sb->rank[k]);
+        free(sb->lower_nb[k]);
+        free(sb->upper_nb[k]);
+        free(sb->lower_family[k]);
+        free(sb->upper_family[k]);
+    }
+    free(sb);
 }
 
-static void
-sc_add(struct sc *score, size_t index, double dist[static UPROC_SUFFIX_LEN],
-       bool reverse)
+
+/* Get the sorted words of `ctx`, (re)allocating them if they weren't used
+ * with the same batch size before */
+static struct sortbatch *
+sortbatch_get(const struct uproc_protclass_s *pc,
+              struct uproc_classify_ctx_s *ctx)
 {
-    size_t i, diff;
-    double tmp[UPROC_WORD_LEN];
+    struct sortbatch *sb = ctx->sortbatch;
+    size_t n = pc->batch_size / SORTED_WORD_SIZE;
+    bool ok;
 
-    for (i = 0; i < UPROC_PREFIX_LEN; i++) {
-        tmp[i] = -INFINITY;
+    if (!n) {
+        n = 1;
     }
-    memcpy(tmp + UPROC_PREFIX_LEN, dist, sizeof *dist * UPROC_SUFFIX_LEN);
-    if (reverse) {
-        reverse_array(tmp, UPROC_WORD_LEN, sizeof *tmp);
+    if (n > UINT32_MAX) {
+        n = UINT32_MAX;
     }
-
-    if (score->index != (size_t) -1) {
-        diff = index - score->index;
-        if (diff > UPROC_WORD_LEN) {
-            diff = UPROC_WORD_LEN;
-        }
-        for (i = 0; i < diff; i++) {
-            if (isfinite(score->dist[i])) {
-                score->total += score->dist[i];
-                score->dist[i] = -INFINITY;
-            }
-        }
+    if (sb && sb->max_words == n) {
+        return sb;
     }
-    else {
-        diff = 0;
+    sortbatch_free(sb);
+    sb = ctx->sortbatch = calloc(1, sizeof *sb);
+    if (!sb) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
     }
-
-    for (i = 0; i + diff < UPROC_WORD_LEN; i++) {
-#define MAX(a, b) (a > b ? a : b)
-        score->dist[i] = MAX(score->dist[i + diff], tmp[i]);
+    sb->max_words = n;
+    sb->max_seqs = n / SORTED_WORDS_PER_SEQ + 1;
+    sb->seqs = malloc(sb->max_seqs * sizeof *sb->seqs);
+    sb->index = malloc(n * sizeof *sb->index);
+    sb->order = malloc(n * sizeof *sb->order);
+    sb->order_tmp = malloc(n * sizeof *sb->order_tmp);
+    sb->sorted = malloc(n * sizeof *sb->sorted);
+    ok = sb->seqs && sb->index && sb->order && sb->order_tmp && sb->sorted;
+    for (int k = 0; k < 2; k++) {
+        sb->word[k] = malloc(n * sizeof *sb->word[k]);
+        sb->rank[k] = malloc(n * sizeof *sb->rank[k]);
+        sb->lower_nb[k] = malloc(n * sizeof *sb->lower_nb[k]);
+        sb->upper_nb[k] = malloc(n * sizeof *sb->upper_nb[k]);
+        sb->lower_family[k] = malloc(n * sizeof *sb->lower_family[k]);
+        sb->upper_family[k] = malloc(n * sizeof *sb->upper_family[k]);
+        ok = ok && sb->word[k] && sb->rank[k] && sb->lower_nb[k] &&
+             sb->upper_nb[k] && sb->lower_family[k] && sb->upper_family[k];
     }
-    for (; i < UPROC_WORD_LEN; i++) {
-        score->dist[i] = tmp[i];
+    if (!ok) {
+        sortbatch_free(sb);
+        ctx->sortbatch = NULL;
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
     }
-    score->index = index;
+    return sb;
 }
 
-static double
-sc_finalize(struct sc *score)
+
+static void
+map_list_protresult_free(void *value, void *opaque)
 {
-    size_t i;
-    for (i = 0; i < UPROC_WORD_LEN; i++) {
-        if (isfinite(score->dist[i])) {
-            score->total += score->dist[i];
-        }
-    }
-    return score->total;
+    (void) opaque;
+    uproc_protresult_free(value);
 }
 
+
+/* Create an empty result list or empty an existing one */
 static int
-scores_add(uproc_bst *scores, uproc_family family, size_t index,
-           double dist[static UPROC_SUFFIX_LEN], bool reverse)
+results_prepare(uproc_list **results)
 {
-    struct sc sc;
-    union uproc_bst_key key = { .uint = family };
-    sc_init(&sc);
-    (void) uproc_bst_get(scores, key, &sc);
-    sc_add(&sc, index, dist, reverse);
-    return uproc_bst_update(scores, key, &sc);
+    if (!*results) {
+        *results = uproc_list_create(sizeof (struct uproc_protresult));
+        if (!*results) {
+            return -1;
+        }
+    }
+    else {
+        uproc_list_map(*results, map_list_protresult_free, NULL);
+        uproc_list_clear(*results);
+    }
+    return 0;
 }
 
 
+/* Append the words of a sequence (or take its results from the memo) */
 static int
-scores_add_word(const uproc_protclass *pc, uproc_bst *scores,
-                const struct uproc_word *word,
-                size_t index, bool reverse, const uproc_ecurve *ecurve,
-                const uproc_substmat *substmat)
+sortbatch_add(const struct uproc_protclass_s *pc,
+              struct uproc_classify_ctx_s *ctx, struct sortbatch *sb,
+              size_t seq_index, const struct protseq *seq,
+              uproc_list **results)
 {
     int res;
-    struct uproc_word
-        lower_nb = UPROC_WORD_INITIALIZER,
-        upper_nb = UPROC_WORD_INITIALIZER;
-    uproc_family lower_family, upper_family;
-    double dist[UPROC_SUFFIX_LEN];
+    size_t pos = 0, n;
+    struct sortbatch_seq *s = &sb->seqs[sb->n_seqs++];
 
-    if (!ecurve) {
-        return 0;
+    res = results_prepare(results);
+    if (res) {
+        return res;
     }
-    uproc_ecurve_lookup(ecurve, word, &lower_nb, &lower_family, &upper_nb,
-                        &upper_family);
-    uproc_substmat_align_suffixes(substmat, word->suffix, lower_nb.suffix,
-                                  dist);
-    if (pc->trace.cb) {
-        pc->trace.cb(&lower_nb, lower_family, index, reverse, dist,
-                     pc->trace.cb_arg);
+    *s = (struct sortbatch_seq) {
+        .index = seq_index,
+        .seq = *seq,
+        .start = sb->n,
+        .n_words = 0,
+        .done = false,
+    };
+    if (pc->memo && !pc->trace.cb) {
+        memo_key(pc, seq, &s->key);
+        res = protmemo_get(pc->memo, &s->key, *results);
+        if (res) {
+            s->done = true;
+            return res < 0 ? res : 0;
+        }
     }
-    res = scores_add(scores, lower_family, index, dist, reverse);
-    if (res || !uproc_word_cmp(&lower_nb, &upper_nb)) {
+
+    res = seq_translate(pc, ctx, seq);
+    if (res) {
         return res;
     }
-    uproc_substmat_align_suffixes(substmat, word->suffix, upper_nb.suffix,
-                                  dist);
-    if (pc->trace.cb) {
-        pc->trace.cb(&upper_nb, upper_family, index, reverse, dist,
-                     pc->trace.cb_arg);
+    while ((n = uproc_words_from_sequence(ctx->aminos, seq->len, &pos,
+                                          sb->max_words - sb->n,
+                                          &sb->index[sb->n],
+                                          &sb->word[0][sb->n],
+                                          &sb->word[1][sb->n]))) {
+        sb->n += n;
     }
-    res = scores_add(scores, upper_family, index, dist, reverse);
-    return res;
+    s->n_words = sb->n - s->start;
+    return 0;
 }
 
-static int
-scores_compute(const struct uproc_protclass_s *pc, const char *seq,
-               uproc_bst *scores)
-{
-    int res;
-    uproc_worditer *iter;
-    size_t index;
-    struct uproc_word
-        fwd_word = UPROC_WORD_INITIALIZER,
-        rev_word = UPROC_WORD_INITIALIZER;
 
-    iter = uproc_worditer_create(seq, uproc_ecurve_alphabet(pc->fwd));
-    if (!iter) {
-        return -1;
+/* Radix sort digit `pass` of a word, starting with the least significant
+ * digit of the suffix */
+static inline uint32_t
+sortbatch_digit(const struct uproc_word *w, int pass)
+{
+    const uint32_t mask = (1 << SORTED_RADIX_BITS) - 1;
+    if (pass < SORTED_SUFFIX_PASSES) {
+        return (w->suffix >> (pass * SORTED_RADIX_BITS)) & mask;
     }
+    pass -= SORTED_SUFFIX_PASSES;
+    return (w->prefix >> (pass * SORTED_RADIX_BITS)) & mask;
+}
 
-    while (res = uproc_worditer_next(iter, &index, &fwd_word, &rev_word),
-           !res)
-    {
-        res = scores_add_word(pc, scores, &fwd_word, index, false, pc->fwd,
-                              pc->substmat);
-        if (res) {
-            break;
+
+/* Look up the words in one of the ecurves, in ascending order of their
+ * prefixes and suffixes (LSD radix sort) */
+static void
+sortbatch_lookup(struct sortbatch *sb, const uproc_ecurve *ecurve, int k)
+{
+    uint32_t *src = sb->order_tmp, *dst = sb->order, *tmp;
+
+    for (size_t i = 0; i < sb->n; i++) {
+        src[i] = i;
+    }
+    for (int pass = 0; pass < SORTED_RADIX_PASSES; pass++) {
+        uint32_t sum = 0;
+        memset(sb->count, 0, sizeof sb->count);
+        for (size_t i = 0; i < sb->n; i++) {
+            sb->count[sortbatch_digit(&sb->word[k][src[i]], pass)]++;
         }
-        res = scores_add_word(pc, scores, &rev_word, index, true, pc->rev,
-                              pc->substmat);
-        if (res) {
-            break;
+        /* skip digits that are the same for all words, e.g. the unused high
+         * bits of the suffix */
+        if (sb->count[sortbatch_digit(&sb->word[k][src[0]], pass)] ==
+            sb->n) {
+            continue;
         }
+        for (size_t i = 0; i < (size_t) 1 << SORTED_RADIX_BITS; i++) {
+            uint32_t c = sb->count[i];
+            sb->count[i] = sum;
+            sum += c;
+        }
+        for (size_t i = 0; i < sb->n; i++) {
+            uint32_t w = src[i];
+            dst[sb->count[sortbatch_digit(&sb->word[k][w], pass)]++] = w;
+        }
+        tmp = src;
+        src = dst;
+        dst = tmp;
     }
-    uproc_worditer_destroy(iter);
-    return res == -1 ? -1 : 0;
-}
 
+    for (size_t i = 0; i < sb->n; i++) {
+        sb->sorted[i] = sb->word[k][src[i]];
+        sb->rank[k][src[i]] = i;
+    }
+    uproc_ecurve_lookup_sorted(ecurve, sb->sorted, sb->n,
+                               sb->lower_nb[k], sb->lower_family[k],
+                               sb->upper_nb[k], sb->upper_family[k], NULL);
+}
 
-/****************
- * finalization *
- ****************/
 
+/* Score a sequence whose words were looked up, in batches of the same size
+ * as scores_compute() uses */
 static int
-scores_finalize(const struct uproc_protclass_s *pc, const char *seq,
-                uproc_bst *score_tree, uproc_list *results)
+sortbatch_score(const struct uproc_protclass_s *pc,
+                struct uproc_classify_ctx_s *ctx, struct sortbatch *sb,
+                const struct sortbatch_seq *s, struct scoretab *scores,
+                uproc_list *results)
 {
     int res = 0;
-    uproc_bstiter *iter;
-    union uproc_bst_key key;
-    struct sc value;
-    size_t seq_len = strlen(seq);
-    struct uproc_protresult pred, pred_max = { .score = -INFINITY };
+    const uproc_ecurve *ecurves[2] = { pc->fwd, pc->rev };
+    struct word_batch b;
 
-    iter = uproc_bstiter_create(score_tree);
-    if (!iter) {
-        return -1;
-    }
-    while (!uproc_bstiter_next(iter, &key, &value)) {
-        uproc_family family = key.uint;
-        double score = sc_finalize(&value);
-        if (pc->filter &&
-            !pc->filter(seq, seq_len, family, score, pc->filter_arg)) {
-            continue;
+    scores_prune_init(pc, scores, s->seq.len);
+    for (size_t i = 0; i < s->n_words; i += WORD_BATCH_SIZE) {
+        size_t next;
+        bool full;
+
+        b.n = s->n_words - i;
+        if (b.n > WORD_BATCH_SIZE) {
+            b.n = WORD_BATCH_SIZE;
         }
-        pred.score = score;
-        pred.family = family;
-        if (pc->mode == UPROC_PROTCLASS_MAX) {
-            if (!uproc_list_size(results)) {
-                pred_max = pred;
-                res = uproc_list_append(results, &pred);
-                if (res) {
-                    break;
+        for (size_t j = 0; j < b.n; j++) {
+            size_t w = s->start + i + j;
+            b.index[j] = sb->index[w];
+            for (int k = 0; k < 2; k++) {
+                uint32_t r;
+                if (!ecurves[k]) {
+                    continue;
                 }
-            }
-            else if (pred.score > pred_max.score) {
-                pred_max = pred;
-                uproc_list_set(results, 0, &pred_max);
+                r = sb->rank[k][w];
+                b.word[k][j] = sb->word[k][w];
+                b.lower_nb[k][j] = sb->lower_nb[k][r];
+                b.lower_family[k][j] = sb->lower_family[k][r];
+                b.upper_nb[k][j] = sb->upper_nb[k][r];
+                b.upper_family[k][j] = sb->upper_family[k][r];
             }
         }
-        else {
-            uproc_list_append(results, &pred);
+        next = b.index[b.n - 1] + 1;
+        full = b.n == WORD_BATCH_SIZE;
+        res = scores_add_found(pc, scores, &b);
+        if (res) {
+            goto error;
+        }
+        if (full && scores->prune.enabled && scores_prune(pc, scores, next)) {
+            break;
         }
     }
-    uproc_bstiter_destroy(iter);
+    if (scores->n) {
+        res = scores_finalize(pc, &s->seq, scores, &ctx->prot_top, results);
+    }
+error:
+    scoretab_reset(scores);
     return res;
 }
 
@@ -277,6 +1347,9 @@ scores_finalize(const struct uproc_protclass_s *pc, const char *seq,
  * exported functions *
  **********************/
 
+/* number of classifiers created so far, used for their `id` */
+static unsigned long protclass_count;
+
 uproc_protclass *
 uproc_protclass_create(enum uproc_protclass_mode mode, const uproc_ecurve *fwd,
                        const uproc_ecurve *rev, const uproc_substmat *substmat,
@@ -300,11 +1373,23 @@ uproc_protclass_create(enum uproc_protclass_mode mode, const uproc_ecurve *fwd,
         .rev = rev,
         .filter = filter,
         .filter_arg = filter_arg,
+        .fixed = false,
+        .top_k = 1,
+        .thresh = NULL,
+        .thresh_arg = NULL,
+        .dist_max = substmat ? uproc_substmat_max(substmat) : 0.0,
+        .cache_size = 0,
+        .batch_size = SORTED_BATCH_DEFAULT,
+        .memo = NULL,
         .trace = {
             .cb = NULL,
             .cb_arg = NULL,
         },
     };
+#if _OPENMP
+#pragma omp critical(protclass_count)
+#endif
+    pc->id = ++protclass_count;
     return pc;
 }
 
@@ -315,46 +1400,223 @@ uproc_protclass_destroy(uproc_protclass *pc)
 }
 
 
-static void
-map_list_protresult_free(void *value, void *opaque)
-{
-    (void) opaque;
-    uproc_protresult_free(value);
-}
-
-
 int
 uproc_protclass_classify(const uproc_protclass *pc, const char *seq,
                          uproc_list **results)
+{
+    struct uproc_classify_ctx_s *ctx = uproc_classify_ctx_thread();
+    if (!ctx) {
+        return -1;
+    }
+    return uproc_protclass_classify_ctx(pc, ctx, seq, results);
+}
+
+static int
+classify_seq(const struct uproc_protclass_s *pc,
+             struct uproc_classify_ctx_s *ctx, const struct protseq *seq,
+             uproc_list **results)
 {
     int res;
-    uproc_bst *scores;
+    struct scoretab *scores;
+    struct protmemo_key key;
+    bool memo = pc->memo && !pc->trace.cb;
 
-    if (!*results) {
-        *results = uproc_list_create(sizeof (struct uproc_protresult));
-        if (!*results) {
-            return -1;
-        }
+    res = results_prepare(results);
+    if (res) {
+        return res;
     }
-    else {
-        uproc_list_map(*results, map_list_protresult_free, NULL);
-        uproc_list_clear(*results);
+
+    if (memo) {
+        memo_key(pc, seq, &key);
+        res = protmemo_get(pc->memo, &key, *results);
+        if (res) {
+            return res < 0 ? res : 0;
+        }
     }
 
-    scores = uproc_bst_create(UPROC_BST_UINT, sizeof (struct sc));
+    scores = scoretab_get(ctx);
     if (!scores) {
         return -1;
     }
-    res = scores_compute(pc, seq, scores);
-    if (res || uproc_bst_isempty(scores)) {
+    res = scores_compute(pc, seq, ctx, scores);
+    if (res || !scores->n) {
         goto error;
     }
-    res = scores_finalize(pc, seq, scores, *results);
+    res = scores_finalize(pc, seq, scores, &ctx->prot_top, *results);
 error:
-    uproc_bst_destroy(scores);
+    scoretab_reset(scores);
+    if (!res && memo) {
+        res = protmemo_put(pc->memo, &key, *results);
+    }
     return res;
 }
 
+/* Classify `n` sequences, which are amino acid codes of the given lengths
+ * if `lens` is non-NULL and strings otherwise */
+static int
+classify_many(const struct uproc_protclass_s *pc,
+              struct uproc_classify_ctx_s *ctx, const char *const *seqs,
+              const size_t *lens, size_t n, uproc_list **results)
+{
+    int res;
+    const uproc_ecurve *ecurves[2] = { pc->fwd, pc->rev };
+    struct sortbatch *sb = sortbatch_get(pc, ctx);
+    struct scoretab *scores = scoretab_get(ctx);
+    size_t i = 0;
+
+    if (!sb || !scores) {
+        return -1;
+    }
+    while (i < n) {
+        /* collect the words of as many sequences as fit */
+        sb->n = sb->n_seqs = 0;
+        for (; i < n && sb->n_seqs < sb->max_seqs; i++) {
+            struct protseq seq = {
+                .data = seqs[i],
+                .len = lens ? lens[i] : strlen(seqs[i]),
+                .codes = lens != NULL,
+            };
+            size_t max_words = seq.len < UPROC_WORD_LEN ?
+                               0 : seq.len - UPROC_WORD_LEN + 1;
+            if (max_words > sb->max_words) {
+                /* too long to be looked up together with others */
+                res = classify_seq(pc, ctx, &seq, &results[i]);
+                if (res) {
+                    return res;
+                }
+                continue;
+            }
+            if (max_words > sb->max_words - sb->n) {
+                break;
+            }
+            res = sortbatch_add(pc, ctx, sb, i, &seq, &results[i]);
+            if (res) {
+                return res;
+            }
+        }
+
+        for (int k = 0; k < 2; k++) {
+            if (ecurves[k] && sb->n) {
+                sortbatch_lookup(sb, ecurves[k], k);
+            }
+        }
+
+        for (size_t j = 0; j < sb->n_seqs; j++) {
+            const struct sortbatch_seq *s = &sb->seqs[j];
+            if (s->done) {
+                continue;
+            }
+            res = sortbatch_score(pc, ctx, sb, s, scores, results[s->index]);
+            if (!res && pc->memo && !pc->trace.cb) {
+                res = protmemo_put(pc->memo, &s->key, results[s->index]);
+            }
+            if (res) {
+                return res;
+            }
+        }
+    }
+    return 0;
+}
+
+int
+uproc_protclass_classify_ctx(const uproc_protclass *pc,
+                             uproc_classify_ctx *ctx, const char *seq,
+                             uproc_list **results)
+{
+    struct protseq s = { .data = seq, .len = strlen(seq), .codes = false };
+    return classify_seq(pc, ctx, &s, results);
+}
+
+int
+uproc_protclass_classify_many(const uproc_protclass *pc,
+                              uproc_classify_ctx *ctx,
+                              const char *const *seqs, size_t n,
+                              uproc_list **results)
+{
+    return classify_many(pc, ctx, seqs, NULL, n, results);
+}
+
+const uproc_alphabet *
+protclass_alphabet(const uproc_protclass *pc)
+{
+    return uproc_ecurve_alphabet(pc->fwd ? pc->fwd : pc->rev);
+}
+
+int
+protclass_classify_codes(const uproc_protclass *pc, uproc_classify_ctx *ctx,
+                         const char *codes, size_t len, uproc_list **results)
+{
+    struct protseq s = { .data = codes, .len = len, .codes = true };
+    return classify_seq(pc, ctx, &s, results);
+}
+
+int
+protclass_classify_many_codes(const uproc_protclass *pc,
+                              uproc_classify_ctx *ctx,
+                              const char *const *codes, const size_t *lens,
+                              size_t n, uproc_list **results)
+{
+    return classify_many(pc, ctx, codes, lens, n, results);
+}
+
+void
+protclass_ctx_free(struct uproc_classify_ctx_s *ctx)
+{
+    sortbatch_free(ctx->sortbatch);
+    free(ctx->aminos);
+    nbcache_free(ctx->nbcache);
+    if (ctx->scores) {
+        free(ctx->scores->entries);
+        free(ctx->scores);
+    }
+}
+
+void
+uproc_protclass_set_fixed(uproc_protclass *pc, bool enable)
+{
+    pc->fixed = enable;
+}
+
+void
+uproc_protclass_set_top_k(uproc_protclass *pc, size_t k)
+{
+    pc->top_k = k;
+}
+
+void
+uproc_protclass_set_thresh(uproc_protclass *pc, uproc_protthresh *thresh,
+                           void *thresh_arg)
+{
+    pc->thresh = thresh;
+    pc->thresh_arg = thresh_arg;
+}
+
+void
+uproc_protclass_set_cache(uproc_protclass *pc, size_t size)
+{
+    size_t pow2 = 1;
+    if (!size) {
+        pc->cache_size = 0;
+        return;
+    }
+    while (pow2 <= size / 2) {
+        pow2 *= 2;
+    }
+    pc->cache_size = pow2;
+}
+
+void
+uproc_protclass_set_batch(uproc_protclass *pc, size_t size)
+{
+    pc->batch_size = size;
+}
+
+void
+uproc_protclass_set_memo(uproc_protclass *pc, uproc_protmemo *memo)
+{
+    pc->memo = memo;
+}
+
 void
 uproc_protclass_set_trace(uproc_protclass *pc, uproc_protclass_trace_cb *cb,
                           void *cb_arg)
@@ -0,0 +1,397 @@
+/* Memoize protein classification results
+ *
+ * Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of libuproc.
+ *
+ * libuproc is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation, either version 3 of the License, or (at your option)
+ * any later version.
+ *
+ * libuproc is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE.  See the GNU Lesser General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with libuproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if _OPENMP
+#include <omp.h>
+#endif
+
+#include "uproc/error.h"
+#include "uproc/list.h"
+#include "uproc/protclass.h"
+#include "classify_internal.h"
+
+/* Number of independently locked parts of the table (a power of two).
+ *
+ * The shard of a sequence is selected by the high bits of its hash, so
+ * threads only wait for each other if they access the same shard at the
+ * same time. */
+#define SHARDS_LOG2 6
+#define SHARDS (1 << SHARDS_LOG2)
+
+/* A memoized sequence
+ *
+ * Allocated as a single block containing the results followed by the
+ * sequence string. */
+struct entry
+{
+    uint64_t config, hash;
+    size_t len, n_results;
+    /* next entry in the same bucket */
+    struct entry *next;
+    /* neighbours in the order of last use */
+    struct entry *older, *newer;
+    struct uproc_protresult results[];
+};
+
+struct shard
+{
+#if _OPENMP
+    omp_lock_t lock;
+#endif
+    /* chained hash table, indexed by the low bits of the hash */
+    struct entry **buckets;
+    size_t mask, n;
+    /* total size of the entries */
+    size_t bytes;
+    /* least and most recently used entry */
+    struct entry *oldest, *newest;
+    unsigned long long lookups, hits;
+};
+
+struct uproc_protmemo_s
+{
+    /* memory limit of each shard */
+    size_t shard_bytes;
+    struct shard shards[SHARDS];
+};
+
+
+static size_t
+entry_size(size_t len, size_t n_results)
+{
+    return sizeof (struct entry) + n_results * sizeof (struct uproc_protresult)
+           + len + 1;
+}
+
+
+static char *
+entry_seq(struct entry *e)
+{
+    return (char *)(e->results + e->n_results);
+}
+
+
+static struct shard *
+shard_get(struct uproc_protmemo_s *memo, const struct protmemo_key *key)
+{
+    return &memo->shards[key->hash >> (64 - SHARDS_LOG2)];
+}
+
+
+static void
+shard_lock(struct shard *s)
+{
+#if _OPENMP
+    omp_set_lock(&s->lock);
+#else
+    (void) s;
+#endif
+}
+
+
+static void
+shard_unlock(struct shard *s)
+{
+#if _OPENMP
+    omp_unset_lock(&s->lock);
+#else
+    (void) s;
+#endif
+}
+
+
+static struct entry *
+shard_find(struct shard *s, const struct protmemo_key *key)
+{
+    if (!s->buckets) {
+        return NULL;
+    }
+    for (struct entry *e = s->buckets[key->hash & s->mask]; e; e = e->next) {
+        if (e->hash == key->hash && e->config == key->config &&
+            e->len == key->len &&
+            !memcmp(entry_seq(e), key->seq, key->len)) {
+            return e;
+        }
+    }
+    return NULL;
+}
+
+
+/* Remove an entry from the order of use */
+static void
+shard_unlink(struct shard *s, struct entry *e)
+{
+    if (e->older) {
+        e->older->newer = e->newer;
+    }
+    else {
+        s->oldest = e->newer;
+    }
+    if (e->newer) {
+        e->newer->older = e->older;
+    }
+    else {
+        s->newest = e->older;
+    }
+}
+
+
+/* Make an entry the most recently used one */
+static void
+shard_push(struct shard *s, struct entry *e)
+{
+    e->older = s->newest;
+    e->newer = NULL;
+    if (s->newest) {
+        s->newest->newer = e;
+    }
+    else {
+        s->oldest = e;
+    }
+    s->newest = e;
+}
+
+
+static void
+shard_evict(struct shard *s)
+{
+    struct entry *e = s->oldest, **p = &s->buckets[e->hash & s->mask];
+    while (*p != e) {
+        p = &(*p)->next;
+    }
+    *p = e->next;
+    shard_unlink(s, e);
+    s->bytes -= entry_size(e->len, e->n_results);
+    s->n--;
+    free(e);
+}
+
+
+/* Double the number of buckets */
+static int
+shard_grow(struct shard *s)
+{
+    size_t n_buckets = s->buckets ? 2 * (s->mask + 1) : 64;
+    struct entry **buckets = calloc(n_buckets, sizeof *buckets);
+    if (!buckets) {
+        return uproc_error(UPROC_ENOMEM);
+    }
+    for (struct entry *e = s->oldest; e; e = e->newer) {
+        size_t i = e->hash & (n_buckets - 1);
+        e->next = buckets[i];
+        buckets[i] = e;
+    }
+    free(s->buckets);
+    s->buckets = buckets;
+    s->mask = n_buckets - 1;
+    return 0;
+}
+
+
+/* MurmurHash64A by Austin Appleby (public domain) */
+static uint64_t
+hash_bytes(const char *data, size_t len, uint64_t seed)
+{
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+    uint64_t h = seed ^ (len * m), k = 0;
+    size_t i;
+
+    for (i = 0; i + 8 <= len; i += 8) {
+        memcpy(&k, data + i, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+    if (i < len) {
+        k = 0;
+        memcpy(&k, data + i, len - i);
+        h ^= k;
+        h *= m;
+    }
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+
+uint64_t
+protmemo_config(const void *settings, size_t size)
+{
+    return hash_bytes(settings, size, 0);
+}
+
+
+void
+protmemo_key_init(struct protmemo_key *key, uint64_t config, const char *seq,
+                  size_t len)
+{
+    key->seq = seq;
+    key->len = len;
+    key->config = config;
+    key->hash = hash_bytes(seq, key->len, config);
+}
+
+
+int
+protmemo_get(uproc_protmemo *memo, const struct protmemo_key *key,
+             uproc_list *results)
+{
+    int res = 0;
+    struct shard *s = shard_get(memo, key);
+    struct entry *e;
+
+    shard_lock(s);
+    s->lookups++;
+    e = shard_find(s, key);
+    if (e) {
+        s->hits++;
+        shard_unlink(s, e);
+        shard_push(s, e);
+        for (size_t i = 0; !res && i < e->n_results; i++) {
+            res = uproc_list_append(results, &e->results[i]);
+        }
+    }
+    shard_unlock(s);
+    return res ? res : !!e;
+}
+
+
+int
+protmemo_put(uproc_protmemo *memo, const struct protmemo_key *key,
+             const uproc_list *results)
+{
+    int res = 0;
+    struct shard *s = shard_get(memo, key);
+    size_t n_results = uproc_list_size(results),
+           size = entry_size(key->len, n_results);
+    struct entry *e;
+
+    if (size > memo->shard_bytes) {
+        return 0;
+    }
+    e = malloc(size);
+    if (!e) {
+        return uproc_error(UPROC_ENOMEM);
+    }
+    e->config = key->config;
+    e->hash = key->hash;
+    e->len = key->len;
+    e->n_results = n_results;
+    for (size_t i = 0; i < n_results; i++) {
+        (void) uproc_list_get(results, i, &e->results[i]);
+    }
+    /* the sequence isn't necessarily terminated */
+    memcpy(entry_seq(e), key->seq, key->len);
+    entry_seq(e)[key->len] = '\0';
+
+    shard_lock(s);
+    /* another thread might have classified the same sequence meanwhile */
+    if (shard_find(s, key)) {
+        goto out;
+    }
+    while (s->bytes + size > memo->shard_bytes) {
+        shard_evict(s);
+    }
+    if (s->n == (s->buckets ? s->mask + 1 : 0)) {
+        res = shard_grow(s);
+        if (res) {
+            goto out;
+        }
+    }
+    e->next = s->buckets[e->hash & s->mask];
+    s->buckets[e->hash & s->mask] = e;
+    shard_push(s, e);
+    s->bytes += size;
+    s->n++;
+    e = NULL;
+out:
+    shard_unlock(s);
+    free(e);
+    return res;
+}
+
+
+uproc_protmemo *
+uproc_protmemo_create(size_t size)
+{
+    struct uproc_protmemo_s *memo = calloc(1, sizeof *memo);
+    if (!memo) {
+        uproc_error(UPROC_ENOMEM);
+        return NULL;
+    }
+    memo->shard_bytes = size / SHARDS;
+#if _OPENMP
+    for (int i = 0; i < SHARDS; i++) {
+        omp_init_lock(&memo->shards[i].lock);
+    }
+#endif
+    return memo;
+}
+
+
+void
+uproc_protmemo_destroy(uproc_protmemo *memo)
+{
+    if (!memo) {
+        return;
+    }
+    for (int i = 0; i < SHARDS; i++) {
+        struct shard *s = &memo->shards[i];
+        while (s->oldest) {
+            struct entry *e = s->oldest;
+            s->oldest = e->newer;
+            free(e);
+        }
+        free(s->buckets);
+#if _OPENMP
+        omp_destroy_lock(&s->lock);
+#endif
+    }
+    free(memo);
+}
+
+
+void
+uproc_protmemo_stats(const uproc_protmemo *memo, unsigned long long *lookups,
+                     unsigned long long *hits)
+{
+    *lookups = *hits = 0;
+    for (int i = 0; i < SHARDS; i++) {
+        /* the counters are updated under the lock, so read them under it
+         * too (the lock itself isn't part of the memo's contents) */
+        struct shard *s = (struct shard *)&memo->shards[i];
+        shard_lock(s);
+        *lookups += s->lookups;
+        *hits += s->hits;
+        shard_unlock(s);
+    }
+}
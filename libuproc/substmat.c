@@ -25,6 +25,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #include "uproc/common.h"
 #include "uproc/error.h"
@@ -33,14 +34,69 @@
 #include "uproc/matrix.h"
 #include "uproc/substmat.h"
 
+/* Length of a row of `dists`, indexed by SUBSTMAT_INDEX() */
+#define SUBSTMAT_ROW_LEN (UPROC_ALPHABET_SIZE << UPROC_AMINO_BITS)
+
 struct uproc_substmat_s
 {
     /** Matrix containing distances */
-    double dists[UPROC_SUFFIX_LEN][UPROC_ALPHABET_SIZE << UPROC_AMINO_BITS];
+    double dists[UPROC_SUFFIX_LEN][SUBSTMAT_ROW_LEN];
+
+    /** Fixed-point copy of `dists`, multiplied by `scale` */
+    int16_t fixed[UPROC_SUFFIX_LEN][SUBSTMAT_ROW_LEN];
+
+    /** Largest absolute (finite) distance */
+    double absmax;
+
+    /** Scale of the fixed-point distances */
+    double scale;
 };
 
 #define SUBSTMAT_INDEX(x, y) ((x) << UPROC_AMINO_BITS | (y))
 
+/* Largest scale of fixed-point values */
+#define FIXED_SCALE_MAX 65536.0
+
+
+/* Largest power of two (up to FIXED_SCALE_MAX) by which `absmax` can be
+ * multiplied without exceeding INT16_MAX */
+static double
+fixed_scale(double absmax)
+{
+    double scale = FIXED_SCALE_MAX;
+    while (absmax * scale > INT16_MAX) {
+        scale /= 2;
+    }
+    return scale;
+}
+
+
+/* INT16_MIN is only used for -INFINITY (and NaN), which callers treat as "no
+ * value" like the floating-point scores do; finite distances are clamped to
+ * the remaining range */
+static int16_t
+fixed_value(double dist, double scale)
+{
+    double x = round(dist * scale);
+    if (!(x > -INFINITY)) {
+        return INT16_MIN;
+    }
+    if (x < -INT16_MAX) {
+        return -INT16_MAX;
+    }
+    if (x > INT16_MAX) {
+        return INT16_MAX;
+    }
+    return x;
+}
+
+
+static void
+fixed_update(struct uproc_substmat_s *mat, unsigned pos, size_t idx)
+{
+    mat->fixed[pos][idx] = fixed_value(mat->dists[pos][idx], mat->scale);
+}
+
 uproc_substmat *
 uproc_substmat_create(void)
 {
@@ -49,7 +105,10 @@ uproc_substmat_create(void)
         uproc_error(UPROC_ENOMEM);
         return NULL;
     }
-    *mat = (struct uproc_substmat_s) { { { 0.0 } } };
+    *mat = (struct uproc_substmat_s) {
+        .absmax = 0.0,
+        .scale = fixed_scale(0.0),
+    };
     return mat;
 }
 
@@ -71,6 +130,45 @@ uproc_substmat_set(uproc_substmat *mat, unsigned pos, uproc_amino x,
         uproc_amino y, double dist)
 {
     mat->dists[pos][SUBSTMAT_INDEX(x, y)] = dist;
+
+    if (isfinite(dist) && fabs(dist) > mat->absmax) {
+        double scale;
+        mat->absmax = fabs(dist);
+        scale = fixed_scale(mat->absmax);
+        /* scale changed, update all fixed-point values */
+        if (scale != mat->scale) {
+            mat->scale = scale;
+            for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+                for (size_t k = 0; k < SUBSTMAT_ROW_LEN; k++) {
+                    fixed_update(mat, i, k);
+                }
+            }
+        }
+    }
+    fixed_update(mat, pos, SUBSTMAT_INDEX(x, y));
+}
+
+double
+uproc_substmat_max(const uproc_substmat *mat)
+{
+    double max = -INFINITY;
+    for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        for (uproc_amino x = 0; x < UPROC_ALPHABET_SIZE; x++) {
+            for (uproc_amino y = 0; y < UPROC_ALPHABET_SIZE; y++) {
+                double d = mat->dists[i][SUBSTMAT_INDEX(x, y)];
+                if (isfinite(d) && d > max) {
+                    max = d;
+                }
+            }
+        }
+    }
+    return max;
+}
+
+double
+uproc_substmat_fixed_scale(const uproc_substmat *mat)
+{
+    return mat->scale;
 }
 
 void
@@ -90,6 +188,23 @@ uproc_substmat_align_suffixes(const uproc_substmat *mat,
     }
 }
 
+void
+uproc_substmat_align_suffixes_fixed(const uproc_substmat *mat,
+                                    uproc_suffix s1, uproc_suffix s2,
+                                    int16_t *dist)
+{
+    size_t i, idx;
+    uproc_amino a1, a2;
+    for (i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        a1 = s1 & UPROC_BITMASK(UPROC_AMINO_BITS);
+        a2 = s2 & UPROC_BITMASK(UPROC_AMINO_BITS);
+        s1 >>= UPROC_AMINO_BITS;
+        s2 >>= UPROC_AMINO_BITS;
+        idx = UPROC_SUFFIX_LEN - i - 1;
+        dist[idx] = mat->fixed[idx][SUBSTMAT_INDEX(a1, a2)];
+    }
+}
+
 uproc_substmat *
 uproc_substmat_loadv(enum uproc_io_type iotype, const char *pathfmt,
                      va_list ap)
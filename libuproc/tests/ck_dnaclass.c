@@ -0,0 +1,309 @@
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "uproc.h"
+
+#define ALPHABET "AGSTPKRQEDNHYWFMLIVC"
+#define N_PREFIXES 500
+#define N_FAMILIES 20
+#define N_SEQS 200
+#define SEQ_LEN_MAX 300
+
+uproc_ecurve *ecurve;
+uproc_substmat *substmat;
+char *seqs[N_SEQS];
+
+/* simple deterministic PRNG, so that the test doesn't depend on rand() */
+static unsigned long long rng_state;
+
+static unsigned long long
+rng(void)
+{
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return rng_state >> 17;
+}
+
+static int
+cmp_suffixentry(const void *p1, const void *p2)
+{
+    const struct uproc_ecurve_suffixentry *e1 = p1, *e2 = p2;
+    return (e1->suffix > e2->suffix) - (e1->suffix < e2->suffix);
+}
+
+void setup(void)
+{
+    uproc_prefix p = 0;
+    uproc_list *list;
+    struct uproc_ecurve_suffixentry buf[16];
+
+    rng_state = 23;
+    ecurve = uproc_ecurve_create_with_index(ALPHABET, 0,
+                                            UPROC_ECURVE_INDEX_COMPACT);
+    ck_assert_ptr_ne(ecurve, NULL);
+    list = uproc_list_create(sizeof *buf);
+    for (int i = 0; i < N_PREFIXES; i++) {
+        size_t n = 1 + rng() % 16;
+        p += 1 + rng() % (UPROC_PREFIX_MAX / N_PREFIXES);
+        for (size_t j = 0; j < n; j++) {
+            buf[j].suffix = 0;
+            for (int k = 0; k < UPROC_SUFFIX_LEN; k++) {
+                buf[j].suffix = (buf[j].suffix << UPROC_AMINO_BITS) |
+                                rng() % UPROC_ALPHABET_SIZE;
+            }
+            /* few families, so that many ORFs predict the same one */
+            buf[j].family = rng() % N_FAMILIES;
+        }
+        qsort(buf, n, sizeof *buf, cmp_suffixentry);
+        uproc_list_clear(list);
+        for (size_t j = 0; j < n; j++) {
+            if (!j || buf[j].suffix != buf[j - 1].suffix) {
+                uproc_list_append(list, &buf[j]);
+            }
+        }
+        ck_assert_int_eq(uproc_ecurve_add_prefix(ecurve, p, list), 0);
+    }
+    ck_assert_int_eq(uproc_ecurve_finalize(ecurve), 0);
+    uproc_list_destroy(list);
+
+    /* few different distances, so that the scores of different families
+     * often tie */
+    substmat = uproc_substmat_create();
+    ck_assert_ptr_ne(substmat, NULL);
+    for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        for (uproc_amino x = 0; x < UPROC_ALPHABET_SIZE; x++) {
+            for (uproc_amino y = 0; y < UPROC_ALPHABET_SIZE; y++) {
+                uproc_substmat_set(substmat, i, x, y,
+                                   rng() % 8 ? 1.0 : -1.0);
+            }
+        }
+    }
+
+    for (int i = 0; i < N_SEQS; i++) {
+        size_t len = rng() % SEQ_LEN_MAX;
+        seqs[i] = malloc(len + 1);
+        for (size_t k = 0; k < len; k++) {
+            seqs[i][k] = rng() % 50 ? "ACGT"[rng() % 4] : 'N';
+        }
+        seqs[i][len] = '\0';
+    }
+}
+
+void teardown(void)
+{
+    uproc_ecurve_destroy(ecurve);
+    uproc_substmat_destroy(substmat);
+    for (int i = 0; i < N_SEQS; i++) {
+        free(seqs[i]);
+    }
+}
+
+static void
+map_list_dnaresult_free(void *value, void *opaque)
+{
+    (void) opaque;
+    uproc_dnaresult_free(value);
+}
+
+static void
+results_destroy(uproc_list *results)
+{
+    if (results) {
+        uproc_list_map(results, map_list_dnaresult_free, NULL);
+        uproc_list_destroy(results);
+    }
+}
+
+static void
+assert_dnaresults_equal(const struct uproc_dnaresult *a,
+                        const struct uproc_dnaresult *b)
+{
+    ck_assert_uint_eq(a->family, b->family);
+    ck_assert(a->score == b->score);
+    ck_assert_uint_eq(a->orf.frame, b->orf.frame);
+    ck_assert_uint_eq(a->orf.start, b->orf.start);
+    ck_assert_uint_eq(a->orf.length, b->orf.length);
+    ck_assert_str_eq(a->orf.data, b->orf.data);
+}
+
+START_TEST(test_max)
+{
+    uproc_protclass *pc;
+    uproc_dnaclass *dc_all, *dc_max;
+    uproc_list *results = NULL, *results_max = NULL;
+    long n_ties = 0;
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+    dc_all = uproc_dnaclass_create(UPROC_DNACLASS_ALL, pc, NULL, NULL, NULL);
+    ck_assert_ptr_ne(dc_all, NULL);
+    dc_max = uproc_dnaclass_create(UPROC_DNACLASS_MAX, pc, NULL, NULL, NULL);
+    ck_assert_ptr_ne(dc_max, NULL);
+
+    for (int i = 0; i < N_SEQS; i++) {
+        struct uproc_dnaresult r, best, r_max;
+        long n;
+        ck_assert_int_eq(uproc_dnaclass_classify(dc_all, seqs[i], &results),
+                         0);
+        ck_assert_int_eq(
+            uproc_dnaclass_classify(dc_max, seqs[i], &results_max), 0);
+
+        /* ALL keeps the first of the best ORFs of each family, so on ties
+         * MAX has to pick the lowest family */
+        n = uproc_list_size(results);
+        ck_assert_int_eq(uproc_list_size(results_max), n ? 1 : 0);
+        if (!n) {
+            continue;
+        }
+        uproc_list_get(results, 0, &best);
+        for (long k = 1; k < n; k++) {
+            uproc_list_get(results, k, &r);
+            if (r.score > best.score ||
+                (r.score == best.score && r.family < best.family)) {
+                best = r;
+            }
+        }
+        uproc_list_get(results_max, 0, &r_max);
+        assert_dnaresults_equal(&r_max, &best);
+
+        for (long k = 0; k < n; k++) {
+            uproc_list_get(results, k, &r);
+            if (r.score == best.score && r.family != best.family) {
+                n_ties++;
+                break;
+            }
+        }
+    }
+    /* the test data is made so that ties happen */
+    ck_assert_int_gt(n_ties, 0);
+
+    results_destroy(results);
+    results_destroy(results_max);
+    uproc_dnaclass_destroy(dc_all);
+    uproc_dnaclass_destroy(dc_max);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+/* The ORFs are classified as amino acid codes, the reported ones have to
+ * be the same as classifying the strings from uproc_orfiter_next() */
+START_TEST(test_orf_strings)
+{
+    uproc_protclass *pc;
+    uproc_dnaclass *dc;
+    uproc_orfiter *iter;
+    uproc_list *results = NULL, *prot_results = NULL;
+    double codon_scores[UPROC_BINARY_CODON_COUNT];
+    long n_results = 0;
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+    dc = uproc_dnaclass_create(UPROC_DNACLASS_ALL, pc, NULL, NULL, NULL);
+    ck_assert_ptr_ne(dc, NULL);
+    uproc_orf_codonscores(codon_scores, NULL);
+
+    for (int i = 0; i < N_SEQS; i++) {
+        struct uproc_orf orf;
+        ck_assert_int_eq(uproc_dnaclass_classify(dc, seqs[i], &results), 0);
+        n_results += uproc_list_size(results);
+
+        iter = uproc_orfiter_create(seqs[i], codon_scores, NULL, NULL);
+        ck_assert_ptr_ne(iter, NULL);
+        while (!uproc_orfiter_next(iter, &orf)) {
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc, orf.data, &prot_results), 0);
+            for (long k = 0, n = uproc_list_size(results); k < n; k++) {
+                struct uproc_dnaresult r;
+                uproc_list_get(results, k, &r);
+                if (r.orf.frame != orf.frame || r.orf.start != orf.start) {
+                    continue;
+                }
+                ck_assert_uint_eq(r.orf.length, orf.length);
+                ck_assert_str_eq(r.orf.data, orf.data);
+                for (long j = 0, m = uproc_list_size(prot_results); j < m;
+                     j++) {
+                    struct uproc_protresult p;
+                    uproc_list_get(prot_results, j, &p);
+                    if (p.family == r.family) {
+                        ck_assert(p.score == r.score);
+                    }
+                }
+            }
+        }
+        uproc_orfiter_destroy(iter);
+    }
+    ck_assert_int_gt(n_results, 0);
+
+    results_destroy(results);
+    uproc_list_destroy(prot_results);
+    uproc_dnaclass_destroy(dc);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+START_TEST(test_many)
+{
+    const enum uproc_dnaclass_mode modes[] = {
+        UPROC_DNACLASS_ALL, UPROC_DNACLASS_MAX, UPROC_DNACLASS_TOP_K,
+    };
+    uproc_protclass *pc;
+    uproc_classify_ctx *ctx;
+    uproc_list *results = NULL, *results_many[N_SEQS] = { NULL };
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+    ctx = uproc_classify_ctx_create();
+    ck_assert_ptr_ne(ctx, NULL);
+
+    for (size_t j = 0; j < sizeof modes / sizeof *modes; j++) {
+        uproc_dnaclass *dc = uproc_dnaclass_create(modes[j], pc, NULL, NULL,
+                                                   NULL);
+        ck_assert_ptr_ne(dc, NULL);
+        uproc_dnaclass_set_top_k(dc, 3);
+        ck_assert_int_eq(
+            uproc_dnaclass_classify_many(dc, ctx, (const char **)seqs,
+                                         N_SEQS, results_many), 0);
+        for (int i = 0; i < N_SEQS; i++) {
+            long n;
+            ck_assert_int_eq(
+                uproc_dnaclass_classify_ctx(dc, ctx, seqs[i], &results), 0);
+            n = uproc_list_size(results);
+            ck_assert_int_eq(uproc_list_size(results_many[i]), n);
+            for (long k = 0; k < n; k++) {
+                struct uproc_dnaresult r, r_many;
+                uproc_list_get(results, k, &r);
+                uproc_list_get(results_many[i], k, &r_many);
+                assert_dnaresults_equal(&r, &r_many);
+            }
+        }
+        uproc_dnaclass_destroy(dc);
+    }
+
+    for (int i = 0; i < N_SEQS; i++) {
+        results_destroy(results_many[i]);
+    }
+    results_destroy(results);
+    uproc_classify_ctx_destroy(ctx);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+int main(void)
+{
+    Suite *s = suite_create("dnaclass");
+
+    TCase *tc = tcase_create("");
+    tcase_add_unchecked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_max);
+    tcase_add_test(tc, test_orf_strings);
+    tcase_add_test(tc, test_many);
+    suite_add_tcase(s, tc);
+
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int n_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
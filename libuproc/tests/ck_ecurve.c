@@ -0,0 +1,620 @@
+#include <stdlib.h>
+#include <unistd.h>
+#include <check.h>
+#include "uproc.h"
+
+#define N_PREFIXES 1000
+#define N_WORDS 5000
+
+/* most buckets are small, but some are large enough to exercise all search
+ * strategies */
+#define BUCKET_MAX 64
+#define LARGE_BUCKET_MAX 5000
+#define LARGE_BUCKET_EVERY 200
+
+uproc_ecurve *ecurve;
+
+/* all entries of `ecurve` in ascending order */
+struct entry {
+    struct uproc_word word;
+    uproc_family family;
+} *entries;
+size_t n_entries;
+
+/* simple deterministic PRNG, so that the test doesn't depend on rand() */
+static unsigned long long rng_state;
+
+static unsigned long long
+rng(void)
+{
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return rng_state >> 17;
+}
+
+static uproc_suffix
+random_suffix(void)
+{
+    uproc_suffix s = 0;
+    for (int i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        s = (s << UPROC_AMINO_BITS) | rng() % UPROC_ALPHABET_SIZE;
+    }
+    return s;
+}
+
+static struct uproc_word
+random_word(void)
+{
+    struct uproc_word w;
+    /* pick a stored word now and then to get exact matches */
+    if (rng() % 4 == 0) {
+        return entries[rng() % n_entries].word;
+    }
+    /* stay close to the stored prefixes most of the time */
+    if (rng() % 2) {
+        w.prefix = entries[rng() % n_entries].word.prefix;
+    }
+    else {
+        w.prefix = rng() % (UPROC_PREFIX_MAX + 1);
+    }
+    w.suffix = random_suffix();
+    return w;
+}
+
+static int
+cmp_suffixentry(const void *p1, const void *p2)
+{
+    const struct uproc_ecurve_suffixentry *e1 = p1, *e2 = p2;
+    return (e1->suffix > e2->suffix) - (e1->suffix < e2->suffix);
+}
+
+static void
+build(enum uproc_ecurve_index index)
+{
+    uproc_prefix p;
+    uproc_list *list;
+    struct uproc_ecurve_suffixentry e, *buf;
+    uproc_family family = 0;
+
+    rng_state = 42;
+    ecurve = uproc_ecurve_create_with_index("AGSTPKRQEDNHYWFMLIVC", 0, index);
+    ck_assert_ptr_ne(ecurve, NULL);
+    list = uproc_list_create(sizeof e);
+    buf = malloc(LARGE_BUCKET_MAX * sizeof *buf);
+    entries = malloc((N_PREFIXES * BUCKET_MAX +
+                      N_PREFIXES / LARGE_BUCKET_EVERY * LARGE_BUCKET_MAX) *
+                     sizeof *entries);
+    n_entries = 0;
+
+    /* leave room below the first and above the last prefix */
+    p = 1000;
+    for (int i = 0; i < N_PREFIXES; i++) {
+        size_t n = 1 + rng() % BUCKET_MAX, k = 0;
+        if (i % LARGE_BUCKET_EVERY == LARGE_BUCKET_EVERY / 2) {
+            n = LARGE_BUCKET_MAX - rng() % 1000;
+        }
+
+        /* sometimes the distance is larger than a pfxtab_neigh can hold */
+        p += 1 + (i % 100 ? rng() % 50000 : 100000);
+        for (size_t j = 0; j < n; j++) {
+            buf[j].suffix = random_suffix();
+        }
+        qsort(buf, n, sizeof *buf, cmp_suffixentry);
+        /* like in real databases, neighbouring suffixes mostly belong to the
+         * same family */
+        for (size_t j = 0; j < n; j++) {
+            if (rng() % 8 == 0) {
+                family = rng() % 100;
+            }
+            buf[j].family = family;
+        }
+        uproc_list_clear(list);
+        for (size_t j = 0; j < n; j++) {
+            if (j && buf[j].suffix == buf[j - 1].suffix) {
+                continue;
+            }
+            uproc_list_append(list, &buf[j]);
+            entries[n_entries + k].word.prefix = p;
+            entries[n_entries + k].word.suffix = buf[j].suffix;
+            entries[n_entries + k].family = buf[j].family;
+            k++;
+        }
+        n_entries += k;
+        ck_assert_int_eq(uproc_ecurve_add_prefix(ecurve, p, list), 0);
+    }
+    ck_assert_int_eq(uproc_ecurve_finalize(ecurve), 0);
+    uproc_list_destroy(list);
+    free(buf);
+}
+
+void setup(void)
+{
+    build(UPROC_ECURVE_INDEX_TABLE);
+}
+
+void setup_compact(void)
+{
+    build(UPROC_ECURVE_INDEX_COMPACT);
+    ck_assert_int_eq(uproc_ecurve_index_type(ecurve),
+                     UPROC_ECURVE_INDEX_COMPACT);
+}
+
+void setup_direct(void)
+{
+    build(UPROC_ECURVE_INDEX_DIRECT);
+    ck_assert_int_eq(uproc_ecurve_index_type(ecurve),
+                     UPROC_ECURVE_INDEX_DIRECT);
+}
+
+void setup_compressed(void)
+{
+    build(UPROC_ECURVE_INDEX_COMPACT);
+    ck_assert_int_eq(uproc_ecurve_compress(ecurve), 0);
+    ck_assert_int_ne(uproc_ecurve_is_compressed(ecurve), 0);
+}
+
+void teardown(void)
+{
+    uproc_ecurve_destroy(ecurve);
+    free(entries);
+}
+
+/* Reference implementation of uproc_ecurve_lookup() */
+static int
+lookup_reference(const struct uproc_word *word, size_t *lower, size_t *upper)
+{
+    size_t lo = 0, hi = n_entries, first, last;
+
+    /* find the first entry that is not less than `word` */
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        if (uproc_word_cmp(&entries[mid].word, word) < 0) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    if (lo < n_entries && !uproc_word_cmp(&entries[lo].word, word)) {
+        *lower = *upper = lo;
+        return UPROC_ECURVE_EXACT;
+    }
+
+    first = lo;
+    while (first > 0 && entries[first - 1].word.prefix == word->prefix) {
+        first--;
+    }
+    last = lo;
+    while (last < n_entries && entries[last].word.prefix == word->prefix) {
+        last++;
+    }
+    /* prefix present, but suffix outside of the stored range */
+    if (first == lo && last > lo) {
+        *lower = *upper = lo;
+        return UPROC_ECURVE_INEXACT;
+    }
+    if (last == lo && first < lo) {
+        *lower = *upper = lo - 1;
+        return UPROC_ECURVE_INEXACT;
+    }
+
+    if (lo == 0) {
+        *lower = *upper = 0;
+        return UPROC_ECURVE_OOB;
+    }
+    if (lo == n_entries) {
+        *lower = *upper = n_entries - 1;
+        return UPROC_ECURVE_OOB;
+    }
+    *lower = lo - 1;
+    *upper = lo;
+    return UPROC_ECURVE_INEXACT;
+}
+
+START_TEST(test_lookup_exact)
+{
+    int res;
+    struct uproc_word lower_nb, upper_nb;
+    uproc_family lower_fam, upper_fam;
+
+    for (size_t i = 0; i < n_entries; i++) {
+        res = uproc_ecurve_lookup(ecurve, &entries[i].word,
+                                  &lower_nb, &lower_fam, &upper_nb, &upper_fam);
+        ck_assert_int_eq(res, UPROC_ECURVE_EXACT);
+        ck_assert_int_eq(uproc_word_cmp(&lower_nb, &entries[i].word), 0);
+        ck_assert_int_eq(uproc_word_cmp(&upper_nb, &entries[i].word), 0);
+        ck_assert_uint_eq(lower_fam, entries[i].family);
+        ck_assert_uint_eq(upper_fam, entries[i].family);
+    }
+}
+END_TEST
+
+static void
+check_lookups(const uproc_ecurve *ec)
+{
+    int res, res_ref;
+    size_t lower, upper;
+    struct uproc_word word, lower_nb, upper_nb;
+    uproc_family lower_fam, upper_fam;
+
+    /* words outside of the stored range */
+    word.prefix = 0;
+    word.suffix = 0;
+    res = uproc_ecurve_lookup(ec, &word,
+                              &lower_nb, &lower_fam, &upper_nb, &upper_fam);
+    ck_assert_int_eq(res, UPROC_ECURVE_OOB);
+    ck_assert_int_eq(uproc_word_cmp(&lower_nb, &entries[0].word), 0);
+
+    word.prefix = UPROC_PREFIX_MAX;
+    res = uproc_ecurve_lookup(ec, &word,
+                              &lower_nb, &lower_fam, &upper_nb, &upper_fam);
+    ck_assert_int_eq(res, UPROC_ECURVE_OOB);
+    ck_assert_int_eq(
+        uproc_word_cmp(&upper_nb, &entries[n_entries - 1].word), 0);
+
+    for (int i = 0; i < N_WORDS; i++) {
+        word = random_word();
+        res_ref = lookup_reference(&word, &lower, &upper);
+        res = uproc_ecurve_lookup(ec, &word,
+                                  &lower_nb, &lower_fam, &upper_nb, &upper_fam);
+        ck_assert_int_eq(res, res_ref);
+        ck_assert_int_eq(uproc_word_cmp(&lower_nb, &entries[lower].word), 0);
+        ck_assert_int_eq(uproc_word_cmp(&upper_nb, &entries[upper].word), 0);
+        ck_assert_uint_eq(lower_fam, entries[lower].family);
+        ck_assert_uint_eq(upper_fam, entries[upper].family);
+    }
+}
+
+START_TEST(test_lookup)
+{
+    check_lookups(ecurve);
+}
+END_TEST
+
+START_TEST(test_lookup_batch)
+{
+    /* not a multiple of the internal batch size */
+    enum { N = 1001 };
+    static struct uproc_word words[N], lower_nb[N], upper_nb[N];
+    static uproc_family lower_fam[N], upper_fam[N];
+    static int results[N];
+
+    for (int i = 0; i < N; i++) {
+        words[i] = random_word();
+    }
+    ck_assert_int_eq(
+        uproc_ecurve_lookup_batch(ecurve, words, N, lower_nb, lower_fam,
+                                  upper_nb, upper_fam, results),
+        0);
+
+    for (int i = 0; i < N; i++) {
+        int res;
+        struct uproc_word l, u;
+        uproc_family lf, uf;
+        res = uproc_ecurve_lookup(ecurve, &words[i], &l, &lf, &u, &uf);
+        ck_assert_int_eq(results[i], res);
+        ck_assert_int_eq(uproc_word_cmp(&lower_nb[i], &l), 0);
+        ck_assert_int_eq(uproc_word_cmp(&upper_nb[i], &u), 0);
+        ck_assert_uint_eq(lower_fam[i], lf);
+        ck_assert_uint_eq(upper_fam[i], uf);
+    }
+}
+END_TEST
+
+static int
+cmp_word(const void *p1, const void *p2)
+{
+    return uproc_word_cmp(p1, p2);
+}
+
+START_TEST(test_lookup_sorted)
+{
+    enum { N = 1001 };
+    static struct uproc_word words[N], lower_nb[N], upper_nb[N];
+    static uproc_family lower_fam[N], upper_fam[N];
+    static int results[N];
+
+    for (int i = 0; i < N; i++) {
+        words[i] = random_word();
+        /* several words per prefix, and some of them repeated */
+        if (i && rng() % 4 == 0) {
+            words[i].prefix = words[i - 1].prefix;
+            if (rng() % 2) {
+                words[i].suffix = words[i - 1].suffix;
+            }
+        }
+    }
+    /* beyond the first and last stored prefixes */
+    words[0].prefix = words[1].prefix = 0;
+    words[2].prefix = words[3].prefix = UPROC_PREFIX_MAX;
+    /* sorted, then the unsorted part has to give the same results */
+    qsort(words, N / 2, sizeof *words, cmp_word);
+    ck_assert_int_eq(
+        uproc_ecurve_lookup_sorted(ecurve, words, N, lower_nb, lower_fam,
+                                   upper_nb, upper_fam, results),
+        0);
+
+    for (int i = 0; i < N; i++) {
+        int res;
+        struct uproc_word l, u;
+        uproc_family lf, uf;
+        res = uproc_ecurve_lookup(ecurve, &words[i], &l, &lf, &u, &uf);
+        ck_assert_int_eq(results[i], res);
+        ck_assert_int_eq(uproc_word_cmp(&lower_nb[i], &l), 0);
+        ck_assert_int_eq(uproc_word_cmp(&upper_nb[i], &u), 0);
+        ck_assert_uint_eq(lower_fam[i], lf);
+        ck_assert_uint_eq(upper_fam[i], uf);
+    }
+}
+END_TEST
+
+START_TEST(test_store_load)
+{
+    int res;
+    uproc_ecurve *ec;
+
+    res = uproc_ecurve_store(ecurve, UPROC_ECURVE_BINARY, UPROC_IO_STDIO,
+                             TMPDATADIR "test.ecurve");
+    ck_assert_msg(res == 0, "storing ecurve failed");
+    ec = uproc_ecurve_load(UPROC_ECURVE_BINARY, UPROC_IO_STDIO,
+                           TMPDATADIR "test.ecurve");
+    ck_assert_ptr_ne(ec, NULL);
+    check_lookups(ec);
+    uproc_ecurve_destroy(ec);
+
+    res = uproc_ecurve_store(ecurve, UPROC_ECURVE_PLAIN, UPROC_IO_GZIP,
+                             TMPDATADIR "test.ecurve.plain");
+    ck_assert_msg(res == 0, "storing ecurve failed");
+    ec = uproc_ecurve_load(UPROC_ECURVE_PLAIN, UPROC_IO_GZIP,
+                           TMPDATADIR "test.ecurve.plain");
+    ck_assert_ptr_ne(ec, NULL);
+    check_lookups(ec);
+    uproc_ecurve_destroy(ec);
+}
+END_TEST
+
+START_TEST(test_mmap_opts)
+{
+    int res;
+    uproc_ecurve *ec;
+    struct uproc_ecurve_mmap_opts opts = UPROC_ECURVE_MMAP_OPTS_INITIALIZER;
+    enum uproc_ecurve_mmap_mode modes[] = {
+        UPROC_ECURVE_MMAP_LAZY,
+        UPROC_ECURVE_MMAP_POPULATE,
+        UPROC_ECURVE_MMAP_PREFAULT,
+    };
+
+    if (!uproc_features_mmap()) {
+        return;
+    }
+    res = uproc_ecurve_mmap_store(ecurve, TMPDATADIR "test.ecurve");
+    ck_assert_msg(res == 0, "storing ecurve failed");
+
+    for (int i = 0; i < 2 * sizeof modes / sizeof *modes; i++) {
+        opts.mode = modes[i / 2];
+        opts.threads = 2;
+        opts.hugepage = i % 2;
+        ec = uproc_ecurve_mmapo(&opts, TMPDATADIR "test.ecurve");
+        ck_assert_ptr_ne(ec, NULL);
+        check_lookups(ec);
+        uproc_ecurve_destroy(ec);
+    }
+}
+END_TEST
+
+START_TEST(test_shm)
+{
+    int res;
+    uproc_ecurve *ec;
+    long id = getpid();
+
+    if (!uproc_features_shm()) {
+        return;
+    }
+    res = uproc_ecurve_store_shm(ecurve, false, "/ck_ecurve.%ld", id);
+    ck_assert_msg(res == 0, "storing ecurve failed");
+    res = uproc_ecurve_store_shm(ecurve, false, "/ck_ecurve.%ld", id);
+    ck_assert_msg(res == -1 && uproc_errno == UPROC_EEXIST,
+                  "existing object was overwritten");
+
+    ec = uproc_ecurve_attach_shm(NULL, "/ck_ecurve.%ld", id);
+    ck_assert_ptr_ne(ec, NULL);
+    res = uproc_ecurve_unlink_shm("/ck_ecurve.%ld", id);
+    ck_assert_msg(res == 0, "removing ecurve failed");
+
+    /* still usable after the object was removed */
+    check_lookups(ec);
+    uproc_ecurve_destroy(ec);
+
+    ec = uproc_ecurve_attach_shm(NULL, "/ck_ecurve.%ld", id);
+    ck_assert_ptr_eq(ec, NULL);
+}
+END_TEST
+
+START_TEST(test_numa_copy)
+{
+    uproc_ecurve *ec;
+
+    if (!uproc_features_numa() || !uproc_numa_nodes()) {
+        return;
+    }
+    ec = uproc_ecurve_numa_copy(ecurve, uproc_numa_nodes() - 1);
+    ck_assert_ptr_ne(ec, NULL);
+    check_lookups(ec);
+    uproc_ecurve_destroy(ec);
+
+    ec = uproc_ecurve_numa_copy(ecurve, -1);
+    ck_assert_ptr_ne(ec, NULL);
+    check_lookups(ec);
+    uproc_ecurve_destroy(ec);
+
+    ec = uproc_ecurve_numa_copy(ecurve, uproc_numa_nodes());
+    ck_assert_ptr_eq(ec, NULL);
+}
+END_TEST
+
+START_TEST(test_container)
+{
+    int res;
+    uproc_container *c;
+    uproc_ecurve *ec;
+    uproc_idmap *idmap, *idmap2;
+    uproc_matrix *matrix, *matrix2;
+    uproc_substmat *substmat, *substmat2;
+    double values[] = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0 };
+    unsigned long rows, cols;
+
+    if (!uproc_features_mmap()) {
+        return;
+    }
+    idmap = uproc_idmap_create();
+    uproc_idmap_family(idmap, "foo");
+    uproc_idmap_family(idmap, "bar");
+    matrix = uproc_matrix_create(2, 3, values);
+    substmat = uproc_substmat_create();
+    uproc_substmat_set(substmat, 1, 2, 3, 0.5);
+
+    c = uproc_container_create();
+    ck_assert_ptr_ne(c, NULL);
+    res = uproc_container_add_ecurve(c, "ecurve", ecurve);
+    res |= uproc_container_add_idmap(c, "idmap", idmap);
+    res |= uproc_container_add_matrix(c, "matrix", matrix);
+    res |= uproc_container_add_substmat(c, "substmat", substmat);
+    ck_assert_msg(res == 0, "adding objects failed");
+    res = uproc_container_add_matrix(c, "matrix", matrix);
+    ck_assert_msg(res == -1 && uproc_errno == UPROC_EEXIST,
+                  "duplicate section name accepted");
+    res = uproc_container_store(c, TMPDATADIR "test.container");
+    ck_assert_msg(res == 0, "storing container failed");
+    uproc_container_destroy(c);
+
+    c = uproc_container_mmap(NULL, TMPDATADIR "test.container");
+    ck_assert_ptr_ne(c, NULL);
+    ec = uproc_container_ecurve(c, "ecurve");
+    ck_assert_ptr_ne(ec, NULL);
+    check_lookups(ec);
+    uproc_ecurve_destroy(ec);
+
+    idmap2 = uproc_container_idmap(c, "idmap");
+    ck_assert_ptr_ne(idmap2, NULL);
+    ck_assert_str_eq(uproc_idmap_str(idmap2, 1), "bar");
+    ck_assert_int_eq(uproc_idmap_family(idmap2, "foo"), 0);
+    uproc_idmap_destroy(idmap2);
+
+    matrix2 = uproc_container_matrix(c, "matrix");
+    ck_assert_ptr_ne(matrix2, NULL);
+    uproc_matrix_dimensions(matrix2, &rows, &cols);
+    ck_assert_int_eq(rows, 2);
+    ck_assert_int_eq(cols, 3);
+    ck_assert(uproc_matrix_get(matrix2, 1, 2) == 6.0);
+    uproc_matrix_destroy(matrix2);
+
+    substmat2 = uproc_container_substmat(c, "substmat");
+    ck_assert_ptr_ne(substmat2, NULL);
+    ck_assert(uproc_substmat_get(substmat2, 1, 2, 3) == 0.5);
+    uproc_substmat_destroy(substmat2);
+
+    ck_assert_ptr_eq(uproc_container_matrix(c, "idmap"), NULL);
+    ck_assert_int_eq(uproc_errno, UPROC_EINVAL);
+    ck_assert_ptr_eq(uproc_container_matrix(c, "nope"), NULL);
+    ck_assert_int_eq(uproc_errno, UPROC_ENOENT);
+    uproc_container_destroy(c);
+
+    c = uproc_container_mmap(NULL, DATADIR "no_such_file");
+    ck_assert_ptr_eq(c, NULL);
+
+    uproc_idmap_destroy(idmap);
+    uproc_matrix_destroy(matrix);
+    uproc_substmat_destroy(substmat);
+}
+END_TEST
+
+START_TEST(test_compress_fallback)
+{
+    uproc_ecurve *ec;
+    uproc_list *list;
+    struct uproc_ecurve_suffixentry e;
+    struct uproc_word w = { .prefix = 1234 }, lower, upper;
+    uproc_family lower_family, upper_family;
+
+    /* every suffix starts a new run, so the encoding isn't smaller */
+    ec = uproc_ecurve_create("AGSTPKRQEDNHYWFMLIVC", 0);
+    ck_assert_ptr_ne(ec, NULL);
+    list = uproc_list_create(sizeof e);
+    for (int i = 0; i < 4; i++) {
+        e.suffix = 100 * i;
+        e.family = i % 2;
+        uproc_list_append(list, &e);
+    }
+    ck_assert_int_eq(uproc_ecurve_add_prefix(ec, w.prefix, list), 0);
+    ck_assert_int_eq(uproc_ecurve_finalize(ec), 0);
+    uproc_list_destroy(list);
+
+    ck_assert_int_eq(uproc_ecurve_compress(ec), 0);
+    ck_assert_int_eq(uproc_ecurve_is_compressed(ec), 0);
+    for (int i = 0; i < 4; i++) {
+        w.suffix = 100 * i;
+        ck_assert_int_eq(uproc_ecurve_lookup(ec, &w, &lower, &lower_family,
+                                             &upper, &upper_family),
+                         UPROC_ECURVE_EXACT);
+        ck_assert_uint_eq(lower_family, i % 2);
+    }
+    uproc_ecurve_destroy(ec);
+}
+END_TEST
+
+int main(void)
+{
+    Suite *s = suite_create("ecurve");
+
+    TCase *tc = tcase_create("lookup");
+    tcase_add_unchecked_fixture(tc, setup, teardown);
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_lookup_exact);
+    tcase_add_test(tc, test_lookup);
+    tcase_add_test(tc, test_lookup_batch);
+    tcase_add_test(tc, test_lookup_sorted);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("compact index");
+    tcase_add_unchecked_fixture(tc, setup_compact, teardown);
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_lookup_exact);
+    tcase_add_test(tc, test_lookup);
+    tcase_add_test(tc, test_lookup_batch);
+    tcase_add_test(tc, test_lookup_sorted);
+    tcase_add_test(tc, test_store_load);
+    tcase_add_test(tc, test_mmap_opts);
+    tcase_add_test(tc, test_shm);
+    tcase_add_test(tc, test_numa_copy);
+    tcase_add_test(tc, test_container);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("compressed");
+    tcase_add_unchecked_fixture(tc, setup_compressed, teardown);
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_lookup_exact);
+    tcase_add_test(tc, test_lookup);
+    tcase_add_test(tc, test_lookup_batch);
+    tcase_add_test(tc, test_lookup_sorted);
+    tcase_add_test(tc, test_store_load);
+    tcase_add_test(tc, test_numa_copy);
+    tcase_add_test(tc, test_container);
+    tcase_add_test(tc, test_compress_fallback);
+    suite_add_tcase(s, tc);
+
+    tc = tcase_create("direct index");
+    tcase_add_unchecked_fixture(tc, setup_direct, teardown);
+    tcase_set_timeout(tc, 30);
+    tcase_add_test(tc, test_lookup_exact);
+    tcase_add_test(tc, test_lookup);
+    tcase_add_test(tc, test_lookup_batch);
+    tcase_add_test(tc, test_lookup_sorted);
+    suite_add_tcase(s, tc);
+
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int n_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,193 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+#include "uproc.h"
+#include "../codon_tables.h"
+
+struct expected_orf
+{
+    unsigned frame;
+    size_t start;
+    const char *data;
+};
+
+/* Assert that `iter` yields exactly the `n` ORFs of `expected`, in order */
+static void
+assert_orfs(uproc_orfiter *iter, const struct expected_orf *expected,
+            size_t n)
+{
+    struct uproc_orf orf;
+    for (size_t i = 0; i < n; i++) {
+        ck_assert_int_eq(uproc_orfiter_next(iter, &orf), 0);
+        ck_assert_uint_eq(orf.frame, expected[i].frame);
+        ck_assert_uint_eq(orf.start, expected[i].start);
+        ck_assert_str_eq(orf.data, expected[i].data);
+        ck_assert_uint_eq(orf.length, strlen(expected[i].data));
+    }
+    ck_assert_int_eq(uproc_orfiter_next(iter, &orf), 1);
+}
+
+/*  frame 0:  ATG GCC AAG TAA GGT   M A K * G
+ *  frame 1:  TGG CCA AGT AAG GTN   W P S K V (last nt guessed)
+ *  frame 2:  GGC CAA GTA AGG       G Q V R
+ * The complementary frames are read from the reverse complement of the same
+ * codons, e.g. frame 3: ACC TTA CTT GGC CAT   T L L G H */
+static const char *seq_plain = "ATGGCCAAGTAAGGT";
+static const struct expected_orf orfs_plain[] = {
+    { 0, 0, "MAK" },
+    { 0, 12, "G" },
+    { 3, 0, "TLLGH" },
+    { 1, 1, "WPSKV" },
+    { 4, 1, "LTWP" },
+    { 2, 2, "GQVR" },
+    { 5, 2, "PYLA" },
+};
+
+/* Lower case, and wildcards which are chopped off the ends of an ORF but
+ * kept inside of it */
+static const char *seq_wildcards = "NNNatgtgattacgtNNNCTA";
+static const struct expected_orf orfs_wildcards[] = {
+    { 0, 0, "M" },
+    { 3, 0, "SH" },
+    { 3, 12, "T" },
+    { 0, 9, "LRXL" },
+    { 1, 1, "CDYV" },
+    { 4, 1, "VIT" },
+    { 2, 2, "VIT" },
+    { 5, 2, "RNH" },
+};
+
+/* The reverse complement of ATGAAACCCTAA, so that MKP is on frame 3 */
+static const char *seq_complement = "TTAGGGTTTCAT";
+static const struct expected_orf orfs_complement[] = {
+    { 5, 2, "NP" },
+    { 0, 0, "LGFH" },
+    { 3, 3, "MKP" },
+    { 1, 4, "GF" },
+    { 4, 1, "ETL" },
+    { 2, 2, "RVS" },
+};
+
+#define ASSERT_ORFS(iter, orfs) \
+    assert_orfs(iter, orfs, sizeof orfs / sizeof *orfs)
+
+START_TEST(test_known)
+{
+    uproc_orfiter *iter;
+
+    iter = uproc_orfiter_create(seq_plain, NULL, NULL, NULL);
+    ck_assert_ptr_ne(iter, NULL);
+    ASSERT_ORFS(iter, orfs_plain);
+    uproc_orfiter_destroy(iter);
+
+    iter = uproc_orfiter_create(seq_wildcards, NULL, NULL, NULL);
+    ck_assert_ptr_ne(iter, NULL);
+    ASSERT_ORFS(iter, orfs_wildcards);
+    uproc_orfiter_destroy(iter);
+
+    iter = uproc_orfiter_create(seq_complement, NULL, NULL, NULL);
+    ck_assert_ptr_ne(iter, NULL);
+    ASSERT_ORFS(iter, orfs_complement);
+    uproc_orfiter_destroy(iter);
+}
+END_TEST
+
+START_TEST(test_reset)
+{
+    uproc_orfiter *iter;
+    struct uproc_orf orf;
+    char *seq_long = malloc(30001);
+    ck_assert_ptr_ne(seq_long, NULL);
+    for (int i = 0; i < 30000; i++) {
+        seq_long[i] = "ACGT"[i * 7 % 11 % 4];
+    }
+    seq_long[30000] = '\0';
+
+    /* the buffers grown for the long sequence are kept */
+    iter = uproc_orfiter_create(seq_long, NULL, NULL, NULL);
+    ck_assert_ptr_ne(iter, NULL);
+    while (!uproc_orfiter_next(iter, &orf)) {
+        ck_assert_uint_eq(strlen(orf.data), orf.length);
+    }
+    uproc_orfiter_reset(iter, seq_plain, NULL, NULL, NULL);
+    ASSERT_ORFS(iter, orfs_plain);
+    uproc_orfiter_reset(iter, seq_complement, NULL, NULL, NULL);
+    ASSERT_ORFS(iter, orfs_complement);
+    uproc_orfiter_reset(iter, seq_long, NULL, NULL, NULL);
+    while (!uproc_orfiter_next(iter, &orf)) {
+        ck_assert_uint_eq(strlen(orf.data), orf.length);
+    }
+    uproc_orfiter_destroy(iter);
+    free(seq_long);
+}
+END_TEST
+
+static bool
+filter(const struct uproc_orf *orf, const char *seq, size_t seq_len,
+       double seq_gc, void *arg)
+{
+    (void) seq;
+    (void) seq_len;
+    (void) seq_gc;
+    return orf->length >= *(size_t *)arg;
+}
+
+START_TEST(test_filter)
+{
+    size_t min_length = 4;
+    const struct expected_orf orfs[] = {
+        { 3, 0, "TLLGH" },
+        { 1, 1, "WPSKV" },
+        { 4, 1, "LTWP" },
+        { 2, 2, "GQVR" },
+        { 5, 2, "PYLA" },
+    };
+    uproc_orfiter *iter = uproc_orfiter_create(seq_plain, NULL, filter,
+                                               &min_length);
+    ck_assert_ptr_ne(iter, NULL);
+    ASSERT_ORFS(iter, orfs);
+    uproc_orfiter_destroy(iter);
+}
+END_TEST
+
+START_TEST(test_translation)
+{
+    /* the combined table agrees with the separate ones for every codon,
+     * including those with wildcards */
+    for (uproc_codon c = 0; c < UPROC_BINARY_CODON_COUNT; c++) {
+        int t = CODON_TRANSLATION(c);
+        uproc_codon rev = CODON_COMPLEMENT(c);
+        ck_assert_uint_eq(TRANSLATION_COMPLEMENT(t), rev);
+        ck_assert(!TRANSLATION_IS_STOP(t) == !CODON_IS_STOP(c));
+        ck_assert(!TRANSLATION_COMPLEMENT_IS_STOP(t) == !CODON_IS_STOP(rev));
+        if (!CODON_IS_STOP(c)) {
+            ck_assert_int_eq(TRANSLATION_CHAR(t), CODON_TO_CHAR(c));
+        }
+        if (!CODON_IS_STOP(rev)) {
+            ck_assert_int_eq(TRANSLATION_COMPLEMENT_CHAR(t),
+                             CODON_TO_CHAR(rev));
+        }
+    }
+}
+END_TEST
+
+int main(void)
+{
+    (void) char_to_nt;
+
+    Suite *s = suite_create("orf");
+
+    TCase *tc = tcase_create("");
+    tcase_add_test(tc, test_known);
+    tcase_add_test(tc, test_reset);
+    tcase_add_test(tc, test_filter);
+    tcase_add_test(tc, test_translation);
+    suite_add_tcase(s, tc);
+
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int n_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
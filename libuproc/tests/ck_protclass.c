@@ -0,0 +1,534 @@
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <check.h>
+#include "uproc.h"
+
+#define ALPHABET "AGSTPKRQEDNHYWFMLIVC"
+#define N_PREFIXES 500
+#define N_SEQS 200
+#define SEQ_LEN_MAX 600
+
+uproc_ecurve *ecurve;
+uproc_substmat *substmat;
+char *seqs[N_SEQS];
+
+/* simple deterministic PRNG, so that the test doesn't depend on rand() */
+static unsigned long long rng_state;
+
+static unsigned long long
+rng(void)
+{
+    rng_state = rng_state * 6364136223846793005ULL + 1442695040888963407ULL;
+    return rng_state >> 17;
+}
+
+static int
+cmp_suffixentry(const void *p1, const void *p2)
+{
+    const struct uproc_ecurve_suffixentry *e1 = p1, *e2 = p2;
+    return (e1->suffix > e2->suffix) - (e1->suffix < e2->suffix);
+}
+
+void setup(void)
+{
+    uproc_prefix p = 0;
+    uproc_list *list;
+    struct uproc_ecurve_suffixentry buf[16];
+
+    rng_state = 42;
+    /* the compact index avoids walking the long runs of empty prefixes */
+    ecurve = uproc_ecurve_create_with_index(ALPHABET, 0,
+                                            UPROC_ECURVE_INDEX_COMPACT);
+    ck_assert_ptr_ne(ecurve, NULL);
+    list = uproc_list_create(sizeof *buf);
+    for (int i = 0; i < N_PREFIXES; i++) {
+        size_t n = 1 + rng() % 16;
+        p += 1 + rng() % (UPROC_PREFIX_MAX / N_PREFIXES);
+        for (size_t j = 0; j < n; j++) {
+            buf[j].suffix = 0;
+            for (int k = 0; k < UPROC_SUFFIX_LEN; k++) {
+                buf[j].suffix = (buf[j].suffix << UPROC_AMINO_BITS) |
+                                rng() % UPROC_ALPHABET_SIZE;
+            }
+            buf[j].family = rng() % 50;
+        }
+        qsort(buf, n, sizeof *buf, cmp_suffixentry);
+        uproc_list_clear(list);
+        for (size_t j = 0; j < n; j++) {
+            if (!j || buf[j].suffix != buf[j - 1].suffix) {
+                uproc_list_append(list, &buf[j]);
+            }
+        }
+        ck_assert_int_eq(uproc_ecurve_add_prefix(ecurve, p, list), 0);
+    }
+    ck_assert_int_eq(uproc_ecurve_finalize(ecurve), 0);
+    uproc_list_destroy(list);
+
+    substmat = uproc_substmat_create();
+    ck_assert_ptr_ne(substmat, NULL);
+    for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        for (uproc_amino x = 0; x < UPROC_ALPHABET_SIZE; x++) {
+            for (uproc_amino y = 0; y < UPROC_ALPHABET_SIZE; y++) {
+                double d = (rng() % 6000) / 1000.0 - 3.0;
+                uproc_substmat_set(substmat, i, x, y, d);
+            }
+        }
+    }
+
+    for (int i = 0; i < N_SEQS; i++) {
+        size_t len = UPROC_WORD_LEN + rng() % SEQ_LEN_MAX;
+        seqs[i] = malloc(len + 1);
+        for (size_t k = 0; k < len; k++) {
+            /* an invalid character now and then */
+            seqs[i][k] = rng() % 100 ? ALPHABET[rng() % 20] : '*';
+        }
+        seqs[i][len] = '\0';
+    }
+}
+
+void teardown(void)
+{
+    uproc_ecurve_destroy(ecurve);
+    uproc_substmat_destroy(substmat);
+    for (int i = 0; i < N_SEQS; i++) {
+        free(seqs[i]);
+    }
+}
+
+/* Assert that `a` and `b` contain the same families, with scores that
+ * differ by at most `tol` */
+static void
+assert_results_equal(uproc_list *a, uproc_list *b, double tol)
+{
+    long n = uproc_list_size(a);
+    ck_assert_int_eq(uproc_list_size(b), n);
+    for (long k = 0; k < n; k++) {
+        struct uproc_protresult ra, rb;
+        uproc_list_get(a, k, &ra);
+        uproc_list_get(b, k, &rb);
+        ck_assert_uint_eq(ra.family, rb.family);
+        ck_assert(fabs(ra.score - rb.score) <= tol);
+    }
+}
+
+START_TEST(test_fixed_scale)
+{
+    /* all distances are in [-3, 3), so 3 * scale must fit into 15 bits, but
+     * 6 * scale must not */
+    double scale = uproc_substmat_fixed_scale(substmat);
+    ck_assert(3.0 * scale <= INT16_MAX);
+    ck_assert(6.0 * scale > INT16_MAX);
+
+    uproc_suffix s1 = 0, s2 = 0;
+    double dist[UPROC_SUFFIX_LEN];
+    int16_t fixed_dist[UPROC_SUFFIX_LEN];
+    for (int k = 0; k < UPROC_SUFFIX_LEN; k++) {
+        s1 = (s1 << UPROC_AMINO_BITS) | k;
+        s2 = (s2 << UPROC_AMINO_BITS) | (k * 7 % UPROC_ALPHABET_SIZE);
+    }
+    uproc_substmat_align_suffixes(substmat, s1, s2, dist);
+    uproc_substmat_align_suffixes_fixed(substmat, s1, s2, fixed_dist);
+    for (int k = 0; k < UPROC_SUFFIX_LEN; k++) {
+        ck_assert(fabs(fixed_dist[k] - dist[k] * scale) <= 0.5);
+    }
+}
+END_TEST
+
+START_TEST(test_fixed)
+{
+    uproc_protclass *pc;
+    uproc_list *results = NULL, *results_fixed = NULL;
+    double scale = uproc_substmat_fixed_scale(substmat);
+    long n_total = 0;
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+
+    for (int i = 0; i < N_SEQS; i++) {
+        /* the documented bound for the error of the fixed-point scores */
+        double tolerance = strlen(seqs[i]) * 0.5 / scale;
+
+        uproc_protclass_set_fixed(pc, false);
+        ck_assert_int_eq(
+            uproc_protclass_classify(pc, seqs[i], &results), 0);
+        uproc_protclass_set_fixed(pc, true);
+        ck_assert_int_eq(
+            uproc_protclass_classify(pc, seqs[i], &results_fixed), 0);
+
+        n_total += uproc_list_size(results);
+        assert_results_equal(results, results_fixed, tolerance);
+    }
+    ck_assert_int_gt(n_total, 0);
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_fixed);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+START_TEST(test_fixed_inf)
+{
+    uproc_substmat *mat = uproc_substmat_create();
+    uproc_protclass *pc;
+    uproc_list *results = NULL, *results_fixed = NULL;
+    long n_total = 0;
+    ck_assert_ptr_ne(mat, NULL);
+
+    /* every fourth distance is -INFINITY, which doesn't add to a score */
+    for (unsigned i = 0; i < UPROC_SUFFIX_LEN; i++) {
+        for (uproc_amino x = 0; x < UPROC_ALPHABET_SIZE; x++) {
+            for (uproc_amino y = 0; y < UPROC_ALPHABET_SIZE; y++) {
+                double d = uproc_substmat_get(substmat, i, x, y);
+                uproc_substmat_set(mat, i, x, y, rng() % 4 ? d : -INFINITY);
+            }
+        }
+    }
+    double scale = uproc_substmat_fixed_scale(mat);
+
+    uproc_suffix s1 = 0, s2 = 0;
+    double dist[UPROC_SUFFIX_LEN];
+    int16_t fixed_dist[UPROC_SUFFIX_LEN];
+    for (int k = 0; k < UPROC_SUFFIX_LEN; k++) {
+        s1 = (s1 << UPROC_AMINO_BITS) | (k * 3 % UPROC_ALPHABET_SIZE);
+        s2 = (s2 << UPROC_AMINO_BITS) | (k * 5 % UPROC_ALPHABET_SIZE);
+    }
+    uproc_substmat_align_suffixes(mat, s1, s2, dist);
+    uproc_substmat_align_suffixes_fixed(mat, s1, s2, fixed_dist);
+    for (int k = 0; k < UPROC_SUFFIX_LEN; k++) {
+        ck_assert(isfinite(dist[k]) == (fixed_dist[k] != INT16_MIN));
+    }
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, mat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+    for (int i = 0; i < N_SEQS; i++) {
+        double tolerance = strlen(seqs[i]) * 0.5 / scale;
+
+        uproc_protclass_set_fixed(pc, false);
+        ck_assert_int_eq(
+            uproc_protclass_classify(pc, seqs[i], &results), 0);
+        uproc_protclass_set_fixed(pc, true);
+        ck_assert_int_eq(
+            uproc_protclass_classify(pc, seqs[i], &results_fixed), 0);
+
+        n_total += uproc_list_size(results);
+        assert_results_equal(results, results_fixed, tolerance);
+    }
+    ck_assert_int_gt(n_total, 0);
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_fixed);
+    uproc_protclass_destroy(pc);
+    uproc_substmat_destroy(mat);
+}
+END_TEST
+
+static int
+cmp_protresult_desc(const void *p1, const void *p2)
+{
+    const struct uproc_protresult *r1 = p1, *r2 = p2;
+    if (r1->score != r2->score) {
+        return r1->score < r2->score ? 1 : -1;
+    }
+    return (r1->family > r2->family) - (r1->family < r2->family);
+}
+
+START_TEST(test_top_k)
+{
+    uproc_protclass *pc_all, *pc_top;
+    uproc_list *results = NULL, *results_top = NULL;
+    struct uproc_protresult all[UPROC_FAMILY_MAX + 1];
+    const size_t ks[] = { 1, 3, 10, 100 };
+
+    pc_all = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve,
+                                    substmat, NULL, NULL);
+    ck_assert_ptr_ne(pc_all, NULL);
+    pc_top = uproc_protclass_create(UPROC_PROTCLASS_TOP_K, ecurve, ecurve,
+                                    substmat, NULL, NULL);
+    ck_assert_ptr_ne(pc_top, NULL);
+
+    for (size_t j = 0; j < sizeof ks / sizeof *ks; j++) {
+        uproc_protclass_set_top_k(pc_top, ks[j]);
+        for (int i = 0; i < N_SEQS; i++) {
+            long n, n_top;
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc_all, seqs[i], &results), 0);
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc_top, seqs[i], &results_top), 0);
+
+            /* the first k results of ALL, ordered like TOP_K */
+            n = uproc_list_size(results);
+            for (long k = 0; k < n; k++) {
+                uproc_list_get(results, k, &all[k]);
+            }
+            qsort(all, n, sizeof *all, cmp_protresult_desc);
+
+            n_top = uproc_list_size(results_top);
+            ck_assert_int_eq(n_top, n < (long)ks[j] ? n : (long)ks[j]);
+            for (long k = 0; k < n_top; k++) {
+                struct uproc_protresult r;
+                uproc_list_get(results_top, k, &r);
+                ck_assert_uint_eq(r.family, all[k].family);
+                ck_assert(r.score == all[k].score);
+            }
+        }
+    }
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_top);
+    uproc_protclass_destroy(pc_all);
+    uproc_protclass_destroy(pc_top);
+}
+END_TEST
+
+static double
+thresh(size_t seq_len, void *arg)
+{
+    return *(double *)arg * seq_len;
+}
+
+static bool
+filter(const char *seq, size_t seq_len, uproc_family family, double score,
+       void *arg)
+{
+    (void) seq;
+    (void) family;
+    return score >= thresh(seq_len, arg);
+}
+
+START_TEST(test_prune)
+{
+    uproc_protclass *pc;
+    uproc_list *results = NULL, *results_pruned = NULL;
+    const double factors[] = { -0.1, 0.0, 0.05, 0.2, 1.0 };
+    double factor;
+    long n_total = 0;
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                filter, &factor);
+    ck_assert_ptr_ne(pc, NULL);
+
+    for (int fixed = 0; fixed < 2; fixed++) {
+        uproc_protclass_set_fixed(pc, fixed);
+        for (size_t j = 0; j < sizeof factors / sizeof *factors; j++) {
+            factor = factors[j];
+            for (int i = 0; i < N_SEQS; i++) {
+                uproc_protclass_set_thresh(pc, NULL, NULL);
+                ck_assert_int_eq(
+                    uproc_protclass_classify(pc, seqs[i], &results), 0);
+                uproc_protclass_set_thresh(pc, thresh, &factor);
+                ck_assert_int_eq(
+                    uproc_protclass_classify(pc, seqs[i], &results_pruned),
+                    0);
+
+                n_total += uproc_list_size(results);
+                assert_results_equal(results, results_pruned, 0.0);
+            }
+        }
+    }
+    ck_assert_int_gt(n_total, 0);
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_pruned);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+START_TEST(test_cache)
+{
+    uproc_protclass *pc;
+    uproc_classify_ctx *ctx;
+    uproc_list *results = NULL, *results_cached = NULL;
+    /* a tiny cache makes words of the same batch collide */
+    const size_t sizes[] = { 8, 4096 };
+    unsigned long long lookups, hits;
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+    ctx = uproc_classify_ctx_create();
+    ck_assert_ptr_ne(ctx, NULL);
+
+    for (int fixed = 0; fixed < 2; fixed++) {
+        uproc_protclass_set_fixed(pc, fixed);
+        for (size_t j = 0; j < sizeof sizes / sizeof *sizes; j++) {
+            /* every sequence twice in a row, so that the second time most
+             * words are in the (large) cache */
+            for (int i = 0; i < 2 * N_SEQS; i++) {
+                const char *seq = seqs[i / 2];
+                uproc_protclass_set_cache(pc, 0);
+                ck_assert_int_eq(
+                    uproc_protclass_classify_ctx(pc, ctx, seq, &results), 0);
+                uproc_protclass_set_cache(pc, sizes[j]);
+                ck_assert_int_eq(
+                    uproc_protclass_classify_ctx(pc, ctx, seq,
+                                                 &results_cached), 0);
+
+                assert_results_equal(results, results_cached, 0.0);
+            }
+        }
+    }
+    uproc_classify_ctx_cache_stats(ctx, &lookups, &hits);
+    ck_assert(hits > 0);
+    ck_assert(hits < lookups);
+
+    uproc_classify_ctx_destroy(ctx);
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_cached);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+START_TEST(test_memo)
+{
+    uproc_protclass *pc;
+    uproc_list *results = NULL, *results_memo = NULL;
+    /* the small memo holds only a few sequences per shard */
+    const size_t sizes[] = { 1 << 20, 64 * 512 };
+    unsigned long long lookups, hits;
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+
+    for (size_t j = 0; j < sizeof sizes / sizeof *sizes; j++) {
+        uproc_protmemo *memo = uproc_protmemo_create(sizes[j]);
+        ck_assert_ptr_ne(memo, NULL);
+        /* all sequences twice */
+        for (int i = 0; i < 2 * N_SEQS; i++) {
+            const char *seq = seqs[i % N_SEQS];
+            uproc_protclass_set_memo(pc, NULL);
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc, seq, &results), 0);
+            uproc_protclass_set_memo(pc, memo);
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc, seq, &results_memo), 0);
+
+            assert_results_equal(results, results_memo, 0.0);
+        }
+        uproc_protmemo_stats(memo, &lookups, &hits);
+        ck_assert_uint_eq(lookups, 2 * N_SEQS);
+        if (j == 0) {
+            ck_assert_uint_eq(hits, N_SEQS);
+        }
+        else {
+            ck_assert(hits < N_SEQS);
+        }
+        uproc_protclass_set_memo(pc, NULL);
+        uproc_protmemo_destroy(memo);
+    }
+
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_memo);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+START_TEST(test_memo_shared)
+{
+    uproc_protclass *pc[3];
+    uproc_list *results = NULL, *results_memo = NULL;
+    uproc_protmemo *memo = uproc_protmemo_create(16 << 20);
+    unsigned long long lookups, hits;
+    ck_assert_ptr_ne(memo, NULL);
+
+    /* same sequences, but different results */
+    pc[0] = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve,
+                                   substmat, NULL, NULL);
+    pc[1] = uproc_protclass_create(UPROC_PROTCLASS_TOP_K, ecurve, ecurve,
+                                   substmat, NULL, NULL);
+    pc[2] = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve,
+                                   substmat, NULL, NULL);
+    for (int j = 0; j < 3; j++) {
+        ck_assert_ptr_ne(pc[j], NULL);
+    }
+    uproc_protclass_set_top_k(pc[1], 2);
+    uproc_protclass_set_fixed(pc[2], true);
+
+    for (int i = 0; i < 2 * N_SEQS; i++) {
+        for (int j = 0; j < 3; j++) {
+            const char *seq = seqs[i % N_SEQS];
+            uproc_protclass_set_memo(pc[j], NULL);
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc[j], seq, &results), 0);
+            uproc_protclass_set_memo(pc[j], memo);
+            ck_assert_int_eq(
+                uproc_protclass_classify(pc[j], seq, &results_memo), 0);
+            assert_results_equal(results, results_memo, 0.0);
+        }
+    }
+    uproc_protmemo_stats(memo, &lookups, &hits);
+    ck_assert_uint_eq(lookups, 3 * 2 * N_SEQS);
+    ck_assert_uint_eq(hits, 3 * N_SEQS);
+
+    for (int j = 0; j < 3; j++) {
+        uproc_protclass_destroy(pc[j]);
+    }
+    uproc_protmemo_destroy(memo);
+    uproc_list_destroy(results);
+    uproc_list_destroy(results_memo);
+}
+END_TEST
+
+START_TEST(test_many)
+{
+    uproc_protclass *pc;
+    uproc_classify_ctx *ctx;
+    uproc_list *results = NULL, *results_many[N_SEQS] = { NULL };
+
+    pc = uproc_protclass_create(UPROC_PROTCLASS_ALL, ecurve, ecurve, substmat,
+                                NULL, NULL);
+    ck_assert_ptr_ne(pc, NULL);
+    ctx = uproc_classify_ctx_create();
+    ck_assert_ptr_ne(ctx, NULL);
+
+    /* the default batch size, and one that fits only few sequences and
+     * not at all the longer ones */
+    for (int batch = 0; batch < 2; batch++) {
+        if (batch) {
+            uproc_protclass_set_batch(pc, 16 << 10);
+        }
+        for (int fixed = 0; fixed < 2; fixed++) {
+            uproc_protclass_set_fixed(pc, fixed);
+            ck_assert_int_eq(
+                uproc_protclass_classify_many(pc, ctx, (const char **)seqs,
+                                              N_SEQS, results_many), 0);
+            for (int i = 0; i < N_SEQS; i++) {
+                ck_assert_int_eq(
+                    uproc_protclass_classify_ctx(pc, ctx, seqs[i], &results),
+                    0);
+                assert_results_equal(results, results_many[i], 0.0);
+            }
+        }
+    }
+
+    for (int i = 0; i < N_SEQS; i++) {
+        uproc_list_destroy(results_many[i]);
+    }
+    uproc_list_destroy(results);
+    uproc_classify_ctx_destroy(ctx);
+    uproc_protclass_destroy(pc);
+}
+END_TEST
+
+int main(void)
+{
+    Suite *s = suite_create("protclass");
+
+    TCase *tc = tcase_create("");
+    tcase_add_unchecked_fixture(tc, setup, teardown);
+    tcase_add_test(tc, test_fixed_scale);
+    tcase_add_test(tc, test_fixed);
+    tcase_add_test(tc, test_fixed_inf);
+    tcase_add_test(tc, test_top_k);
+    tcase_add_test(tc, test_prune);
+    tcase_add_test(tc, test_cache);
+    tcase_add_test(tc, test_memo);
+    tcase_add_test(tc, test_memo_shared);
+    tcase_add_test(tc, test_many);
+    suite_add_tcase(s, tc);
+
+    SRunner *sr = srunner_create(s);
+    srunner_run_all(sr, CK_NORMAL);
+    int n_failed = srunner_ntests_failed(sr);
+    srunner_free(sr);
+    return n_failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
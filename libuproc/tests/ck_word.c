@@ -166,10 +166,65 @@ START_TEST(test_worditer)
 
     res = uproc_worditer_next(iter, &index, &fwd, &rev);
     ck_assert_int_eq(res, 1);
+
+    uproc_worditer_reset(iter, seq + 21, alpha);
+    TEST(0,  "VVVVVVVVVVVVVVVVVV", "VVVVVVVVVVVVVVVVVV");
+    TEST(1,  "VVVVVVVVVVVVVVVVVS", "SVVVVVVVVVVVVVVVVV");
+    TEST(2,  "VVVVVVVVVVVVVVVVSD", "DSVVVVVVVVVVVVVVVV");
+    res = uproc_worditer_next(iter, &index, &fwd, &rev);
+    ck_assert_int_eq(res, 1);
+    uproc_worditer_destroy(iter);
 #undef TEST
 }
 END_TEST
 
+START_TEST(test_words_from_sequence)
+{
+    const char chars[] = "AGSTPKRQEDNHYWFMLIVC!";
+    const size_t batch_sizes[] = { 1, 7, 64 };
+    char seq[500];
+    uproc_amino aminos[sizeof seq];
+    size_t index[64];
+    struct uproc_word fwd[64], rev[64];
+    unsigned long long state = 42;
+
+    for (int t = 0; t < 100; t++) {
+        /* fewer invalid characters in later sequences */
+        size_t len = t * 5;
+        for (size_t i = 0; i < len; i++) {
+            state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+            int c = (state >> 33) % (20 + t);
+            seq[i] = chars[c < 20 ? c : 20];
+        }
+        seq[len] = '\0';
+        uproc_alphabet_translate(alpha, seq, len, aminos);
+
+        for (size_t b = 0; b < sizeof batch_sizes / sizeof *batch_sizes; b++) {
+            uproc_worditer *iter = uproc_worditer_create(seq, alpha);
+            size_t pos = 0, n, it_index;
+            struct uproc_word it_fwd, it_rev;
+
+            while ((n = uproc_words_from_sequence(aminos, len, &pos,
+                                                  batch_sizes[b], index,
+                                                  fwd, rev))) {
+                ck_assert(n <= batch_sizes[b]);
+                for (size_t i = 0; i < n; i++) {
+                    ck_assert_int_eq(
+                        uproc_worditer_next(iter, &it_index, &it_fwd, &it_rev),
+                        0);
+                    ck_assert_uint_eq(index[i], it_index);
+                    ck_assert_int_eq(uproc_word_cmp(&fwd[i], &it_fwd), 0);
+                    ck_assert_int_eq(uproc_word_cmp(&rev[i], &it_rev), 0);
+                }
+            }
+            ck_assert_int_eq(
+                uproc_worditer_next(iter, &it_index, &it_fwd, &it_rev), 1);
+            uproc_worditer_destroy(iter);
+        }
+    }
+}
+END_TEST
+
 int main(void)
 {
     (void) codon_is_stop;
@@ -185,6 +240,7 @@ int main(void)
     tcase_add_test(tc, test_prepend);
     tcase_add_test(tc, test_startswith);
     tcase_add_test(tc, test_worditer);
+    tcase_add_test(tc, test_words_from_sequence);
     suite_add_tcase(s, tc);
 
     SRunner *sr = srunner_create(s);
@@ -171,12 +171,19 @@ uproc_worditer_create(const char *seq, const uproc_alphabet *alpha)
         uproc_error(UPROC_ENOMEM);
         return NULL;
     }
+    uproc_worditer_reset(iter, seq, alpha);
+    return iter;
+}
+
+void
+uproc_worditer_reset(uproc_worditer *iter, const char *seq,
+                     const uproc_alphabet *alpha)
+{
     iter->sequence = seq;
     iter->index = 0;
     iter->alphabet = alpha;
     iter->fwd = (struct uproc_word) UPROC_WORD_INITIALIZER;
     iter->rev = (struct uproc_word) UPROC_WORD_INITIALIZER;
-    return iter;
 }
 
 int
@@ -214,3 +221,62 @@ uproc_worditer_destroy(uproc_worditer *iter)
 {
     free(iter);
 }
+
+/* weight of the first amino acid of a prefix */
+#define PREFIX_FIRST ((UPROC_PREFIX_MAX + 1) / UPROC_ALPHABET_SIZE)
+
+size_t
+uproc_words_from_sequence(const uproc_amino *aminos, size_t len,
+                          size_t *pos, size_t n, size_t *index,
+                          struct uproc_word *fwd, struct uproc_word *rev)
+{
+    size_t i = *pos, k = 0;
+
+    while (k < n && i + UPROC_WORD_LEN <= len) {
+        const uproc_amino *a = aminos + i;
+        struct uproc_word f = UPROC_WORD_INITIALIZER,
+                          r = UPROC_WORD_INITIALIZER;
+        int j;
+
+        /* skip to the next complete word */
+        for (j = 0; j < UPROC_WORD_LEN && a[j] >= 0; j++) {
+            uproc_word_append(&f, a[j]);
+            uproc_word_prepend(&r, a[j]);
+        }
+        if (j < UPROC_WORD_LEN) {
+            i += j + 1;
+            continue;
+        }
+
+        /* Shift the following amino acids in. The ones moving between
+         * prefix and suffix are taken from `aminos` instead of being
+         * extracted from the words. */
+        for (;;) {
+            index[k] = i;
+            fwd[k] = f;
+            rev[k] = r;
+            k++;
+            i++;
+            if (k == n || i + UPROC_WORD_LEN > len) {
+                break;
+            }
+            if (a[UPROC_WORD_LEN] < 0) {
+                i += UPROC_WORD_LEN;
+                break;
+            }
+            f.prefix = (f.prefix - a[0] * PREFIX_FIRST) * UPROC_ALPHABET_SIZE
+                       + a[UPROC_PREFIX_LEN];
+            f.suffix = ((f.suffix << UPROC_AMINO_BITS) &
+                        UPROC_BITMASK(UPROC_SUFFIX_LEN * UPROC_AMINO_BITS)) |
+                       a[UPROC_WORD_LEN];
+            r.prefix = r.prefix / UPROC_ALPHABET_SIZE +
+                       a[UPROC_WORD_LEN] * PREFIX_FIRST;
+            r.suffix = (r.suffix >> UPROC_AMINO_BITS) |
+                       (uproc_suffix)a[UPROC_SUFFIX_LEN]
+                       << (UPROC_AMINO_BITS * (UPROC_SUFFIX_LEN - 1));
+            a++;
+        }
+    }
+    *pos = i;
+    return k;
+}
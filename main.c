@@ -53,18 +53,50 @@
 #if MAIN_DNA
 #define clf uproc_dnaclass
 #define clf_classify uproc_dnaclass_classify
+#define clf_classify_many uproc_dnaclass_classify_many
 #define clfresult uproc_dnaresult
 #else
 #define clf uproc_protclass
 #define clf_classify uproc_protclass_classify
+#define clf_classify_many uproc_protclass_classify_many
 #define clfresult uproc_protresult
 #endif
 
-timeit t_in, t_out, t_clf, t_tot;
+timeit t_load, t_in, t_out, t_clf, t_tot;
+
+/* With -N replicate, the classifiers using the database copy of each NUMA
+ * node */
+clf **node_classifiers;
+int n_nodes;
+
+/* With -b, sort the words of each chunk before looking them up */
+bool batch_lookups;
+
+#if defined(TIMEIT)
+/* Neighbour cache lookups and hits of all classifying threads */
+unsigned long long cache_lookups, cache_hits;
+
+/* Add the lookups and hits of the calling thread's neighbour cache since
+ * they were `lookups0` and `hits0` (the stats of a workspace accumulate over
+ * all sequences it was used for) */
+void
+cache_stats_add(unsigned long long lookups0, unsigned long long hits0)
+{
+    unsigned long long lookups, hits;
+    uproc_classify_ctx_cache_stats(uproc_classify_ctx_thread(),
+                                   &lookups, &hits);
+#pragma omp atomic
+    cache_lookups += lookups - lookups0;
+#pragma omp atomic
+    cache_hits += hits - hits0;
+}
+#endif
 
 struct buffer
 {
     struct uproc_sequence seqs[CHUNK_SIZE_MAX];
+    /* the `data` members of `seqs` */
+    const char *data[CHUNK_SIZE_MAX];
     uproc_list *results[CHUNK_SIZE_MAX];
     long long n;
 } buf[2];
@@ -93,7 +125,8 @@ buffer_free(struct buffer *buf)
 }
 
 /* chunk size to use. can be overwritten by setting the UPROC_CHUNK_SIZE
- * environemt variable (see determine_chunk_size())*/
+ * environemt variable (see determine_chunk_size()). The largest chunks are
+ * used by default with -b. */
 long long chunk_size = CHUNK_SIZE_DEFAULT;
 
 void
@@ -108,7 +141,7 @@ determine_chunk_size(void)
             return;
         }
     }
-    chunk_size = CHUNK_SIZE_DEFAULT;
+    chunk_size = batch_lookups ? CHUNK_SIZE_MAX : CHUNK_SIZE_DEFAULT;
 }
 
 
@@ -117,9 +150,42 @@ void
 buffer_classify(struct buffer *buf, clf *classifier)
 {
     long long i;
-#pragma omp parallel for private(i) shared(buf, classifier) schedule(static)
-    for (i = 0; i < buf->n; i++) {
-        clf_classify(classifier, buf->seqs[i].data, &buf->results[i]);
+#pragma omp parallel private(i) shared(buf) firstprivate(classifier)
+    {
+#if defined(TIMEIT)
+        unsigned long long lookups0, hits0;
+        uproc_classify_ctx_cache_stats(uproc_classify_ctx_thread(),
+                                       &lookups0, &hits0);
+#endif
+#if _OPENMP
+        if (node_classifiers) {
+            /* spread the threads evenly over the nodes */
+            int node = omp_get_thread_num() * n_nodes / omp_get_num_threads();
+            uproc_numa_bind(node);
+            classifier = node_classifiers[node];
+        }
+#endif
+        if (batch_lookups) {
+            /* each thread classifies a contiguous part of the chunk */
+            long long first = 0, last = buf->n;
+#if _OPENMP
+            int t = omp_get_thread_num(), n_threads = omp_get_num_threads();
+            first = buf->n * t / n_threads;
+            last = buf->n * (t + 1) / n_threads;
+#endif
+            clf_classify_many(classifier, uproc_classify_ctx_thread(),
+                              &buf->data[first], last - first,
+                              &buf->results[first]);
+        }
+        else {
+#pragma omp for schedule(static)
+            for (i = 0; i < buf->n; i++) {
+                clf_classify(classifier, buf->seqs[i].data, &buf->results[i]);
+            }
+        }
+#if defined(TIMEIT)
+        cache_stats_add(lookups0, hits0);
+#endif
     }
 }
 
@@ -140,6 +206,7 @@ buffer_read(struct buffer *buf, uproc_seqiter *seqit)
         trim_header(seq.header);
         uproc_sequence_free(&buf->seqs[i]);
         uproc_sequence_copy(&buf->seqs[i], &seq);
+        buf->data[i] = buf->seqs[i].data;
     }
     buf->n = i;
     return buf->n > 0;
@@ -243,17 +310,24 @@ classify_file(const char *path, clf *classifier,
               unsigned long counts[UPROC_FAMILY_MAX + 1],
               uproc_io_stream *out_preds, uproc_idmap *idmap)
 {
+    bool chunked = batch_lookups;
 #if _OPENMP
-    if (omp_get_max_threads() > 1) {
+    chunked = chunked || omp_get_max_threads() > 1;
+#endif
+    if (chunked) {
         return classify_file_mt(path, classifier, n_seqs, n_seqs_unexplained,
                                 counts, out_preds, idmap);
     }
-#endif
     timeit_start(&t_tot);
     uproc_io_stream *stream = open_read(path);
     uproc_seqiter *seqit = uproc_seqiter_create(stream);
     struct uproc_sequence seq;
     uproc_list *results = NULL;
+#if defined(TIMEIT)
+    unsigned long long lookups0, hits0;
+    uproc_classify_ctx_cache_stats(uproc_classify_ctx_thread(),
+                                   &lookups0, &hits0);
+#endif
     timeit_start(&t_in);
     while (!uproc_seqiter_next(seqit, &seq)) {
         timeit_stop(&t_in);
@@ -283,6 +357,9 @@ classify_file(const char *path, clf *classifier,
         timeit_start(&t_in);
     }
     timeit_stop(&t_in);
+#if defined(TIMEIT)
+    cache_stats_add(lookups0, hits0);
+#endif
     uproc_seqiter_destroy(seqit);
     timeit_stop(&t_tot);
 }
@@ -343,6 +420,18 @@ print_counts(uproc_io_stream *stream,
     }
 }
 
+#if defined(TIMEIT)
+/* Print the hit rate of the neighbour caches of all classifying threads */
+void
+print_cache_stats(void)
+{
+    if (cache_lookups) {
+        fprintf(stderr, "cache: %llu/%llu (%.2f%%)\n", cache_hits,
+                cache_lookups, 100.0 * cache_hits / cache_lookups);
+    }
+}
+#endif
+
 void
 make_opts(struct ppopts *o, const char *progname)
 {
@@ -350,6 +439,8 @@ make_opts(struct ppopts *o, const char *progname)
     ppopts_add_text(o, PROGNAME ", version " UPROC_VERSION);
     ppopts_add_text(o,
         "USAGE: %s [options] DBDIR MODELDIR [INPUTFILES]", progname);
+    ppopts_add_text(o,
+        "   or: %s [options] -C FILE [INPUTFILES]", progname);
 
     ppopts_add_text(o,
         "Classifies %s sequences using the database in DBDIR and the model in "
@@ -373,6 +464,26 @@ make_opts(struct ppopts *o, const char *progname)
     O('t', "threads", "N",
       "Maximum number of threads to use (default: %d).", NUM_THREADS_DEFAULT);
 #endif
+#if HAVE_MMAP && USE_MMAP
+    O('C', "container", "FILE",
+      "Use the database and model in FILE, created by uproc-pack, instead "
+      "of DBDIR and MODELDIR (which are omitted).");
+    O('M', "mmap", "OPTS", MMAP_OPTS_DESC);
+#endif
+#if HAVE_MMAP && USE_MMAP && HAVE_SHM_OPEN
+    O('S', "shm", "NAME",
+      "Use the ecurves that uproc-dbd keeps in shared memory under NAME "
+      "instead of the ones in DBDIR.");
+#endif
+#if _OPENMP
+    if (uproc_features_numa()) {
+        O('N', "numa", "MODE", "\
+Placement of the database on machines with multiple NUMA nodes:\n\
+    replicate   copy the database to every node and let each thread use\n\
+                the copy on its own node\n\
+    interleave  spread the database evenly over all nodes");
+    }
+#endif
 
     ppopts_add_header(o, "OUTPUT FORMAT:");
     O('p', "preds", "", "\
@@ -415,6 +526,42 @@ Protein threshold level. Allowed values:\n\
     2   less restrictive\n\
     3   more restrictive\n\
 Default is %d . ", PROT_THRESH_DEFAULT);
+    O('F', "fixed", "",
+      "Compute scores using fixed-point arithmetic. This is faster, but the "
+      "scores deviate slightly from the exact ones, which can change the "
+      "classification of sequences whose score is close to the threshold.");
+    O('E', "exhaustive", "",
+      "Score all protein families completely, including those that can no "
+      "longer reach the threshold. The results are the same, so this is only "
+      "useful for verifying that.");
+    O('Q', "cache", "N",
+      "Cache the neighbours of up to N words per thread (rounded down to a "
+      "power of two), so that words occurring repeatedly in the input are "
+      "looked up only once. Each entry takes about 200 bytes.");
+    O('b', "batch", "N",
+      "Look up the words of a whole chunk of sequences at once, in sorted "
+      "order. This reads the database sequentially, which is faster if it "
+      "is larger than the CPU caches, and much faster if it is mapped (see "
+      "-M) and doesn't fit into memory. Each thread sorts up to N MiB of "
+      "words (about 7000 per MiB) at a time; 10 is a good start. Chunks of "
+      "16384 sequences are used unless the UPROC_CHUNK_SIZE environment "
+      "variable is set.");
+    O('m', "memo", "N",
+      "Remember the results of up to N MiB of recently classified "
+      "sequences (shared by all threads), so that identical "
+#if MAIN_DNA
+      "ORFs "
+#else
+      "sequences "
+#endif
+      "are classified only once.");
+    O('k', "top", "N",
+      "Report only the N highest-scoring protein families per sequence "
+      "(in descending order of score)."
+#if MAIN_DNA
+      " In short read mode, this replaces the single maximum."
+#endif
+      );
 
 #if MAIN_DNA
     ppopts_add_header(o, "DNA CLASSIFICATION OPTIONS:");
@@ -448,7 +595,6 @@ main(int argc, char **argv)
 
     uproc_io_stream *out_stream = uproc_stdout;
 
-    determine_chunk_size();
 #if _OPENMP
     omp_set_nested(1);
     omp_set_num_threads(NUM_THREADS_DEFAULT);
@@ -462,10 +608,23 @@ main(int argc, char **argv)
         out_numeric = false;    // -n
 
     int prot_thresh_level = PROT_THRESH_DEFAULT;    // -P
+    bool fixed_point = false;                       // -F
+    int top_k = 0;                                  // -k
+    bool prune = true;                              // -E
+    int cache_size = 0;                             // -Q
+    int batch_size = 0;                             // -b
+    int memo_size = 0;                              // -m
     int orf_thresh_level = ORF_THRESH_DEFAULT;      // -O
 
     bool short_read_mode = false;   // -s
 
+    struct uproc_ecurve_mmap_opts mmap_opts =
+        UPROC_ECURVE_MMAP_OPTS_INITIALIZER;     // -M
+
+    const char *container = NULL;   // -C
+    const char *shm_name = NULL;    // -S
+    enum numa_mode numa_mode = NUMA_OFF;    // -N
+
     int opt;
     struct ppopts opts = PPOPTS_INITIALIZER;
     make_opts(&opts, argv[0]);
@@ -504,6 +663,37 @@ main(int argc, char **argv)
                     return EXIT_FAILURE;
                 }
                 break;
+            case 'F':
+                fixed_point = true;
+                break;
+            case 'E':
+                prune = false;
+                break;
+            case 'Q':
+                if (parse_int(optarg, &cache_size) || cache_size < 0) {
+                    fprintf(stderr, "-Q requires a non-negative integer\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'b':
+                if (parse_int(optarg, &batch_size) || batch_size <= 0) {
+                    fprintf(stderr, "-b requires a positive integer\n");
+                    return EXIT_FAILURE;
+                }
+                batch_lookups = true;
+                break;
+            case 'm':
+                if (parse_int(optarg, &memo_size) || memo_size < 0) {
+                    fprintf(stderr, "-m requires a non-negative integer\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'k':
+                if (parse_int(optarg, &top_k) || top_k <= 0) {
+                    fprintf(stderr, "-k requires a positive integer\n");
+                    return EXIT_FAILURE;
+                }
+                break;
             case 't':
 #if _OPENMP
                 {
@@ -533,51 +723,139 @@ main(int argc, char **argv)
                 break;
 
 #endif
+            case 'C':
+                container = optarg;
+                break;
+            case 'M':
+                if (parse_mmap_opts(optarg, &mmap_opts)) {
+                    fprintf(stderr, "invalid -M argument\n");
+                    return EXIT_FAILURE;
+                }
+                break;
+            case 'S':
+                shm_name = optarg;
+                break;
+            case 'N':
+                if (parse_numa_mode(optarg, &numa_mode)) {
+                    fprintf(stderr,
+                            "-N argument must be replicate or interleave\n");
+                    return EXIT_FAILURE;
+                }
+                break;
             case '?':
                 return EXIT_FAILURE;
         }
     }
+    determine_chunk_size();
 
     if (!out_counts && !out_preds && !out_stats) {
         out_counts = true;
     }
 
-    if (argc < optind + ARGC - 1) {
+    /* DBDIR and MODELDIR are omitted if -C is used */
+    int dirs = container ? 0 : INFILES;
+    if (argc < optind + dirs) {
         ppopts_print(&opts, stderr, 80, PPOPTS_DESC_ON_NEXT_LINE);
         return EXIT_FAILURE;
     }
+    if (container && shm_name) {
+        fprintf(stderr, "-C and -S can't be used together\n");
+        return EXIT_FAILURE;
+    }
 
     struct model model;
-    model_load(&model, argv[optind + MODELDIR], orf_thresh_level);
-
     struct database db;
-    database_load(&db, argv[optind + DBDIR], prot_thresh_level,
-                  UPROC_ECURVE_BINARY);
+    timeit_start(&t_load);
+    if (container) {
+        container_load(&db, &model, container, prot_thresh_level,
+                       orf_thresh_level, &mmap_opts);
+    }
+    else {
+        model_load(&model, argv[optind + MODELDIR], orf_thresh_level);
+        database_load(&db, argv[optind + DBDIR], prot_thresh_level,
+                      UPROC_ECURVE_BINARY, &mmap_opts, shm_name);
+    }
+    if (numa_mode == NUMA_INTERLEAVE) {
+        if (database_numa_move(&db, -1)) {
+            uproc_perror("");
+            return EXIT_FAILURE;
+        }
+    }
+    else if (numa_mode == NUMA_REPLICATE) {
+        n_nodes = uproc_numa_nodes();
+        if (database_numa_move(&db, 0)) {
+            uproc_perror("");
+            return EXIT_FAILURE;
+        }
+    }
+    timeit_stop(&t_load);
 
     uproc_protclass *pc;
     uproc_dnaclass *dc;
     clf *classifier;
+    uproc_protmemo *memo = NULL;
+
+    if (memo_size) {
+        memo = uproc_protmemo_create((size_t)memo_size << 20);
+        if (!memo) {
+            uproc_perror("");
+            return EXIT_FAILURE;
+        }
+    }
 
-    create_classifiers(&pc, &dc, &db, &model, short_read_mode);
+    if (create_classifiers(&pc, &dc, &db, &model, short_read_mode,
+                           fixed_point, top_k, prune, cache_size, batch_size,
+                           memo)) {
+        uproc_perror("");
+        return EXIT_FAILURE;
+    }
 #if MAIN_DNA
     classifier = dc;
 #else
     classifier = pc;
 #endif
 
+    struct database node_db[n_nodes ? n_nodes : 1];
+    uproc_protclass *node_pc[n_nodes ? n_nodes : 1];
+    uproc_dnaclass *node_dc[n_nodes ? n_nodes : 1];
+    clf *node_clf[n_nodes ? n_nodes : 1];
+    if (n_nodes) {
+        node_db[0] = db;
+        node_pc[0] = pc;
+        node_dc[0] = dc;
+        node_clf[0] = classifier;
+        for (int i = 1; i < n_nodes; i++) {
+            /* classifying with a partial replica would give wrong scores */
+            if (database_numa_copy(&node_db[i], &db, i) ||
+                create_classifiers(&node_pc[i], &node_dc[i], &node_db[i],
+                                   &model, short_read_mode, fixed_point,
+                                   top_k, prune, cache_size, batch_size,
+                                   memo)) {
+                uproc_perror("");
+                return EXIT_FAILURE;
+            }
+#if MAIN_DNA
+            node_clf[i] = node_dc[i];
+#else
+            node_clf[i] = node_pc[i];
+#endif
+        }
+        node_classifiers = node_clf;
+    }
+
     uproc_idmap *idmap = out_numeric ? NULL : db.idmap;
 
     /* use stdin if no input file specified */
-    if (argc < optind + ARGC) {
+    if (argc < optind + dirs + 1) {
         argv[argc++] = "-";
     }
 
     unsigned long n_seqs = 0, n_seqs_unexplained = 0;
     unsigned long counts[UPROC_FAMILY_MAX + 1] = { 0 };
 
-    for (; optind + INFILES < argc; optind++)
+    for (optind += dirs; optind < argc; optind++)
     {
-        classify_file(argv[optind + INFILES], classifier,
+        classify_file(argv[optind], classifier,
                       &n_seqs, &n_seqs_unexplained, counts,
                       out_preds ? out_stream : NULL,
                       idmap);
@@ -594,6 +872,11 @@ main(int argc, char **argv)
 
     uproc_io_close(out_stream);
 
+    for (int i = 1; i < n_nodes; i++) {
+        uproc_protclass_destroy(node_pc[i]);
+        uproc_dnaclass_destroy(node_dc[i]);
+        database_numa_free(&node_db[i]);
+    }
     uproc_protclass_destroy(pc);
     uproc_dnaclass_destroy(dc);
     model_free(&model);
@@ -601,10 +884,21 @@ main(int argc, char **argv)
     buffer_free(&buf[0]);
     buffer_free(&buf[1]);
 
+    timeit_print(&t_load, "db ");
     timeit_print(&t_in,  "in ");
     timeit_print(&t_out, "out");
     timeit_print(&t_clf, "clf");
     timeit_print(&t_tot, "tot");
+#if defined(TIMEIT)
+    print_cache_stats();
+    if (memo) {
+        unsigned long long lookups, hits;
+        uproc_protmemo_stats(memo, &lookups, &hits);
+        fprintf(stderr, "memo: %llu/%llu (%.2f%%)\n", hits, lookups,
+                lookups ? 100.0 * hits / lookups : 0.0);
+    }
+#endif
+    uproc_protmemo_destroy(memo);
 
     return EXIT_SUCCESS;
 }
@@ -304,6 +304,7 @@ build_ecurve(const char *infile,
              const char *alphabet,
              uproc_idmap *idmap,
              bool reverse,
+             enum uproc_ecurve_index index,
              uproc_ecurve **ecurve)
 {
     int res;
@@ -318,7 +319,7 @@ build_ecurve(const char *infile,
         return -1;
     }
 
-    *ecurve = uproc_ecurve_create(alphabet, 0);
+    *ecurve = uproc_ecurve_create_with_index(alphabet, 0, index);
     if (!*ecurve) {
         goto error;
     }
@@ -368,14 +369,22 @@ error:
 
 static int
 build_and_store(const char *infile, const char *outdir, const char *alphabet,
-                uproc_idmap *idmap, bool reverse)
+                uproc_idmap *idmap, bool reverse,
+                enum uproc_ecurve_index index, bool compress)
 {
     int res;
     uproc_ecurve *ecurve = NULL;
-    res = build_ecurve(infile, alphabet, idmap, reverse, &ecurve);
+    res = build_ecurve(infile, alphabet, idmap, reverse, index, &ecurve);
     if (res) {
         return res;
     }
+    if (compress) {
+        res = uproc_ecurve_compress(ecurve);
+        if (res) {
+            uproc_ecurve_destroy(ecurve);
+            return res;
+        }
+    }
     fprintf(stderr, "Storing %s/%s.ecurve...", outdir, reverse ? "rev" : "fwd");
     res = uproc_ecurve_store(ecurve, UPROC_ECURVE_BINARY, UPROC_IO_GZIP,
                              "%s/%s.ecurve", outdir, reverse ? "rev" : "fwd");
@@ -388,13 +397,17 @@ int
 build_ecurves(const char *infile,
               const char *outdir,
               const char *alphabet,
-              uproc_idmap *idmap)
+              uproc_idmap *idmap,
+              enum uproc_ecurve_index index,
+              bool compress)
 {
     int res;
-    res = build_and_store(infile, outdir, alphabet, idmap, false);
+    res = build_and_store(infile, outdir, alphabet, idmap, false, index,
+                          compress);
     if (res) {
         return res;
     }
-    res = build_and_store(infile, outdir, alphabet, idmap, true);
+    res = build_and_store(infile, outdir, alphabet, idmap, true, index,
+                          compress);
     return res;
 }
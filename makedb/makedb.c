@@ -54,6 +54,17 @@ make_opts(struct ppopts *o, const char *progname)
     O('V', "libversion", "", "Print libuproc version/features and exit.");
     O('c', "calib",      "",
       "Re-calibrate existing database (SOURCEFILE will be ignored).");
+    O('C', "compact",    "",
+      "Build ecurves with a compact prefix index. This saves several hundred \
+      MB of memory per ecurve for small databases, but makes lookups \
+      slightly slower.");
+    O('D', "direct",     "",
+      "Build ecurves with a prefix table that resolves the neighbours of \
+      empty prefixes directly. Lookups in sparse regions are faster, but \
+      the ecurves get slightly larger.");
+    O('Z', "compress",   "",
+      "Run-length encode the families of the ecurves, if that makes them \
+      smaller. Lookups get slightly slower.");
 #undef O
 }
 
@@ -104,6 +115,8 @@ main(int argc, char **argv)
          *infile,
          *outdir;
     bool calib_only = false;
+    enum uproc_ecurve_index index = UPROC_ECURVE_INDEX_TABLE;
+    bool compress = false;
 
     enum nonopt_args
     {
@@ -128,6 +141,15 @@ main(int argc, char **argv)
             case 'c':
                 calib_only = true;
                 break;
+            case 'C':
+                index = UPROC_ECURVE_INDEX_COMPACT;
+                break;
+            case 'D':
+                index = UPROC_ECURVE_INDEX_DIRECT;
+                break;
+            case 'Z':
+                compress = true;
+                break;
             case '?':
                 return EXIT_FAILURE;
         }
@@ -153,7 +175,8 @@ main(int argc, char **argv)
             return EXIT_FAILURE;
         }
         make_dir(outdir);
-        res = build_ecurves(infile, outdir, alphabet, idmap);
+        res = build_ecurves(infile, outdir, alphabet, idmap, index,
+                            compress);
         if (res) {
             uproc_perror("error building ecurves");
             return EXIT_FAILURE;
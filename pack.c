@@ -0,0 +1,127 @@
+/* uproc-pack
+ * Combine a database and a model into a single container file.
+ *
+ * Copyright 2014 Peter Meinicke, Robin Martinjak
+ *
+ * This file is part of uproc.
+ *
+ * uproc is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * uproc is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with uproc.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include "common.h"
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include <uproc.h>
+
+#include "ppopts.h"
+
+#define PROGNAME "uproc-pack"
+
+
+void
+make_opts(struct ppopts *o, const char *progname)
+{
+#define O(...) ppopts_add(o, __VA_ARGS__)
+    ppopts_add_text(o, PROGNAME ", version " UPROC_VERSION);
+    ppopts_add_text(o, "USAGE: %s [options] DBDIR MODELDIR FILE", progname);
+    ppopts_add_text(o,
+        "Writes the database in DBDIR and the model in MODELDIR (including "
+        "all threshold levels) to the container file FILE, which "
+        "uproc-prot, uproc-dna and uproc-detailed can load (with \"-C "
+        "FILE\") by mapping it into memory as a whole. Like the database, "
+        "the file is specific to the machine it was created on.");
+
+    ppopts_add_header(o, "GENERAL OPTIONS:");
+    O('h', "help",       "", "Print this message and exit.");
+    O('v', "version",    "", "Print version and exit.");
+    O('V', "libversion", "", "Print libuproc version/features and exit.");
+#undef O
+}
+
+
+enum nonopt_args
+{
+    DBDIR, MODELDIR, OUTFILE,
+    ARGC
+};
+
+int main(int argc, char **argv)
+{
+    uproc_error_set_handler(errhandler_bail);
+
+    int opt;
+    struct ppopts opts = PPOPTS_INITIALIZER;
+    make_opts(&opts, argv[0]);
+    while ((opt = ppopts_getopt(&opts, argc, argv)) != -1) {
+        switch (opt) {
+            case 'h':
+                ppopts_print(&opts, stderr, 80, 0);
+                return EXIT_SUCCESS;
+            case 'v':
+                print_version(PROGNAME);
+                return EXIT_SUCCESS;
+            case 'V':
+                uproc_features_print(uproc_stderr);
+                return EXIT_SUCCESS;
+            case '?':
+                return EXIT_FAILURE;
+        }
+    }
+    if (argc < optind + ARGC) {
+        ppopts_print(&opts, stderr, 80, 0);
+        return EXIT_FAILURE;
+    }
+
+    const char *dbdir = argv[optind + DBDIR],
+               *modeldir = argv[optind + MODELDIR];
+    struct database db;
+    struct model model;
+    database_load(&db, dbdir, 0, UPROC_ECURVE_BINARY, NULL, NULL);
+    model_load(&model, modeldir, 0);
+
+    uproc_matrix *prot_thresh[] = {
+        uproc_matrix_load(UPROC_IO_GZIP, "%s/prot_thresh_e2", dbdir),
+        uproc_matrix_load(UPROC_IO_GZIP, "%s/prot_thresh_e3", dbdir),
+    };
+    uproc_matrix *orf_thresh[] = {
+        uproc_matrix_load(UPROC_IO_GZIP, "%s/orf_thresh_e1", modeldir),
+        uproc_matrix_load(UPROC_IO_GZIP, "%s/orf_thresh_e2", modeldir),
+    };
+
+    uproc_container *c = uproc_container_create();
+    uproc_container_add_ecurve(c, "fwd", db.fwd);
+    uproc_container_add_ecurve(c, "rev", db.rev);
+    uproc_container_add_idmap(c, "idmap", db.idmap);
+    uproc_container_add_matrix(c, "prot_thresh_e2", prot_thresh[0]);
+    uproc_container_add_matrix(c, "prot_thresh_e3", prot_thresh[1]);
+    uproc_container_add_substmat(c, "substmat", model.substmat);
+    uproc_container_add_matrix(c, "codon_scores", model.codon_scores);
+    uproc_container_add_matrix(c, "orf_thresh_e1", orf_thresh[0]);
+    uproc_container_add_matrix(c, "orf_thresh_e2", orf_thresh[1]);
+    uproc_container_store(c, "%s", argv[optind + OUTFILE]);
+
+    uproc_container_destroy(c);
+    for (int i = 0; i < 2; i++) {
+        uproc_matrix_destroy(prot_thresh[i]);
+        uproc_matrix_destroy(orf_thresh[i]);
+    }
+    model_free(&model);
+    database_free(&db);
+    return EXIT_SUCCESS;
+}